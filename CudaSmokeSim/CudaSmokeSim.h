@@ -30,6 +30,8 @@ extern "C" {
         float* v;
         float* dens;
         float* temp;
+        // Distance between rows of the host arrays in floats, at least width + 2
+        int pitch;
 
         float dt;
         float velDiffusion;
@@ -297,13 +297,16 @@ void CudaSmokeSim_Uninit(CudaSmokeSim_Context* ctx)
 
 void CudaSmokeSim_Step(CudaSmokeSim_Context* ctx, CudaSmokeSim_StepData* data)
 {
-    size_t arrSize = ctx->totalWidth * ctx->totalHeight * sizeof(float);
+    // Device arrays are tightly packed, host rows may be padded
+    size_t rowSize = ctx->totalWidth * sizeof(float);
+    size_t hostPitch = data->pitch * sizeof(float);
+    size_t rows = ctx->totalHeight;
 
     cudaError_t cudaStatus;
-    cudaStatus = cudaMemcpy(ctx->dev_u,     data->u,    arrSize, cudaMemcpyHostToDevice);
-    cudaStatus = cudaMemcpy(ctx->dev_v,     data->v,    arrSize, cudaMemcpyHostToDevice);
-    cudaStatus = cudaMemcpy(ctx->dev_dens,  data->dens, arrSize, cudaMemcpyHostToDevice);
-    cudaStatus = cudaMemcpy(ctx->dev_temp,  data->temp, arrSize, cudaMemcpyHostToDevice);
+    cudaStatus = cudaMemcpy2D(ctx->dev_u,     rowSize, data->u,    hostPitch, rowSize, rows, cudaMemcpyHostToDevice);
+    cudaStatus = cudaMemcpy2D(ctx->dev_v,     rowSize, data->v,    hostPitch, rowSize, rows, cudaMemcpyHostToDevice);
+    cudaStatus = cudaMemcpy2D(ctx->dev_dens,  rowSize, data->dens, hostPitch, rowSize, rows, cudaMemcpyHostToDevice);
+    cudaStatus = cudaMemcpy2D(ctx->dev_temp,  rowSize, data->temp, hostPitch, rowSize, rows, cudaMemcpyHostToDevice);
 
     // Velocity step
     if (data->velDiffusion > 0.0f)
@@ -318,8 +321,8 @@ void CudaSmokeSim_Step(CudaSmokeSim_Context* ctx, CudaSmokeSim_StepData* data)
     _AdvectDens(ctx, data->dt, true);
 
     cudaStatus = cudaDeviceSynchronize();
-    cudaStatus = cudaMemcpy(data->u,    ctx->dev_u,     arrSize, cudaMemcpyDeviceToHost);
-    cudaStatus = cudaMemcpy(data->v,    ctx->dev_v,     arrSize, cudaMemcpyDeviceToHost);
-    cudaStatus = cudaMemcpy(data->dens, ctx->dev_dens,  arrSize, cudaMemcpyDeviceToHost);
-    cudaStatus = cudaMemcpy(data->temp, ctx->dev_temp,  arrSize, cudaMemcpyDeviceToHost);
+    cudaStatus = cudaMemcpy2D(data->u,    hostPitch, ctx->dev_u,     rowSize, rowSize, rows, cudaMemcpyDeviceToHost);
+    cudaStatus = cudaMemcpy2D(data->v,    hostPitch, ctx->dev_v,     rowSize, rowSize, rows, cudaMemcpyDeviceToHost);
+    cudaStatus = cudaMemcpy2D(data->dens, hostPitch, ctx->dev_dens,  rowSize, rowSize, rows, cudaMemcpyDeviceToHost);
+    cudaStatus = cudaMemcpy2D(data->temp, hostPitch, ctx->dev_temp,  rowSize, rowSize, rows, cudaMemcpyDeviceToHost);
 }
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "AdvectKernels.h"
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ZSIM_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC allows intrinsics of any instruction set without compiler flags
+#define ZSIM_TARGET_SSE41
+#define ZSIM_TARGET_AVX2
+#else
+#define ZSIM_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define ZSIM_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+    void AdvectRowScalar(int W, int H, int pitch, int j, int iStart, int iEnd, float dt0, const float* u, const float* v, const float* d0, float* d)
+    {
+        const int stride = pitch;
+        for (int i = iStart; i < iEnd; i++)
+        {
+            int index = j * stride + i;
+            float x = i - dt0 * u[index];
+            float y = j - dt0 * v[index];
+            if (x < 0.5f)
+                x = 0.5f;
+            if (x > W + 0.5f)
+                x = W + 0.5f;
+            if (y < 0.5f)
+                y = 0.5f;
+            if (y > H + 0.5f)
+                y = H + 0.5f;
+            int i0 = (int)x;
+            int j0 = (int)y;
+
+            float s1 = x - i0;
+            float s0 = 1 - s1;
+            float t1 = y - j0;
+            float t0 = 1 - t1;
+
+            int index00 = j0 * stride + i0;
+            d[index] =
+                s0 * (t0 * d0[index00] + t1 * d0[index00 + stride]) +
+                s1 * (t0 * d0[index00 + 1] + t1 * d0[index00 + stride + 1]);
+        }
+    }
+
+#ifdef ZSIM_X86
+    ZSIM_TARGET_SSE41
+    void AdvectRowSSE41(int W, int H, int pitch, int j, int iStart, int iEnd, float dt0, const float* u, const float* v, const float* d0, float* d)
+    {
+        const int stride = pitch;
+        const __m128 dt0v = _mm_set1_ps(dt0);
+        const __m128 minv = _mm_set1_ps(0.5f);
+        const __m128 maxXv = _mm_set1_ps(W + 0.5f);
+        const __m128 maxYv = _mm_set1_ps(H + 0.5f);
+        const __m128 onev = _mm_set1_ps(1.0f);
+        const __m128 rowv = _mm_set1_ps((float)j);
+        const __m128i stridev = _mm_set1_epi32(stride);
+        const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        alignas(16) int idx[4];
+
+        int i = iStart;
+        for (; i + 3 < iEnd; i += 4)
+        {
+            int index = j * stride + i;
+            __m128 x = _mm_add_ps(_mm_set1_ps((float)i), laneOffsets);
+            x = _mm_sub_ps(x, _mm_mul_ps(dt0v, _mm_loadu_ps(u + index)));
+            __m128 y = _mm_sub_ps(rowv, _mm_mul_ps(dt0v, _mm_loadu_ps(v + index)));
+            x = _mm_min_ps(_mm_max_ps(x, minv), maxXv);
+            y = _mm_min_ps(_mm_max_ps(y, minv), maxYv);
+
+            // Coordinates are at least 0.5, so truncation is the same as floor
+            __m128i i0 = _mm_cvttps_epi32(x);
+            __m128i j0 = _mm_cvttps_epi32(y);
+            __m128 s1 = _mm_sub_ps(x, _mm_cvtepi32_ps(i0));
+            __m128 s0 = _mm_sub_ps(onev, s1);
+            __m128 t1 = _mm_sub_ps(y, _mm_cvtepi32_ps(j0));
+            __m128 t0 = _mm_sub_ps(onev, t1);
+
+            // No gather instruction before AVX2, the 4 corners are loaded one lane at a time
+            _mm_store_si128((__m128i*)idx, _mm_add_epi32(_mm_mullo_epi32(j0, stridev), i0));
+            __m128 d00 = _mm_setr_ps(d0[idx[0]], d0[idx[1]], d0[idx[2]], d0[idx[3]]);
+            __m128 d10 = _mm_setr_ps(d0[idx[0] + 1], d0[idx[1] + 1], d0[idx[2] + 1], d0[idx[3] + 1]);
+            __m128 d01 = _mm_setr_ps(d0[idx[0] + stride], d0[idx[1] + stride], d0[idx[2] + stride], d0[idx[3] + stride]);
+            __m128 d11 = _mm_setr_ps(d0[idx[0] + stride + 1], d0[idx[1] + stride + 1], d0[idx[2] + stride + 1], d0[idx[3] + stride + 1]);
+
+            __m128 left = _mm_add_ps(_mm_mul_ps(t0, d00), _mm_mul_ps(t1, d01));
+            __m128 right = _mm_add_ps(_mm_mul_ps(t0, d10), _mm_mul_ps(t1, d11));
+            _mm_storeu_ps(d + index, _mm_add_ps(_mm_mul_ps(s0, left), _mm_mul_ps(s1, right)));
+        }
+        // Leftover cells
+        AdvectRowScalar(W, H, pitch, j, i, iEnd, dt0, u, v, d0, d);
+    }
+
+    ZSIM_TARGET_AVX2
+    void AdvectRowAVX2(int W, int H, int pitch, int j, int iStart, int iEnd, float dt0, const float* u, const float* v, const float* d0, float* d)
+    {
+        const int stride = pitch;
+        const __m256 dt0v = _mm256_set1_ps(dt0);
+        const __m256 minv = _mm256_set1_ps(0.5f);
+        const __m256 maxXv = _mm256_set1_ps(W + 0.5f);
+        const __m256 maxYv = _mm256_set1_ps(H + 0.5f);
+        const __m256 onev = _mm256_set1_ps(1.0f);
+        const __m256 rowv = _mm256_set1_ps((float)j);
+        const __m256i stridev = _mm256_set1_epi32(stride);
+        const __m256i onei = _mm256_set1_epi32(1);
+        const __m256 laneOffsets = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+
+        int i = iStart;
+        for (; i + 7 < iEnd; i += 8)
+        {
+            int index = j * stride + i;
+            __m256 x = _mm256_add_ps(_mm256_set1_ps((float)i), laneOffsets);
+            x = _mm256_sub_ps(x, _mm256_mul_ps(dt0v, _mm256_loadu_ps(u + index)));
+            __m256 y = _mm256_sub_ps(rowv, _mm256_mul_ps(dt0v, _mm256_loadu_ps(v + index)));
+            x = _mm256_min_ps(_mm256_max_ps(x, minv), maxXv);
+            y = _mm256_min_ps(_mm256_max_ps(y, minv), maxYv);
+
+            // Coordinates are at least 0.5, so truncation is the same as floor
+            __m256i i0 = _mm256_cvttps_epi32(x);
+            __m256i j0 = _mm256_cvttps_epi32(y);
+            __m256 s1 = _mm256_sub_ps(x, _mm256_cvtepi32_ps(i0));
+            __m256 s0 = _mm256_sub_ps(onev, s1);
+            __m256 t1 = _mm256_sub_ps(y, _mm256_cvtepi32_ps(j0));
+            __m256 t0 = _mm256_sub_ps(onev, t1);
+
+            __m256i index00 = _mm256_add_epi32(_mm256_mullo_epi32(j0, stridev), i0);
+            __m256i index01 = _mm256_add_epi32(index00, stridev);
+            __m256 d00 = _mm256_i32gather_ps(d0, index00, 4);
+            __m256 d10 = _mm256_i32gather_ps(d0, _mm256_add_epi32(index00, onei), 4);
+            __m256 d01 = _mm256_i32gather_ps(d0, index01, 4);
+            __m256 d11 = _mm256_i32gather_ps(d0, _mm256_add_epi32(index01, onei), 4);
+
+            __m256 left = _mm256_add_ps(_mm256_mul_ps(t0, d00), _mm256_mul_ps(t1, d01));
+            __m256 right = _mm256_add_ps(_mm256_mul_ps(t0, d10), _mm256_mul_ps(t1, d11));
+            _mm256_storeu_ps(d + index, _mm256_add_ps(_mm256_mul_ps(s0, left), _mm256_mul_ps(s1, right)));
+        }
+        // Leftover cells
+        AdvectRowScalar(W, H, pitch, j, i, iEnd, dt0, u, v, d0, d);
+    }
+#endif
+}
+
+zsim::SimdLevel zsim::DetectSimdLevel()
+{
+#ifdef ZSIM_X86
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+
+    bool avx2 = false;
+    // AVX2 also needs the OS to save the upper halves of the ymm registers
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    bool sse41 = __builtin_cpu_supports("sse4.1");
+    bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+    if (avx2)
+        return SimdLevel::AVX2;
+    if (sse41)
+        return SimdLevel::SSE41;
+#endif
+    return SimdLevel::SCALAR;
+}
+
+zsim::AdvectRowFunc zsim::GetAdvectRowKernel(SimdLevel level)
+{
+#ifdef ZSIM_X86
+    if (level == SimdLevel::AVX2)
+        return AdvectRowAVX2;
+    if (level == SimdLevel::SSE41)
+        return AdvectRowSSE41;
+#endif
+    return AdvectRowScalar;
+}
+
+void zsim::MacCormackCorrectRow(int W, int H, int pitch, int j, int iStart, int iEnd, float dt0, const float* u, const float* v, const float* d0, const float* back, float* d)
+{
+    const int stride = pitch;
+    for (int i = iStart; i < iEnd; i++)
+    {
+        int index = j * stride + i;
+        // Same back-traced position as the forward pass
+        float x = i - dt0 * u[index];
+        float y = j - dt0 * v[index];
+        if (x < 0.5f)
+            x = 0.5f;
+        if (x > W + 0.5f)
+            x = W + 0.5f;
+        if (y < 0.5f)
+            y = 0.5f;
+        if (y > H + 0.5f)
+            y = H + 0.5f;
+        int index00 = (int)y * stride + (int)x;
+        float c00 = d0[index00];
+        float c10 = d0[index00 + 1];
+        float c01 = d0[index00 + stride];
+        float c11 = d0[index00 + stride + 1];
+        float lo = std::min(std::min(c00, c10), std::min(c01, c11));
+        float hi = std::max(std::max(c00, c10), std::max(c01, c11));
+
+        float corrected = d[index] + 0.5f * (d0[index] - back[index]);
+        d[index] = std::clamp(corrected, lo, hi);
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "SmokeSolverSettings.h"
+
+namespace zsim
+{
+    // Semi-Lagrangian advection of cells [iStart, iEnd) of row 'j':
+    //  d[i, j] = d0 bilinearly sampled at (i - dt0 * u[i, j], j - dt0 * v[i, j])
+    // Fields have (W + 2) * (H + 2) cells, 'pitch' apart per row. Only interior cells may be passed
+    using AdvectRowFunc = void(*)(int W, int H, int pitch, int j, int iStart, int iEnd, float dt0, const float* u, const float* v, const float* d0, float* d);
+
+    // Highest instruction set supported by both the CPU and this build
+    SimdLevel DetectSimdLevel();
+
+    // The vector kernels perform the same float operations in the same order as the scalar one and don't use FMA,
+    // so they match it bit for bit. If the compiler contracts the scalar kernel into FMA (e.g. -march=native)
+    // the difference stays within 1e-6 relative
+    AdvectRowFunc GetAdvectRowKernel(SimdLevel level);
+
+    // MacCormack correction of cells [iStart, iEnd) of row 'j'. 'd' holds the forward semi-Lagrangian result
+    // and 'back' that result advected backwards, with -dt0. Replaces 'd' with d + (d0 - back) / 2, clamped
+    // to the 4 cells of 'd0' the forward pass interpolated between
+    void MacCormackCorrectRow(int W, int H, int pitch, int j, int iStart, int iEnd, float dt0, const float* u, const float* v, const float* d0, const float* back, float* d);
+}
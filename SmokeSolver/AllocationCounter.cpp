@@ -0,0 +1,97 @@
+#include "AllocationCounter.h"
+
+#ifdef ZSIM_COUNT_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    thread_local int64_t allocationCount = 0;
+    std::atomic<int64_t> processAllocationCount = 0;
+
+    void CountAllocation()
+    {
+        allocationCount++;
+        processAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void* AlignedAlloc(std::size_t size, std::size_t alignment)
+    {
+#ifdef _MSC_VER
+        return _aligned_malloc(size ? size : 1, alignment);
+#else
+        // std::aligned_alloc wants a multiple of the alignment
+        size = (size + alignment - 1) / alignment * alignment;
+        return std::aligned_alloc(alignment, size ? size : alignment);
+#endif
+    }
+
+    void AlignedFree(void* ptr)
+    {
+#ifdef _MSC_VER
+        _aligned_free(ptr);
+#else
+        std::free(ptr);
+#endif
+    }
+}
+
+// The array and nothrow forms of the default library call these
+void* operator new(std::size_t size)
+{
+    CountAllocation();
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+// Used for over-aligned types, e.g. the cache line sized rows of Grid2D
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    CountAllocation();
+    if (void* ptr = AlignedAlloc(size, (std::size_t)alignment))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    AlignedFree(ptr);
+}
+
+int64_t zsim::ThreadAllocationCount()
+{
+    return allocationCount;
+}
+
+int64_t zsim::ProcessAllocationCount()
+{
+    return processAllocationCount.load(std::memory_order_relaxed);
+}
+#else
+int64_t zsim::ThreadAllocationCount()
+{
+    return 0;
+}
+
+int64_t zsim::ProcessAllocationCount()
+{
+    return 0;
+}
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+namespace zsim
+{
+    // Number of heap allocations made through operator new by the calling thread.
+    //
+    // Counting replaces the global operator new, so it's only compiled in when ZSIM_COUNT_ALLOCATIONS is defined.
+    // Without it this always returns 0
+    int64_t ThreadAllocationCount();
+    // Same for all threads together, including the solver workers
+    int64_t ProcessAllocationCount();
+
+    constexpr bool AllocationCountingEnabled()
+    {
+#ifdef ZSIM_COUNT_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+}
@@ -0,0 +1,275 @@
+#include "AutoTuner.h"
+#include "SmokeSolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    float ElapsedMs(Clock::time_point start, Clock::time_point end)
+    {
+        return std::chrono::duration<float, std::milli>(end - start).count();
+    }
+
+    float Median(std::vector<float> values)
+    {
+        if (values.empty())
+            return 0.0f;
+        auto mid = values.begin() + values.size() / 2;
+        std::nth_element(values.begin(), mid, values.end());
+        return *mid;
+    }
+
+    std::vector<int> DefaultThreadCounts()
+    {
+        // The thread calling Step() also works, so one less than the hardware count is the useful maximum
+        int maxThreads = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+        std::vector<int> counts;
+        for (int count : { 1, 2, 3, 4, 6, 8, 12, 16 })
+            if (count <= maxThreads)
+                counts.push_back(count);
+        return counts;
+    }
+
+    std::vector<zsim::SimdLevel> SupportedSimdLevels()
+    {
+        std::vector<zsim::SimdLevel> levels;
+        zsim::SimdLevel maxLevel = zsim::DetectSimdLevel();
+        for (zsim::SimdLevel level : { zsim::SimdLevel::SCALAR, zsim::SimdLevel::SSE41, zsim::SimdLevel::AVX2 })
+            if (level <= maxLevel)
+                levels.push_back(level);
+        return levels;
+    }
+
+    float MaxDivergence(zsim::SmokeSolver& solver)
+    {
+        const float* u = solver.U();
+        const float* v = solver.V();
+        int pitch = solver.Pitch();
+        float result = 0.0f;
+        for (int y = 1; y <= solver.Height(); y++)
+        {
+            for (int x = 1; x <= solver.Width(); x++)
+            {
+                int index = y * pitch + x;
+                float divergence = 0.5f * (u[index + 1] - u[index - 1] + v[index + pitch] - v[index - pitch]);
+                result = std::max(result, std::fabs(divergence));
+            }
+        }
+        return result;
+    }
+
+    zsim::AutoTuneSample Measure(const zsim::AutoTuneSettings& settings, zsim::AutoTuneSample sample)
+    {
+        int width = std::max(settings.pixelWidth / sample.cellSize, 1);
+        int height = std::max(settings.pixelHeight / sample.cellSize, 1);
+        zsim::SmokeSolver solver(settings.simType, width, height, sample.cellSize, sample.threadCount);
+        solver.SetSimdLevel(sample.simdLevel);
+        zsim::ProjectionSettings projection;
+        projection.mode = sample.projectionMode;
+        solver.SetProjectionSettings(projection);
+
+        // Parameters close to the overlay defaults
+        zsim::SmokeStepParams params;
+        params.temperatureDiffusion = settings.simType == zsim::SmokeSimType::CURSOR_TRAIL ? 6.0f : 0.0f;
+        params.densityReductionRate = settings.simType == zsim::SmokeSimType::CURSOR_TRAIL ? 0.15f : 0.02f;
+        params.temperatureReductionRate = settings.simType == zsim::SmokeSimType::CURSOR_TRAIL ? 0.05f : 0.0f;
+        zsim::SmokeStroke stroke;
+        stroke.lineThickness = 10.0f;
+        stroke.fadeRange = 8.0f;
+        stroke.lineDensity = 0.7f;
+        stroke.windThickness = 10.0f;
+        stroke.windMultiplier = 0.2f;
+        stroke.cursorTemp = settings.simType == zsim::SmokeSimType::CURSOR_TRAIL ? 0.4f : 0.0f;
+
+        const float dt = 1.0f / std::max(settings.targetStepRate, 1.0f);
+        std::vector<float> sourcesMs;
+        std::vector<float> stepMs;
+        std::vector<float> totalMs;
+        std::vector<float> pressureIterations;
+        std::vector<float> pressureResidual;
+        std::vector<float> divergence;
+        float prevX = 0.0f;
+        float prevY = 0.0f;
+        int stepCount = settings.warmupSteps + settings.measuredSteps;
+        for (int step = 0; step < stepCount; step++)
+        {
+            // Cursor sweeping across most of the screen, similar to jumps between circles
+            float t = step * dt;
+            float x = settings.pixelWidth * (0.5f + 0.4f * std::sin(t * 3.1f));
+            float y = settings.pixelHeight * (0.5f + 0.4f * std::sin(t * 4.3f + 0.5f));
+            if (step == 0)
+            {
+                prevX = x;
+                prevY = y;
+            }
+
+            auto start = Clock::now();
+            solver.ClearSources();
+            stroke.startX = prevX;
+            stroke.startY = prevY;
+            stroke.endX = x;
+            stroke.endY = y;
+            solver.AddStroke(stroke, dt);
+            solver.ApplySources(dt, dt, params);
+            auto sourcesEnd = Clock::now();
+            solver.Step(dt, params);
+            auto end = Clock::now();
+
+            prevX = x;
+            prevY = y;
+            if (step < settings.warmupSteps)
+                continue;
+            sourcesMs.push_back(ElapsedMs(start, sourcesEnd));
+            stepMs.push_back(ElapsedMs(sourcesEnd, end));
+            totalMs.push_back(ElapsedMs(start, end));
+            const auto& projectionStats = solver.LastStepProjectionStats();
+            pressureIterations.push_back(float(projectionStats[0].iterations + projectionStats[1].iterations));
+            pressureResidual.push_back(std::max(projectionStats[0].residual, projectionStats[1].residual));
+            divergence.push_back(MaxDivergence(solver));
+        }
+
+        sample.sourcesMs = Median(sourcesMs);
+        sample.stepMs = Median(stepMs);
+        sample.totalMs = Median(totalMs);
+        sample.pressureIterations = Median(pressureIterations);
+        sample.pressureResidual = Median(pressureResidual);
+        sample.divergence = Median(divergence);
+        return sample;
+    }
+}
+
+zsim::AutoTuneResult zsim::RunAutoTune(const AutoTuneSettings& settings, const std::function<bool(int, int)>& progress)
+{
+    std::vector<int> cellSizes = settings.cellSizes;
+    std::sort(cellSizes.begin(), cellSizes.end(), std::greater<int>());
+    cellSizes.erase(std::remove_if(cellSizes.begin(), cellSizes.end(), [](int size) { return size < 1; }), cellSizes.end());
+    std::vector<int> threadCounts = settings.threadCounts.empty() ? DefaultThreadCounts() : settings.threadCounts;
+    std::vector<SimdLevel> simdLevels = settings.simdLevels.empty() ? SupportedSimdLevels() : settings.simdLevels;
+
+    AutoTuneResult result;
+    result.budgetMs = 1000.0f / std::max(settings.targetStepRate, 1.0f) * settings.budgetFraction;
+
+    int total = (int)(cellSizes.size() * threadCounts.size() * simdLevels.size() * settings.projectionModes.size());
+    int done = 0;
+    bool cancelled = false;
+    for (size_t m = 0; m < settings.projectionModes.size() && !cancelled; m++)
+    {
+        for (size_t s = 0; s < simdLevels.size() && !cancelled; s++)
+        {
+            for (size_t t = 0; t < threadCounts.size() && !cancelled; t++)
+            {
+                for (size_t i = 0; i < cellSizes.size() && !cancelled; i++)
+                {
+                    AutoTuneSample sample;
+                    sample.cellSize = cellSizes[i];
+                    sample.threadCount = threadCounts[t];
+                    sample.simdLevel = simdLevels[s];
+                    sample.projectionMode = settings.projectionModes[m];
+                    sample = Measure(settings, sample);
+                    sample.meetsTarget = sample.totalMs <= result.budgetMs;
+                    result.samples.push_back(sample);
+                    done++;
+
+                    // Finer grids only get slower
+                    if (!sample.meetsTarget)
+                        done += (int)(cellSizes.size() - i - 1);
+                    if (progress && !progress(done, total))
+                        cancelled = true;
+                    if (!sample.meetsTarget)
+                        break;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < (int)result.samples.size(); i++)
+    {
+        if (result.bestIndex == -1)
+        {
+            result.bestIndex = i;
+            continue;
+        }
+        const AutoTuneSample& sample = result.samples[i];
+        const AutoTuneSample& best = result.samples[result.bestIndex];
+        if (sample.meetsTarget != best.meetsTarget)
+        {
+            if (sample.meetsTarget)
+                result.bestIndex = i;
+        }
+        else if (sample.meetsTarget && sample.cellSize != best.cellSize)
+        {
+            if (sample.cellSize < best.cellSize)
+                result.bestIndex = i;
+        }
+        else if (sample.totalMs < best.totalMs)
+        {
+            result.bestIndex = i;
+        }
+    }
+    return result;
+}
+
+std::string zsim::AutoTuneResult::ToCsv() const
+{
+    std::ostringstream ss;
+    ss << "cellSize,threadCount,simdLevel,projectionMode,sourcesMs,stepMs,totalMs,pressureIterations,pressureResidual,divergence,meetsTarget,best\n";
+    for (int i = 0; i < (int)samples.size(); i++)
+    {
+        const AutoTuneSample& sample = samples[i];
+        ss << sample.cellSize << ','
+            << sample.threadCount << ','
+            << SimdLevelName(sample.simdLevel) << ','
+            << ProjectionModeName(sample.projectionMode) << ','
+            << sample.sourcesMs << ','
+            << sample.stepMs << ','
+            << sample.totalMs << ','
+            << sample.pressureIterations << ','
+            << sample.pressureResidual << ','
+            << sample.divergence << ','
+            << (sample.meetsTarget ? 1 : 0) << ','
+            << (i == bestIndex ? 1 : 0) << '\n';
+    }
+    return ss.str();
+}
+
+const char* zsim::SimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::SSE41: return "SSE4.1";
+    case SimdLevel::AVX2: return "AVX2";
+    default: return "scalar";
+    }
+}
+
+const char* zsim::ProjectionModeName(ProjectionMode mode)
+{
+    switch (mode)
+    {
+    case ProjectionMode::MULTIGRID: return "multigrid";
+    case ProjectionMode::PCG: return "pcg";
+    case ProjectionMode::FFT: return "fft";
+    default: return "gauss-seidel";
+    }
+}
+
+const char* zsim::SolverStageName(SolverStage stage)
+{
+    switch (stage)
+    {
+    case SolverStage::STROKES: return "strokes";
+    case SolverStage::SOURCES: return "sources";
+    case SolverStage::DIFFUSE: return "diffuse";
+    case SolverStage::ADVECT: return "advect";
+    case SolverStage::PROJECT: return "project";
+    case SolverStage::SET_BOUNDARY: return "set-boundary";
+    case SolverStage::TILES: return "tiles";
+    default: return "unknown";
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "SmokeSimType.h"
+#include "SmokeSolverSettings.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace zsim
+{
+    struct AutoTuneSettings
+    {
+        SmokeSimType simType = SmokeSimType::CURSOR_TRAIL;
+        // Overlay size in pixels
+        int pixelWidth = 1920;
+        int pixelHeight = 1080;
+        std::vector<int> cellSizes = { 2, 3, 4, 5, 6, 8 };
+        // Solver thread counts to try. Empty means a spread up to the hardware thread count
+        std::vector<int> threadCounts;
+        // Empty means every level supported by the CPU
+        std::vector<SimdLevel> simdLevels;
+        std::vector<ProjectionMode> projectionModes = { ProjectionMode::GAUSS_SEIDEL, ProjectionMode::MULTIGRID, ProjectionMode::PCG, ProjectionMode::FFT };
+        // Steps per second the overlay runs at
+        float targetStepRate = 144.0f;
+        // Fraction of the step interval the solver may take, the rest is left for the game
+        float budgetFraction = 0.5f;
+        int warmupSteps = 10;
+        int measuredSteps = 40;
+    };
+
+    struct AutoTuneSample
+    {
+        int cellSize = 0;
+        int threadCount = 0;
+        SimdLevel simdLevel = SimdLevel::SCALAR;
+        ProjectionMode projectionMode = ProjectionMode::GAUSS_SEIDEL;
+        // Medians over the measured steps. 'sourcesMs' covers ClearSources, AddStroke and ApplySources
+        float sourcesMs = 0.0f;
+        float stepMs = 0.0f;
+        float totalMs = 0.0f;
+        // Medians of the pressure solver iterations summed over a step and of the worse residual of its two solves
+        float pressureIterations = 0.0f;
+        float pressureResidual = 0.0f;
+        // Median of the largest central difference divergence left in the velocity after a step, in cells per step
+        float divergence = 0.0f;
+        bool meetsTarget = false;
+    };
+
+    struct AutoTuneResult
+    {
+        float budgetMs = 0.0f;
+        // Every measured combination, in measurement order
+        std::vector<AutoTuneSample> samples;
+        // Smallest cell size that meets the budget, fastest configuration among those.
+        // The fastest overall if nothing meets it, -1 if nothing was measured
+        int bestIndex = -1;
+
+        const AutoTuneSample* Best() const { return bestIndex >= 0 ? &samples[bestIndex] : nullptr; }
+        // One line per sample, with a header line
+        std::string ToCsv() const;
+    };
+
+    // Runs a scripted cursor workload on a solver for each candidate combination and times it. Cell sizes are
+    // tried from coarsest to finest and finer ones are skipped once a combination misses the budget.
+    // 'progress' receives (done, total) after each combination, returning false cancels the remaining ones
+    AutoTuneResult RunAutoTune(const AutoTuneSettings& settings, const std::function<bool(int, int)>& progress = nullptr);
+
+    const char* SimdLevelName(SimdLevel level);
+    const char* ProjectionModeName(ProjectionMode mode);
+    const char* SolverStageName(SolverStage stage);
+}
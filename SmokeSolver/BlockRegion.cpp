@@ -0,0 +1,157 @@
+#include "BlockRegion.h"
+
+#include <algorithm>
+
+void zsim::BlockRegion::Reset(int blocksX, int blocksY)
+{
+    _blocksX = std::max(blocksX, 0);
+    _blocksY = std::max(blocksY, 0);
+    _blocks.assign(_blocksX * _blocksY, 0);
+    _count = 0;
+}
+
+bool zsim::BlockRegion::Contains(int x, int y) const
+{
+    if (x < 0 || y < 0 || x >= _blocksX || y >= _blocksY)
+        return false;
+    return _blocks[y * _blocksX + x] != 0;
+}
+
+void zsim::BlockRegion::Add(int x, int y)
+{
+    if (x < 0 || y < 0 || x >= _blocksX || y >= _blocksY)
+        return;
+    char& block = _blocks[y * _blocksX + x];
+    if (!block)
+    {
+        block = 1;
+        _count++;
+    }
+}
+
+void zsim::BlockRegion::AddRect(const RegionRect& rect)
+{
+    int left = std::max(rect.left, 0);
+    int top = std::max(rect.top, 0);
+    int right = std::min(rect.right, _blocksX);
+    int bottom = std::min(rect.bottom, _blocksY);
+    for (int y = top; y < bottom; y++)
+        for (int x = left; x < right; x++)
+            Add(x, y);
+}
+
+void zsim::BlockRegion::AddAll()
+{
+    std::fill(_blocks.begin(), _blocks.end(), 1);
+    _count = _blocksX * _blocksY;
+}
+
+void zsim::BlockRegion::Union(const BlockRegion& other)
+{
+    if (other._blocksX != _blocksX || other._blocksY != _blocksY)
+    {
+        AddAll();
+        return;
+    }
+    if (other.Empty() || Full())
+        return;
+
+    for (size_t i = 0; i < _blocks.size(); i++)
+    {
+        if (other._blocks[i] && !_blocks[i])
+        {
+            _blocks[i] = 1;
+            _count++;
+        }
+    }
+}
+
+void zsim::BlockRegion::Clear()
+{
+    if (_count == 0)
+        return;
+    std::fill(_blocks.begin(), _blocks.end(), 0);
+    _count = 0;
+}
+
+zsim::RegionRect zsim::BlockRegion::Bounds() const
+{
+    if (Empty())
+        return RegionRect();
+
+    RegionRect bounds = { _blocksX, _blocksY, 0, 0 };
+    for (int y = 0; y < _blocksY; y++)
+    {
+        for (int x = 0; x < _blocksX; x++)
+        {
+            if (!_blocks[y * _blocksX + x])
+                continue;
+            bounds.left = std::min(bounds.left, x);
+            bounds.top = std::min(bounds.top, y);
+            bounds.right = std::max(bounds.right, x + 1);
+            bounds.bottom = std::max(bounds.bottom, y + 1);
+        }
+    }
+    return bounds;
+}
+
+void zsim::BlockRegion::GetRects(std::vector<RegionRect>& rects) const
+{
+    // At most one rectangle per run, and runs are separated by at least one block. Reserving that up front,
+    // even for an empty region, means only a change of grid size makes this allocate
+    rects.clear();
+    rects.reserve((size_t)_blocksY * ((_blocksX + 1) / 2));
+    if (Empty())
+        return;
+
+    // Rectangles reaching the previous row are [openStart, rects.size())
+    size_t openStart = 0;
+    for (int y = 0; y < _blocksY; y++)
+    {
+        size_t rowStart = rects.size();
+        int x = 0;
+        while (x < _blocksX)
+        {
+            if (!_blocks[y * _blocksX + x])
+            {
+                x++;
+                continue;
+            }
+            int runStart = x;
+            while (x < _blocksX && _blocks[y * _blocksX + x])
+                x++;
+
+            // Extend a rectangle from the row above if it has the same extent
+            bool extended = false;
+            for (size_t i = openStart; i < rowStart; i++)
+            {
+                RegionRect& rect = rects[i];
+                if (rect.bottom == y && rect.left == runStart && rect.right == x)
+                {
+                    rect.bottom = y + 1;
+                    extended = true;
+                    break;
+                }
+            }
+            if (!extended)
+                rects.push_back({ runStart, y, x, y + 1 });
+        }
+
+        // Move the rectangles that reach this row to the end, so the open ones stay contiguous.
+        // Order doesn't matter and std::partition works in place, unlike std::stable_partition
+        auto closedEnd = std::partition(rects.begin() + openStart, rects.end(), [=](const RegionRect& rect) {
+            return rect.bottom != y + 1;
+            });
+        openStart = closedEnd - rects.begin();
+    }
+}
+
+zsim::RegionRect zsim::BlockRegion::ToCells(const RegionRect& blocks, int blockSize, int width, int height)
+{
+    RegionRect cells;
+    cells.left = std::min(blocks.left * blockSize, width);
+    cells.top = std::min(blocks.top * blockSize, height);
+    cells.right = std::min(blocks.right * blockSize, width);
+    cells.bottom = std::min(blocks.bottom * blockSize, height);
+    return cells;
+}
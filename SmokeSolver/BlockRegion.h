@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+namespace zsim
+{
+    // Rectangle with exclusive right and bottom edges
+    struct RegionRect
+    {
+        int left = 0;
+        int top = 0;
+        int right = 0;
+        int bottom = 0;
+
+        int Width() const { return right - left; }
+        int Height() const { return bottom - top; }
+        bool Empty() const { return right <= left || bottom <= top; }
+    };
+
+    // Set of blocks on a fixed size grid, used to track which parts of a frame changed.
+    // Has no dependencies on the solver so it can be used and tested on its own
+    class BlockRegion
+    {
+    public:
+        BlockRegion() {}
+        BlockRegion(int blocksX, int blocksY) { Reset(blocksX, blocksY); }
+
+        // Changes the grid size and clears the region
+        void Reset(int blocksX, int blocksY);
+        int BlocksX() const { return _blocksX; }
+        int BlocksY() const { return _blocksY; }
+
+        bool Empty() const { return _count == 0; }
+        bool Full() const { return _count == _blocksX * _blocksY; }
+        int Count() const { return _count; }
+        bool Contains(int x, int y) const;
+
+        void Add(int x, int y);
+        // Clipped to the grid
+        void AddRect(const RegionRect& rect);
+        void AddAll();
+        // Regions of a different grid size can't be combined block by block, so the result becomes full
+        void Union(const BlockRegion& other);
+        void Clear();
+
+        // Smallest rectangle containing every block, empty if the region is
+        RegionRect Bounds() const;
+        // Covers the region exactly with non overlapping rectangles: horizontal runs of each row, merged with
+        // runs of the same extent in the rows below. 'rects' is overwritten, its capacity is reused
+        void GetRects(std::vector<RegionRect>& rects) const;
+
+        // Converts a rectangle in blocks to one in cells, clamped to a width * height grid
+        static RegionRect ToCells(const RegionRect& blocks, int blockSize, int width, int height);
+
+    private:
+        int _blocksX = 0;
+        int _blocksY = 0;
+        int _count = 0;
+        std::vector<char> _blocks;
+    };
+}
@@ -0,0 +1,255 @@
+#include "ColorMapper.h"
+#include "AdvectKernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ZSIM_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define ZSIM_TARGET_SSE41
+#define ZSIM_TARGET_AVX2
+#else
+#define ZSIM_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define ZSIM_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+    using Tables = zsim::ColorMapper::Tables;
+    constexpr float LUT_SCALE = zsim::ColorMapper::LUT_SIZE - 1;
+
+    // Written so NaN ends up as 1, same as the min/max instructions
+    inline float Clamp01(float value)
+    {
+        value = value < 1.0f ? value : 1.0f;
+        return value > 0.0f ? value : 0.0f;
+    }
+
+    inline int LutIndex(float density)
+    {
+        return (int)(Clamp01(density) * LUT_SCALE + 0.5f);
+    }
+
+    void MapDensityScalar(const Tables& tables, const float* density, const float*, int count, uint32_t* out)
+    {
+        for (int i = 0; i < count; i++)
+            out[i] = tables.pixels[LutIndex(density[i])];
+    }
+
+    void MapTemperatureScalar(const Tables& tables, const float* density, const float* temperature, int count, uint32_t* out)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            float intensity = tables.intensity[LutIndex(density[i])];
+            float t = Clamp01(temperature[i] * tables.temperatureScale);
+            uint32_t pixel = 0;
+            for (int c = 0; c < 4; c++)
+            {
+                float value = (tables.base[c] + (tables.hot[c] - tables.base[c]) * t) * intensity;
+                pixel |= (uint32_t)(int)(value + 0.5f) << (c * 8);
+            }
+            out[i] = pixel;
+        }
+    }
+
+#ifdef ZSIM_X86
+    ZSIM_TARGET_SSE41
+    inline __m128i LutIndexSSE41(__m128 density)
+    {
+        density = _mm_max_ps(_mm_min_ps(density, _mm_set1_ps(1.0f)), _mm_setzero_ps());
+        return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(density, _mm_set1_ps(LUT_SCALE)), _mm_set1_ps(0.5f)));
+    }
+
+    ZSIM_TARGET_SSE41
+    void MapDensitySSE41(const Tables& tables, const float* density, const float* temperature, int count, uint32_t* out)
+    {
+        alignas(16) int idx[4];
+        int i = 0;
+        for (; i + 3 < count; i += 4)
+        {
+            // No gather before AVX2, the table reads are done one lane at a time
+            _mm_store_si128((__m128i*)idx, LutIndexSSE41(_mm_loadu_ps(density + i)));
+            out[i + 0] = tables.pixels[idx[0]];
+            out[i + 1] = tables.pixels[idx[1]];
+            out[i + 2] = tables.pixels[idx[2]];
+            out[i + 3] = tables.pixels[idx[3]];
+        }
+        // Leftover cells
+        MapDensityScalar(tables, density + i, temperature, count - i, out + i);
+    }
+
+    ZSIM_TARGET_SSE41
+    void MapTemperatureSSE41(const Tables& tables, const float* density, const float* temperature, int count, uint32_t* out)
+    {
+        alignas(16) int idx[4];
+        const __m128 onev = _mm_set1_ps(1.0f);
+        const __m128 halfv = _mm_set1_ps(0.5f);
+        const __m128 scalev = _mm_set1_ps(tables.temperatureScale);
+        int i = 0;
+        for (; i + 3 < count; i += 4)
+        {
+            _mm_store_si128((__m128i*)idx, LutIndexSSE41(_mm_loadu_ps(density + i)));
+            __m128 intensity = _mm_setr_ps(tables.intensity[idx[0]], tables.intensity[idx[1]], tables.intensity[idx[2]], tables.intensity[idx[3]]);
+            __m128 t = _mm_mul_ps(_mm_loadu_ps(temperature + i), scalev);
+            t = _mm_max_ps(_mm_min_ps(t, onev), _mm_setzero_ps());
+
+            __m128i pixels = _mm_setzero_si128();
+            for (int c = 0; c < 4; c++)
+            {
+                __m128 base = _mm_set1_ps(tables.base[c]);
+                __m128 delta = _mm_set1_ps(tables.hot[c] - tables.base[c]);
+                __m128 value = _mm_mul_ps(_mm_add_ps(base, _mm_mul_ps(delta, t)), intensity);
+                __m128i channel = _mm_cvttps_epi32(_mm_add_ps(value, halfv));
+                pixels = _mm_or_si128(pixels, _mm_sll_epi32(channel, _mm_cvtsi32_si128(c * 8)));
+            }
+            _mm_storeu_si128((__m128i*)(out + i), pixels);
+        }
+        // Leftover cells
+        MapTemperatureScalar(tables, density + i, temperature + i, count - i, out + i);
+    }
+
+    ZSIM_TARGET_AVX2
+    inline __m256i LutIndexAVX2(__m256 density)
+    {
+        density = _mm256_max_ps(_mm256_min_ps(density, _mm256_set1_ps(1.0f)), _mm256_setzero_ps());
+        return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(density, _mm256_set1_ps(LUT_SCALE)), _mm256_set1_ps(0.5f)));
+    }
+
+    ZSIM_TARGET_AVX2
+    void MapDensityAVX2(const Tables& tables, const float* density, const float* temperature, int count, uint32_t* out)
+    {
+        const int* lut = (const int*)tables.pixels;
+        int i = 0;
+        for (; i + 15 < count; i += 16)
+        {
+            __m256i pixels0 = _mm256_i32gather_epi32(lut, LutIndexAVX2(_mm256_loadu_ps(density + i)), 4);
+            __m256i pixels1 = _mm256_i32gather_epi32(lut, LutIndexAVX2(_mm256_loadu_ps(density + i + 8)), 4);
+            _mm256_storeu_si256((__m256i*)(out + i), pixels0);
+            _mm256_storeu_si256((__m256i*)(out + i + 8), pixels1);
+        }
+        // Leftover cells
+        MapDensityScalar(tables, density + i, temperature, count - i, out + i);
+    }
+
+    ZSIM_TARGET_AVX2
+    void MapTemperatureAVX2(const Tables& tables, const float* density, const float* temperature, int count, uint32_t* out)
+    {
+        const __m256 onev = _mm256_set1_ps(1.0f);
+        const __m256 halfv = _mm256_set1_ps(0.5f);
+        const __m256 scalev = _mm256_set1_ps(tables.temperatureScale);
+        int i = 0;
+        for (; i + 7 < count; i += 8)
+        {
+            __m256 intensity = _mm256_i32gather_ps(tables.intensity, LutIndexAVX2(_mm256_loadu_ps(density + i)), 4);
+            __m256 t = _mm256_mul_ps(_mm256_loadu_ps(temperature + i), scalev);
+            t = _mm256_max_ps(_mm256_min_ps(t, onev), _mm256_setzero_ps());
+
+            __m256i pixels = _mm256_setzero_si256();
+            for (int c = 0; c < 4; c++)
+            {
+                __m256 base = _mm256_set1_ps(tables.base[c]);
+                __m256 delta = _mm256_set1_ps(tables.hot[c] - tables.base[c]);
+                __m256 value = _mm256_mul_ps(_mm256_add_ps(base, _mm256_mul_ps(delta, t)), intensity);
+                __m256i channel = _mm256_cvttps_epi32(_mm256_add_ps(value, halfv));
+                pixels = _mm256_or_si256(pixels, _mm256_sll_epi32(channel, _mm_cvtsi32_si128(c * 8)));
+            }
+            _mm256_storeu_si256((__m256i*)(out + i), pixels);
+        }
+        // Leftover cells
+        MapTemperatureScalar(tables, density + i, temperature + i, count - i, out + i);
+    }
+#endif
+
+    // Premultiplied B, G, R, A
+    void Premultiply(uint32_t argb, float* bgra)
+    {
+        float alpha = ((argb >> 24) & 0xFF) / 255.0f;
+        bgra[0] = (argb & 0xFF) * alpha;
+        bgra[1] = ((argb >> 8) & 0xFF) * alpha;
+        bgra[2] = ((argb >> 16) & 0xFF) * alpha;
+        bgra[3] = 255.0f * alpha;
+    }
+}
+
+zsim::ColorMapper::ColorMapper()
+{
+    SetSimdLevel(SimdLevel::AVX2);
+}
+
+void zsim::ColorMapper::SetSimdLevel(SimdLevel level)
+{
+    _simdLevel = std::min(level, DetectSimdLevel());
+    _densityKernel = MapDensityScalar;
+    _temperatureKernel = MapTemperatureScalar;
+#ifdef ZSIM_X86
+    if (_simdLevel == SimdLevel::AVX2)
+    {
+        _densityKernel = MapDensityAVX2;
+        _temperatureKernel = MapTemperatureAVX2;
+    }
+    else if (_simdLevel == SimdLevel::SSE41)
+    {
+        _densityKernel = MapDensitySSE41;
+        _temperatureKernel = MapTemperatureSSE41;
+    }
+#endif
+}
+
+void zsim::ColorMapper::SetColor(uint32_t argb)
+{
+    if (argb == _color)
+        return;
+    _color = argb;
+    _tablesDirty = true;
+    _revision++;
+}
+
+void zsim::ColorMapper::SetIntensityExponent(float exponent)
+{
+    if (exponent == _exponent)
+        return;
+    _exponent = exponent;
+    _tablesDirty = true;
+    _revision++;
+}
+
+void zsim::ColorMapper::SetTemperatureRamp(bool enabled, uint32_t hotArgb, float fullTemperature)
+{
+    if (enabled == _rampEnabled && hotArgb == _hotColor && fullTemperature == _fullTemperature)
+        return;
+    _rampEnabled = enabled;
+    _hotColor = hotArgb;
+    _fullTemperature = fullTemperature;
+    _tablesDirty = true;
+    _revision++;
+}
+
+void zsim::ColorMapper::Map(const float* density, const float* temperature, int count, uint32_t* out)
+{
+    if (_tablesDirty)
+        _RebuildTables();
+    if (_rampEnabled && temperature)
+        _temperatureKernel(_tables, density, temperature, count, out);
+    else
+        _densityKernel(_tables, density, nullptr, count, out);
+}
+
+void zsim::ColorMapper::_RebuildTables()
+{
+    Premultiply(_color, _tables.base);
+    Premultiply(_hotColor, _tables.hot);
+    _tables.temperatureScale = _fullTemperature > 0.0f ? 1.0f / _fullTemperature : 0.0f;
+    for (int i = 0; i < LUT_SIZE; i++)
+    {
+        float intensity = std::pow(i / LUT_SCALE, _exponent);
+        _tables.intensity[i] = intensity;
+        uint32_t pixel = 0;
+        for (int c = 0; c < 4; c++)
+            pixel |= (uint32_t)(int)(_tables.base[c] * intensity + 0.5f) << (c * 8);
+        _tables.pixels[i] = pixel;
+    }
+    _tablesDirty = false;
+}
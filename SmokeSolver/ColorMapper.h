@@ -0,0 +1,70 @@
+#pragma once
+
+#include "SmokeSolverSettings.h"
+
+#include <cstdint>
+
+namespace zsim
+{
+    // Converts density (and optionally temperature) fields to packed premultiplied BGRA pixels.
+    //
+    // The color, alpha and intensity curve are folded into lookup tables whenever they change,
+    // so the per pixel work is a clamp, an index computation and a table read.
+    // All SIMD levels produce identical pixels
+    class ColorMapper
+    {
+    public:
+        // Number of density steps in the lookup tables. Keeps the error below half a color level
+        static constexpr int LUT_SIZE = 1024;
+
+        ColorMapper();
+
+        // Levels above the one supported by the CPU are clamped. Defaults to the highest supported level
+        void SetSimdLevel(SimdLevel level);
+        SimdLevel GetSimdLevel() const { return _simdLevel; }
+
+        // 0xAARRGGBB, same layout as the color options
+        void SetColor(uint32_t argb);
+        // intensity = clamp(density, 0, 1) ^ exponent
+        void SetIntensityExponent(float exponent);
+        // Blends the color towards 'hotArgb' as the temperature rises to 'fullTemperature'
+        void SetTemperatureRamp(bool enabled, uint32_t hotArgb, float fullTemperature);
+        bool TemperatureRampEnabled() const { return _rampEnabled; }
+        // Changes whenever a setting that affects the output changes
+        int Revision() const { return _revision; }
+
+        // Converts 'count' consecutive cells. 'temperature' is only read when the ramp is enabled
+        void Map(const float* density, const float* temperature, int count, uint32_t* out);
+
+        // Kernel interface, exposed for the implementation file
+        struct Tables
+        {
+            // Final pixel for each density step
+            uint32_t pixels[LUT_SIZE];
+            // Intensity for each density step, used by the temperature ramp
+            float intensity[LUT_SIZE];
+            // Premultiplied B, G, R, A of the base and hot colors, 0 - 255
+            float base[4];
+            float hot[4];
+            float temperatureScale;
+        };
+        using KernelFunc = void(*)(const Tables& tables, const float* density, const float* temperature, int count, uint32_t* out);
+
+    private:
+        SimdLevel _simdLevel = SimdLevel::SCALAR;
+        KernelFunc _densityKernel = nullptr;
+        KernelFunc _temperatureKernel = nullptr;
+
+        uint32_t _color = 0;
+        float _exponent = 2.0f;
+        bool _rampEnabled = false;
+        uint32_t _hotColor = 0;
+        float _fullTemperature = 1.0f;
+
+        int _revision = 0;
+        bool _tablesDirty = true;
+        Tables _tables;
+
+        void _RebuildTables();
+    };
+}
@@ -0,0 +1,272 @@
+#include "Fft.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr double PI = 3.14159265358979323846;
+
+    // std::complex multiplication handles infinities and NaN through a library call, which dominates
+    // the transform time unless the whole build uses -ffast-math
+    inline zsim::Fft::Complex Multiply(zsim::Fft::Complex a, zsim::Fft::Complex b)
+    {
+        return zsim::Fft::Complex(
+            a.real() * b.real() - a.imag() * b.imag(),
+            a.real() * b.imag() + a.imag() * b.real()
+        );
+    }
+}
+
+zsim::Fft::Fft(int length)
+    : _length(std::max(length, 1))
+{
+    _twiddles.resize(_length);
+    for (int k = 0; k < _length; k++)
+        _twiddles[k] = Complex(std::polar(1.0, -2.0 * PI * k / _length));
+
+    // Radix 4 first, it has the cheapest butterfly per element
+    int remaining = _length;
+    int maxFactor = 1;
+    for (int radix : { 4, 2 })
+    {
+        while (remaining % radix == 0)
+        {
+            _factors.push_back(radix);
+            remaining /= radix;
+        }
+    }
+    for (int radix = 3; remaining > 1; radix += 2)
+    {
+        if (radix * radix > remaining)
+            radix = remaining;
+        while (remaining % radix == 0)
+        {
+            _factors.push_back(radix);
+            remaining /= radix;
+            maxFactor = std::max(maxFactor, radix);
+        }
+    }
+
+    if (maxFactor > MAX_DIRECT_RADIX)
+    {
+        // Convolution length without wrap-around of the 2 * length - 1 chirp products
+        int paddedLength = 1;
+        while (paddedLength < 2 * _length - 1)
+            paddedLength *= 2;
+        _convolution = std::make_unique<Fft>(paddedLength);
+
+        _chirp.resize(_length);
+        for (int n = 0; n < _length; n++)
+        {
+            // n^2 mod 2 * length keeps the angle accurate for large n
+            long long square = (long long)n * n % (2LL * _length);
+            _chirp[n] = Complex(std::polar(1.0, -PI * square / _length));
+        }
+        _padded.assign(paddedLength, Complex(0.0f, 0.0f));
+        _paddedSpectrum.resize(paddedLength);
+        _padded[0] = std::conj(_chirp[0]);
+        for (int n = 1; n < _length; n++)
+        {
+            _padded[n] = std::conj(_chirp[n]);
+            _padded[paddedLength - n] = std::conj(_chirp[n]);
+        }
+        _chirpSpectrum.resize(paddedLength);
+        _convolution->Forward(_padded.data(), _chirpSpectrum.data());
+    }
+    else
+    {
+        _scratch.resize(maxFactor);
+    }
+}
+
+void zsim::Fft::Forward(const Complex* in, Complex* out)
+{
+    if (_convolution)
+        _Bluestein(in, out);
+    else if (_factors.empty())
+        out[0] = in[0];
+    else
+        _Transform(in, out, 1, 0);
+}
+
+void zsim::Fft::Inverse(Complex* in, Complex* out)
+{
+    // The inverse transform is the forward one of the conjugate, conjugated
+    for (int n = 0; n < _length; n++)
+        in[n] = std::conj(in[n]);
+    Forward(in, out);
+    for (int n = 0; n < _length; n++)
+        out[n] = std::conj(out[n]);
+}
+
+void zsim::Fft::_Transform(const Complex* in, Complex* out, int stride, int factorIndex)
+{
+    // Decimation in time: 'radix' interleaved sub-sequences of length 'm' are transformed into consecutive
+    // blocks of 'out', then combined by the butterflies
+    int radix = _factors[factorIndex];
+    int m = _length / stride / radix;
+    if (m == 1)
+    {
+        for (int q = 0; q < radix; q++)
+            out[q] = in[q * stride];
+    }
+    else
+    {
+        for (int q = 0; q < radix; q++)
+            _Transform(in + q * stride, out + q * m, stride * radix, factorIndex + 1);
+    }
+    _Butterfly(out, stride, radix, m);
+}
+
+void zsim::Fft::_Butterfly(Complex* out, int stride, int radix, int m)
+{
+    const Complex* twiddles = _twiddles.data();
+    if (radix == 2)
+    {
+        for (int k = 0; k < m; k++)
+        {
+            Complex t = Multiply(out[k + m], twiddles[k * stride]);
+            out[k + m] = out[k] - t;
+            out[k] += t;
+        }
+    }
+    else if (radix == 4)
+    {
+        for (int k = 0; k < m; k++)
+        {
+            Complex s0 = Multiply(out[k + m], twiddles[k * stride]);
+            Complex s1 = Multiply(out[k + 2 * m], twiddles[2 * k * stride]);
+            Complex s2 = Multiply(out[k + 3 * m], twiddles[3 * k * stride]);
+            Complex s3 = s0 + s2;
+            Complex s4 = s0 - s2;
+            Complex s5 = out[k] - s1;
+            Complex s6 = out[k] + s1;
+            // s4 * -i
+            Complex rotated(s4.imag(), -s4.real());
+            out[k] = s6 + s3;
+            out[k + m] = s5 + rotated;
+            out[k + 2 * m] = s6 - s3;
+            out[k + 3 * m] = s5 - rotated;
+        }
+    }
+    else if (radix == 3)
+    {
+        // Imaginary part of e^(-2 pi i / 3)
+        const float sine = -0.86602540378443865f;
+        for (int k = 0; k < m; k++)
+        {
+            Complex s1 = Multiply(out[k + m], twiddles[k * stride]);
+            Complex s2 = Multiply(out[k + 2 * m], twiddles[2 * k * stride]);
+            Complex sum = s1 + s2;
+            Complex difference = (s1 - s2) * sine;
+            Complex center = out[k] - 0.5f * sum;
+            out[k] += sum;
+            out[k + m] = Complex(center.real() - difference.imag(), center.imag() + difference.real());
+            out[k + 2 * m] = Complex(center.real() + difference.imag(), center.imag() - difference.real());
+        }
+    }
+    else
+    {
+        // Direct DFT over the radix, twiddle factors folded into the DFT terms
+        Complex* scratch = _scratch.data();
+        for (int k = 0; k < m; k++)
+        {
+            for (int q = 0; q < radix; q++)
+                scratch[q] = out[k + q * m];
+            for (int q = 0; q < radix; q++)
+            {
+                int outIndex = k + q * m;
+                int step = stride * outIndex % _length;
+                int twiddleIndex = 0;
+                Complex sum = scratch[0];
+                for (int r = 1; r < radix; r++)
+                {
+                    twiddleIndex += step;
+                    if (twiddleIndex >= _length)
+                        twiddleIndex -= _length;
+                    sum += Multiply(scratch[r], twiddles[twiddleIndex]);
+                }
+                out[outIndex] = sum;
+            }
+        }
+    }
+}
+
+void zsim::Fft::_Bluestein(const Complex* in, Complex* out)
+{
+    // The DFT written as a convolution with a chirp, which is evaluated by power of 2 transforms
+    int paddedLength = _convolution->Length();
+    std::fill(_padded.begin(), _padded.end(), Complex(0.0f, 0.0f));
+    for (int n = 0; n < _length; n++)
+        _padded[n] = Multiply(in[n], _chirp[n]);
+    _convolution->Forward(_padded.data(), _paddedSpectrum.data());
+    for (int k = 0; k < paddedLength; k++)
+        _paddedSpectrum[k] = Multiply(_paddedSpectrum[k], _chirpSpectrum[k]);
+    _convolution->Inverse(_paddedSpectrum.data(), _padded.data());
+    float scale = 1.0f / paddedLength;
+    for (int k = 0; k < _length; k++)
+        out[k] = Multiply(_padded[k], _chirp[k]) * scale;
+}
+
+zsim::Dct::Dct(int length)
+    : _fft(length)
+{
+    int n = _fft.Length();
+    _shift.resize(n);
+    for (int k = 0; k < n; k++)
+        _shift[k] = Fft::Complex(std::polar(1.0, -PI * k / (2.0 * n)));
+    _in.resize(n);
+    _out.resize(n);
+}
+
+void zsim::Dct::Forward(float* a, float* b)
+{
+    // Makhoul: even samples in order followed by odd samples reversed turn the DCT into a plain DFT
+    int n = _fft.Length();
+    for (int i = 0; i < (n + 1) / 2; i++)
+        _in[i] = Fft::Complex(a[2 * i], b[2 * i]);
+    for (int i = 0; i < n / 2; i++)
+        _in[n - 1 - i] = Fft::Complex(a[2 * i + 1], b[2 * i + 1]);
+    _fft.Forward(_in.data(), _out.data());
+
+    // Separate the spectra of the real and imaginary parts through their conjugate symmetry
+    for (int k = 0; k < n; k++)
+    {
+        Fft::Complex z = _out[k];
+        Fft::Complex mirrored = std::conj(_out[k == 0 ? 0 : n - k]);
+        Fft::Complex spectrumA = 0.5f * (z + mirrored);
+        Fft::Complex difference = z - mirrored;
+        // (z - mirrored) / 2i
+        Fft::Complex spectrumB(0.5f * difference.imag(), -0.5f * difference.real());
+        a[k] = Multiply(_shift[k], spectrumA).real();
+        b[k] = Multiply(_shift[k], spectrumB).real();
+    }
+}
+
+void zsim::Dct::Inverse(float* a, float* b)
+{
+    int n = _fft.Length();
+    // Rebuild the DFT of the reordered sequence from X[k] and X[n - k], with X[n] = 0
+    for (int k = 0; k < n; k++)
+    {
+        Fft::Complex unshift = std::conj(_shift[k]);
+        Fft::Complex spectrumA = Multiply(unshift, Fft::Complex(a[k], k == 0 ? 0.0f : -a[n - k]));
+        Fft::Complex spectrumB = Multiply(unshift, Fft::Complex(b[k], k == 0 ? 0.0f : -b[n - k]));
+        // spectrumA + i * spectrumB
+        _in[k] = Fft::Complex(spectrumA.real() - spectrumB.imag(), spectrumA.imag() + spectrumB.real());
+    }
+    _fft.Inverse(_in.data(), _out.data());
+
+    float scale = 1.0f / n;
+    for (int i = 0; i < (n + 1) / 2; i++)
+    {
+        a[2 * i] = _out[i].real() * scale;
+        b[2 * i] = _out[i].imag() * scale;
+    }
+    for (int i = 0; i < n / 2; i++)
+    {
+        a[2 * i + 1] = _out[n - 1 - i].real() * scale;
+        b[2 * i + 1] = _out[n - 1 - i].imag() * scale;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <complex>
+#include <memory>
+#include <vector>
+
+namespace zsim
+{
+    // Complex FFT of a fixed length. Mixed radix Cooley-Tukey over the prime factors of the length,
+    // lengths with a prime factor above MAX_DIRECT_RADIX go through Bluestein's algorithm instead,
+    // so any length costs O(n log n)
+    class Fft
+    {
+    public:
+        using Complex = std::complex<float>;
+        static constexpr int MAX_DIRECT_RADIX = 13;
+
+        explicit Fft(int length);
+        Fft(const Fft&) = delete;
+        Fft& operator=(const Fft&) = delete;
+
+        int Length() const { return _length; }
+
+        // out[k] = sum(in[n] * e^(-2 pi i n k / length)). 'in' and 'out' must not overlap
+        void Forward(const Complex* in, Complex* out);
+        // out[n] = sum(in[k] * e^(2 pi i n k / length)), without the 1 / length factor. 'in' is used as scratch
+        void Inverse(Complex* in, Complex* out);
+
+    private:
+        int _length;
+        std::vector<int> _factors;
+        // e^(-2 pi i k / length)
+        std::vector<Complex> _twiddles;
+        std::vector<Complex> _scratch;
+
+        // Bluestein: the chirp e^(-pi i n^2 / length), and the transformed conjugate chirp of the convolution
+        std::unique_ptr<Fft> _convolution;
+        std::vector<Complex> _chirp;
+        std::vector<Complex> _chirpSpectrum;
+        std::vector<Complex> _padded;
+        std::vector<Complex> _paddedSpectrum;
+
+        void _Transform(const Complex* in, Complex* out, int stride, int factorIndex);
+        void _Butterfly(Complex* out, int stride, int radix, int m);
+        void _Bluestein(const Complex* in, Complex* out);
+    };
+
+    // Unnormalized DCT-II and its inverse, computed through an FFT of the same length.
+    // Sequences are transformed in pairs, packed into the real and imaginary parts of one complex FFT
+    class Dct
+    {
+    public:
+        explicit Dct(int length);
+
+        int Length() const { return _fft.Length(); }
+
+        // X[k] = sum(x[n] * cos(pi k (2n + 1) / (2 length))), in place on both 'a' and 'b'
+        void Forward(float* a, float* b);
+        // Exact inverse of Forward(), in place on both 'a' and 'b'
+        void Inverse(float* a, float* b);
+
+    private:
+        Fft _fft;
+        // e^(-pi i k / (2 length))
+        std::vector<Fft::Complex> _shift;
+        std::vector<Fft::Complex> _in;
+        std::vector<Fft::Complex> _out;
+    };
+}
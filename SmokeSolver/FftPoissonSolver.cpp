@@ -0,0 +1,125 @@
+#include "FftPoissonSolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+zsim::FftPoissonSolver::FftPoissonSolver(int width, int height, int pitch)
+    : _width(width),
+    _height(height),
+    _pitch(pitch),
+    _rowDct(width),
+    _columnDct(height)
+{
+    const double pi = 3.14159265358979323846;
+    _rowEigenvalues.resize(width);
+    for (int k = 0; k < width; k++)
+        _rowEigenvalues[k] = float(2.0 - 2.0 * std::cos(pi * k / width));
+    _columnEigenvalues.resize(height);
+    for (int k = 0; k < height; k++)
+        _columnEigenvalues[k] = float(2.0 - 2.0 * std::cos(pi * k / height));
+
+    _rows.resize((size_t)width * height);
+    _columns.resize((size_t)width * height);
+    _spare.resize(std::max(width, height));
+}
+
+zsim::ProjectionStats zsim::FftPoissonSolver::Solve(float* p, const float* div)
+{
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+
+    ProjectionStats stats;
+    stats.iterations = 1;
+
+    double sum = 0.0;
+    for (int j = 1; j <= _height; j++)
+    {
+        const float* divRow = div + j * _pitch + 1;
+        std::copy(divRow, divRow + _width, _rows.data() + (size_t)(j - 1) * _width);
+        for (int i = 0; i < _width; i++)
+            sum += divRow[i];
+    }
+    float mean = float(sum / (double(_width) * _height));
+
+    _Transform(_rowDct, _rows.data(), _height, _width, false);
+    for (int j = 0; j < _height; j++)
+        for (int i = 0; i < _width; i++)
+            _columns[(size_t)i * _height + j] = _rows[(size_t)j * _width + i];
+    _Transform(_columnDct, _columns.data(), _width, _height, false);
+
+    for (int i = 0; i < _width; i++)
+    {
+        float* column = _columns.data() + (size_t)i * _height;
+        for (int j = 0; j < _height; j++)
+        {
+            float eigenvalue = _rowEigenvalues[i] + _columnEigenvalues[j];
+            column[j] = eigenvalue > 0.0f ? column[j] / eigenvalue : 0.0f;
+        }
+    }
+    // The constant mode has no eigenvalue: the pure Neumann problem only has a solution for a zero mean
+    // right hand side, and the pressure is only defined up to a constant. Both are dropped
+    _columns[0] = 0.0f;
+
+    _Transform(_columnDct, _columns.data(), _width, _height, true);
+    for (int i = 0; i < _width; i++)
+        for (int j = 0; j < _height; j++)
+            _rows[(size_t)j * _width + i] = _columns[(size_t)i * _height + j];
+    _Transform(_rowDct, _rows.data(), _height, _width, true);
+
+    for (int j = 1; j <= _height; j++)
+    {
+        const float* row = _rows.data() + (size_t)(j - 1) * _width;
+        std::copy(row, row + _width, p + j * _pitch + 1);
+    }
+    _SetBoundary(p);
+
+    float rhsNorm = 0.0f;
+    for (int j = 1; j <= _height; j++)
+        for (int i = 1; i <= _width; i++)
+            rhsNorm = std::max(rhsNorm, std::fabs(div[j * _pitch + i] - mean));
+    stats.residual = rhsNorm > 0.0f ? _MaxAbsResidual(p, div, mean) / rhsNorm : 0.0f;
+    stats.milliseconds = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    return stats;
+}
+
+void zsim::FftPoissonSolver::_Transform(Dct& dct, float* data, int count, int length, bool inverse)
+{
+    for (int n = 0; n < count; n += 2)
+    {
+        float* a = data + (size_t)n * length;
+        float* b = n + 1 < count ? a + length : _spare.data();
+        if (inverse)
+            dct.Inverse(a, b);
+        else
+            dct.Forward(a, b);
+    }
+}
+
+void zsim::FftPoissonSolver::_SetBoundary(float* p) const
+{
+    for (int j = 1; j <= _height; j++)
+    {
+        p[j * _pitch] = p[j * _pitch + 1];
+        p[j * _pitch + _width + 1] = p[j * _pitch + _width];
+    }
+    std::copy(p + _pitch, p + 2 * _pitch, p);
+    std::copy(p + _height * _pitch, p + (_height + 1) * _pitch, p + (_height + 1) * _pitch);
+}
+
+float zsim::FftPoissonSolver::_MaxAbsResidual(const float* p, const float* div, float mean) const
+{
+    // With the ghost cells copied from their neighbours the full stencil applies at the walls too
+    float result = 0.0f;
+    for (int j = 1; j <= _height; j++)
+    {
+        const float* row = p + j * _pitch;
+        const float* divRow = div + j * _pitch;
+        for (int i = 1; i <= _width; i++)
+        {
+            float laplacian = 4.0f * row[i] - row[i - 1] - row[i + 1] - row[i - _pitch] - row[i + _pitch];
+            result = std::max(result, std::fabs(divRow[i] - mean - laplacian));
+        }
+    }
+    return result;
+}
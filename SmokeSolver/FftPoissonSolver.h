@@ -0,0 +1,46 @@
+#pragma once
+
+#include "SmokeSolverSettings.h"
+#include "Fft.h"
+
+#include <vector>
+
+namespace zsim
+{
+    // Direct solver for the pressure equation used by the projection step:
+    //  4 * p[i, j] - p[i - 1, j] - p[i + 1, j] - p[i, j - 1] - p[i, j + 1] = div[i, j]
+    // with zero gradient (Neumann) boundaries. On a rectangle this operator is diagonalized by the DCT-II
+    // along each axis, so the solve is a 2D DCT, a division by the eigenvalues and the inverse DCT,
+    // O(n log n) with no iteration. Arrays passed to Solve() have rows 'pitch' cells apart (see Grid2D)
+    class FftPoissonSolver
+    {
+    public:
+        FftPoissonSolver(int width, int height, int pitch);
+
+        // Overwrites the interior and boundary of 'p'. 'div' is only read.
+        // The residual of the result is measured, which costs one extra pass
+        ProjectionStats Solve(float* p, const float* div);
+
+    private:
+        int _width;
+        int _height;
+        int _pitch;
+        Dct _rowDct;
+        Dct _columnDct;
+        // Eigenvalues of the 1D Neumann Laplacian along each axis, 2 - 2 * cos(pi * k / n)
+        std::vector<float> _rowEigenvalues;
+        std::vector<float> _columnEigenvalues;
+        // Interior copy, height rows of width cells
+        std::vector<float> _rows;
+        // Transpose of '_rows', width rows of height cells
+        std::vector<float> _columns;
+        // Partner for the last sequence when the count is odd
+        std::vector<float> _spare;
+
+        // Transforms 'count' sequences 'length' floats apart, two at a time
+        void _Transform(Dct& dct, float* data, int count, int length, bool inverse);
+        // Zero gradient ghost cells
+        void _SetBoundary(float* p) const;
+        float _MaxAbsResidual(const float* p, const float* div, float mean) const;
+    };
+}
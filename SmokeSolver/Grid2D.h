@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace zsim
+{
+    // Row-major 2D field of width * height interior cells surrounded by a 1 cell ghost border.
+    // Cell (x, y), with x in [0, width + 1] and y in [0, height + 1], is at Data()[y * Pitch() + x].
+    //
+    // The first interior cell of every row starts a 64 byte cache line and the pitch is a multiple of
+    // 64 bytes, so row spans starting at a multiple of 16 cells never split a vector load across lines.
+    // Padding cells past the ghost border exist but are never read by the solver
+    template <typename T>
+    class Grid2D
+    {
+    public:
+        static constexpr int ALIGNMENT = 64;
+        static constexpr int CELLS_PER_LINE = ALIGNMENT / sizeof(T);
+
+        Grid2D() {}
+        Grid2D(int width, int height) { Resize(width, height); }
+        Grid2D(const Grid2D&) = delete;
+        Grid2D& operator=(const Grid2D&) = delete;
+        // The storage moves along with the origin pointing into it
+        Grid2D(Grid2D&& other) noexcept { *this = std::move(other); }
+        Grid2D& operator=(Grid2D&& other) noexcept
+        {
+            _lines = std::move(other._lines);
+            _origin = std::exchange(other._origin, nullptr);
+            _width = std::exchange(other._width, 0);
+            _height = std::exchange(other._height, 0);
+            _pitch = std::exchange(other._pitch, 0);
+            return *this;
+        }
+
+        // Discards the contents, every cell is 0 afterwards
+        void Resize(int width, int height)
+        {
+            _width = width;
+            _height = height;
+            _pitch = PitchFor(width);
+            // One extra line in front, so that cell (1, 0) lands on a line boundary
+            _lines.assign((size_t)_pitch / CELLS_PER_LINE * (height + 2) + 1, Line());
+            _origin = _lines.front().cells + CELLS_PER_LINE - 1;
+        }
+        // Frees the memory
+        void Clear()
+        {
+            _width = 0;
+            _height = 0;
+            _pitch = 0;
+            _lines = std::vector<Line>();
+            _origin = nullptr;
+        }
+
+        // Row pitch in cells for a grid with 'width' interior cells
+        static int PitchFor(int width)
+        {
+            int pitch = (width + 2 + CELLS_PER_LINE - 1) / CELLS_PER_LINE * CELLS_PER_LINE;
+            // With a multiple of 4 KiB, vertically adjacent cells map to the same L1 sets and evict each other
+            if (pitch * sizeof(T) % 4096 == 0)
+                pitch += CELLS_PER_LINE;
+            return pitch;
+        }
+
+        int Width() const { return _width; }
+        int Height() const { return _height; }
+        int Pitch() const { return _pitch; }
+        // Cells from Data() to the end of the last row, including padding
+        size_t Size() const { return (size_t)_pitch * (_height + 2); }
+        bool Empty() const { return _origin == nullptr; }
+        int IndexAt(int x, int y) const { return y * _pitch + x; }
+
+        T* Data() { return _origin; }
+        const T* Data() const { return _origin; }
+        T* Row(int y) { return _origin + (size_t)y * _pitch; }
+        const T* Row(int y) const { return _origin + (size_t)y * _pitch; }
+        T& operator()(int x, int y) { return _origin[IndexAt(x, y)]; }
+        const T& operator()(int x, int y) const { return _origin[IndexAt(x, y)]; }
+        // 'index' as returned by IndexAt()
+        T& operator[](int index) { return _origin[index]; }
+        const T& operator[](int index) const { return _origin[index]; }
+
+        // Sets every cell, including the ghost border and padding
+        void Fill(T value) { std::fill(_origin, _origin + Size(), value); }
+
+        // Calls func(y, row) for rows [yStart, yEnd), 'row' pointing at cell (0, y)
+        template <typename F>
+        void ForEachRow(int yStart, int yEnd, F&& func)
+        {
+            for (int y = yStart; y < yEnd; y++)
+                func(y, Row(y));
+        }
+        // Calls func(y, cells, count) for each row of the block [xStart, xEnd) x [yStart, yEnd),
+        // 'cells' pointing at cell (xStart, y) and 'count' being xEnd - xStart
+        template <typename F>
+        void ForEachTileRow(int xStart, int yStart, int xEnd, int yEnd, F&& func)
+        {
+            int count = xEnd - xStart;
+            for (int y = yStart; y < yEnd; y++)
+                func(y, Row(y) + xStart, count);
+        }
+
+    private:
+        struct alignas(ALIGNMENT) Line
+        {
+            T cells[CELLS_PER_LINE] = {};
+        };
+        std::vector<Line> _lines;
+        T* _origin = nullptr;
+        int _width = 0;
+        int _height = 0;
+        int _pitch = 0;
+    };
+}
@@ -0,0 +1,271 @@
+#include "InputTrace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    const uint8_t TAG[4] = { 'Z', 'S', 'I', 'T' };
+    constexpr uint8_t VERSION = 1;
+
+    void WriteVarint(std::vector<uint8_t>& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(uint8_t(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(uint8_t(value));
+    }
+
+    uint64_t ZigZag(int64_t value)
+    {
+        return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+    }
+
+    int64_t UnZigZag(uint64_t value)
+    {
+        return int64_t(value >> 1) ^ -int64_t(value & 1);
+    }
+
+    class Reader
+    {
+    public:
+        Reader(const uint8_t* data, size_t size) : _data(data), _size(size) {}
+
+        bool Varint(uint64_t& value)
+        {
+            value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                if (_pos >= _size)
+                    return false;
+                uint8_t byte = _data[_pos++];
+                value |= uint64_t(byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                    return true;
+            }
+            return false;
+        }
+
+        bool Bytes(uint8_t* out, size_t count)
+        {
+            if (_size - _pos < count)
+                return false;
+            std::copy(_data + _pos, _data + _pos + count, out);
+            _pos += count;
+            return true;
+        }
+
+    private:
+        const uint8_t* _data;
+        size_t _size;
+        size_t _pos = 0;
+    };
+}
+
+std::vector<uint8_t> zsim::InputTrace::Encode() const
+{
+    std::vector<uint8_t> out(TAG, TAG + 4);
+    out.push_back(VERSION);
+    WriteVarint(out, (uint64_t)simType);
+    WriteVarint(out, (uint64_t)std::max(width, 0));
+    WriteVarint(out, (uint64_t)std::max(height, 0));
+    WriteVarint(out, events.size());
+
+    int64_t prevTime = 0;
+    int prevX = 0;
+    int prevY = 0;
+    for (const InputEvent& event : events)
+    {
+        uint64_t timeDelta = (uint64_t)std::max<int64_t>(event.timeUs - prevTime, 0);
+        prevTime += (int64_t)timeDelta;
+        WriteVarint(out, timeDelta << 2 | (uint64_t)event.kind);
+        if (event.kind == InputEvent::Kind::CURSOR)
+        {
+            WriteVarint(out, ZigZag((int64_t)event.x - prevX));
+            WriteVarint(out, ZigZag((int64_t)event.y - prevY));
+            prevX = event.x;
+            prevY = event.y;
+        }
+        else if (event.kind == InputEvent::Kind::KEY)
+        {
+            WriteVarint(out, (uint64_t)std::max(event.key, 0) << 1 | (event.down ? 1 : 0));
+        }
+    }
+    return out;
+}
+
+bool zsim::InputTrace::Decode(const uint8_t* data, size_t size)
+{
+    Reader reader(data, size);
+    uint8_t header[5];
+    if (!reader.Bytes(header, 5) || !std::equal(TAG, TAG + 4, header) || header[4] != VERSION)
+        return false;
+
+    uint64_t type, traceWidth, traceHeight, count;
+    if (!reader.Varint(type) || !reader.Varint(traceWidth) || !reader.Varint(traceHeight) || !reader.Varint(count))
+        return false;
+    if (type > (uint64_t)SmokeSimType::ENHANCED_SMOKE)
+        return false;
+
+    std::vector<InputEvent> decoded;
+    // Every event takes at least a byte, which bounds the count of a corrupted file
+    decoded.reserve((size_t)std::min<uint64_t>(count, size));
+    InputEvent event;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t tag;
+        if (!reader.Varint(tag) || (tag & 3) > (uint64_t)InputEvent::Kind::KEY)
+            return false;
+        event.kind = (InputEvent::Kind)(tag & 3);
+        event.timeUs += (int64_t)(tag >> 2);
+        if (event.kind == InputEvent::Kind::CURSOR)
+        {
+            uint64_t dx, dy;
+            if (!reader.Varint(dx) || !reader.Varint(dy))
+                return false;
+            event.x += (int)UnZigZag(dx);
+            event.y += (int)UnZigZag(dy);
+        }
+        else if (event.kind == InputEvent::Kind::KEY)
+        {
+            uint64_t key;
+            if (!reader.Varint(key))
+                return false;
+            event.key = int(key >> 1);
+            event.down = key & 1;
+        }
+        decoded.push_back(event);
+    }
+
+    simType = (SmokeSimType)type;
+    width = (int)traceWidth;
+    height = (int)traceHeight;
+    events = std::move(decoded);
+    return true;
+}
+
+bool zsim::InputTrace::Save(const std::string& path) const
+{
+    std::vector<uint8_t> data = Encode();
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return (bool)file;
+}
+
+bool zsim::InputTrace::Load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return Decode(data.data(), data.size());
+}
+
+double zsim::InputTrace::Duration() const
+{
+    return events.empty() ? 0.0 : events.back().timeUs / 1e6;
+}
+
+zsim::InputRecorder::InputRecorder(InputSource* source, SmokeSimType simType, int width, int height)
+    : _source(source)
+{
+    _trace.simType = simType;
+    _trace.width = width;
+    _trace.height = height;
+}
+
+void zsim::InputRecorder::SetTime(double seconds)
+{
+    _source->SetTime(seconds);
+    _timeUs = std::max(_timeUs, (int64_t)std::llround(seconds * 1e6));
+
+    InputEvent event;
+    event.kind = InputEvent::Kind::FRAME;
+    event.timeUs = _timeUs;
+    _trace.events.push_back(event);
+}
+
+void zsim::InputRecorder::GetCursor(int& x, int& y)
+{
+    _source->GetCursor(x, y);
+    if (_hasCursor && x == _cursorX && y == _cursorY)
+        return;
+    _hasCursor = true;
+    _cursorX = x;
+    _cursorY = y;
+
+    InputEvent event;
+    event.kind = InputEvent::Kind::CURSOR;
+    event.timeUs = _timeUs;
+    event.x = x;
+    event.y = y;
+    _trace.events.push_back(event);
+}
+
+bool zsim::InputRecorder::IsKeyDown(int keyCode)
+{
+    bool down = _source->IsKeyDown(keyCode);
+    auto it = std::find_if(_keys.begin(), _keys.end(), [=](const std::pair<int, bool>& key) { return key.first == keyCode; });
+    if (it != _keys.end() && it->second == down)
+        return down;
+    if (it == _keys.end())
+        _keys.push_back({ keyCode, down });
+    else
+        it->second = down;
+
+    // Keys start released, so only a held key needs an event the first time it is asked about
+    if (it != _keys.end() || down)
+    {
+        InputEvent event;
+        event.kind = InputEvent::Kind::KEY;
+        event.timeUs = _timeUs;
+        event.key = keyCode;
+        event.down = down;
+        _trace.events.push_back(event);
+    }
+    return down;
+}
+
+zsim::InputReplay::InputReplay(const InputTrace& trace)
+    : _trace(trace)
+{
+    // Virtual key codes are below 256, so pressing keys during playback never allocates
+    _keysDown.reserve(256);
+}
+
+void zsim::InputReplay::SetTime(double seconds)
+{
+    int64_t timeUs = (int64_t)std::llround(seconds * 1e6);
+    for (; _next < _trace.events.size() && _trace.events[_next].timeUs <= timeUs; _next++)
+    {
+        const InputEvent& event = _trace.events[_next];
+        if (event.kind == InputEvent::Kind::CURSOR)
+        {
+            _cursorX = event.x;
+            _cursorY = event.y;
+        }
+        else if (event.kind == InputEvent::Kind::KEY)
+        {
+            auto it = std::find(_keysDown.begin(), _keysDown.end(), event.key);
+            if (event.down && it == _keysDown.end())
+                _keysDown.push_back(event.key);
+            else if (!event.down && it != _keysDown.end())
+                _keysDown.erase(it);
+        }
+    }
+}
+
+void zsim::InputReplay::GetCursor(int& x, int& y)
+{
+    x = _cursorX;
+    y = _cursorY;
+}
+
+bool zsim::InputReplay::IsKeyDown(int keyCode)
+{
+    return std::find(_keysDown.begin(), _keysDown.end(), keyCode) != _keysDown.end();
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "SmokeSimType.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace zsim
+{
+    struct InputEvent
+    {
+        enum class Kind
+        {
+            // A simulation step started
+            FRAME,
+            // The cursor moved to (x, y)
+            CURSOR,
+            // 'key' was pressed or released
+            KEY
+        };
+
+        Kind kind = Kind::FRAME;
+        // Microseconds since the start of the recording
+        int64_t timeUs = 0;
+        // Pixels relative to the top left corner of the overlay
+        int x = 0;
+        int y = 0;
+        // Windows virtual key code
+        int key = 0;
+        bool down = false;
+    };
+
+    // Timestamped cursor and key input of an overlay session, with the start of every simulation step.
+    //
+    // The binary format is a "ZSIT" tag and a version byte, followed by varints: the simulation type, the
+    // overlay size and the number of events. Each event starts with (time delta << 2 | kind), time deltas in
+    // microseconds. Cursor events add the zigzag encoded position deltas, key events (key << 1 | down).
+    // A cursor sample at 1000 Hz with small movements takes 3-4 bytes
+    class InputTrace
+    {
+    public:
+        SmokeSimType simType = SmokeSimType::CURSOR_TRAIL;
+        int width = 0;
+        int height = 0;
+        // In time order
+        std::vector<InputEvent> events;
+
+        std::vector<uint8_t> Encode() const;
+        // Returns false if the data is truncated or not a trace
+        bool Decode(const uint8_t* data, size_t size);
+        bool Save(const std::string& path) const;
+        bool Load(const std::string& path);
+
+        // Time of the last event in seconds
+        double Duration() const;
+    };
+
+    // Cursor and key state read by the overlay once per simulation step
+    class InputSource
+    {
+    public:
+        virtual ~InputSource() = default;
+
+        // Seconds since the overlay started, called at the start of every simulation step
+        virtual void SetTime(double seconds) = 0;
+        // Pixels relative to the top left corner of the overlay
+        virtual void GetCursor(int& x, int& y) = 0;
+        // 'keyCode' is a Windows virtual key code
+        virtual bool IsKeyDown(int keyCode) = 0;
+    };
+
+    // Passes another source through, adding every change it reports to a trace
+    class InputRecorder : public InputSource
+    {
+    public:
+        InputRecorder(InputSource* source, SmokeSimType simType, int width, int height);
+
+        void SetTime(double seconds) override;
+        void GetCursor(int& x, int& y) override;
+        bool IsKeyDown(int keyCode) override;
+
+        const InputTrace& Trace() const { return _trace; }
+
+    private:
+        InputSource* _source;
+        InputTrace _trace;
+        int64_t _timeUs = 0;
+        bool _hasCursor = false;
+        int _cursorX = 0;
+        int _cursorY = 0;
+        // Last reported state of each key that was asked about
+        std::vector<std::pair<int, bool>> _keys;
+    };
+
+    // Plays a trace back. Cursor and key state are the ones of the last event at or before the current time.
+    // 'trace' must outlive the replay
+    class InputReplay : public InputSource
+    {
+    public:
+        explicit InputReplay(const InputTrace& trace);
+
+        void SetTime(double seconds) override;
+        void GetCursor(int& x, int& y) override;
+        bool IsKeyDown(int keyCode) override;
+
+        bool Finished() const { return _next >= _trace.events.size(); }
+
+    private:
+        const InputTrace& _trace;
+        size_t _next = 0;
+        int _cursorX = 0;
+        int _cursorY = 0;
+        std::vector<int> _keysDown;
+    };
+}
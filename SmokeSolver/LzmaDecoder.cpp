@@ -0,0 +1,302 @@
+#include "LzmaDecoder.h"
+
+#include <algorithm>
+#include <memory>
+
+bool zsim::LzmaDecoder::Decode(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t maxOutput)
+{
+    out.clear();
+    // The probability tables make the decoder a few KiB, too much for the stack of a worker thread
+    // (the constructor is private, so not std::make_unique)
+    std::unique_ptr<LzmaDecoder> decoder(new LzmaDecoder(data, size));
+    return decoder->_Run(out, maxOutput);
+}
+
+bool zsim::LzmaDecoder::_Run(std::vector<uint8_t>& out, size_t maxOutput)
+{
+    // Properties byte, 4 byte dictionary size, 8 byte uncompressed size
+    if (_size < 13)
+        return false;
+    int properties = _data[0];
+    if (properties >= 9 * 5 * 5)
+        return false;
+    _lc = properties % 9;
+    properties /= 9;
+    _lp = properties % 5;
+    _pb = properties / 5;
+
+    uint64_t unpackSize = 0;
+    bool sizeDefined = false;
+    for (int i = 0; i < 8; i++)
+    {
+        uint8_t byte = _data[5 + i];
+        if (byte != 0xFF)
+            sizeDefined = true;
+        unpackSize |= uint64_t(byte) << (8 * i);
+    }
+    if (sizeDefined)
+    {
+        if (unpackSize > maxOutput)
+            return false;
+        out.reserve((size_t)unpackSize);
+    }
+
+    // The range coder starts with a zero byte and the initial 32 bit code
+    _pos = 13;
+    if (_NextByte() != 0)
+        return false;
+    for (int i = 0; i < 4; i++)
+        _code = (_code << 8) | _NextByte();
+    if (_code == _range)
+        return false;
+
+    _InitProbs();
+
+    uint32_t rep0 = 0;
+    uint32_t rep1 = 0;
+    uint32_t rep2 = 0;
+    uint32_t rep3 = 0;
+    unsigned state = 0;
+    auto remaining = [&]() { return unpackSize - out.size(); };
+    auto byteAt = [&](uint32_t distance) { return out[out.size() - distance]; };
+
+    while (!_corrupted)
+    {
+        if (sizeDefined && remaining() == 0 && _code == 0)
+            return true;
+        if (out.size() >= maxOutput && !(sizeDefined && remaining() == 0))
+            return false;
+
+        unsigned posState = out.size() & ((1u << _pb) - 1);
+        if (_DecodeBit(_isMatch[(state << NUM_POS_BITS_MAX) + posState]) == 0)
+        {
+            if (sizeDefined && remaining() == 0)
+                return false;
+
+            uint8_t prevByte = out.empty() ? 0 : out.back();
+            unsigned literalState = ((out.size() & ((1u << _lp) - 1)) << _lc) + (prevByte >> (8 - _lc));
+            Prob* probs = &_literalProbs[0x300 * literalState];
+            unsigned symbol = 1;
+            if (state >= 7)
+            {
+                // After a match the literal is coded relative to the byte the match would have continued with
+                if (rep0 >= out.size())
+                    return false;
+                unsigned matchByte = byteAt(rep0 + 1);
+                do
+                {
+                    unsigned matchBit = (matchByte >> 7) & 1;
+                    matchByte <<= 1;
+                    unsigned bit = _DecodeBit(probs[((1 + matchBit) << 8) + symbol]);
+                    symbol = (symbol << 1) | bit;
+                    if (matchBit != bit)
+                        break;
+                } while (symbol < 0x100);
+            }
+            while (symbol < 0x100)
+                symbol = (symbol << 1) | _DecodeBit(probs[symbol]);
+            out.push_back(uint8_t(symbol - 0x100));
+
+            state = state < 4 ? 0 : (state < 10 ? state - 3 : state - 6);
+            continue;
+        }
+
+        unsigned length;
+        if (_DecodeBit(_isRep[state]) != 0)
+        {
+            if ((sizeDefined && remaining() == 0) || out.empty())
+                return false;
+            if (_DecodeBit(_isRepG0[state]) == 0)
+            {
+                if (_DecodeBit(_isRep0Long[(state << NUM_POS_BITS_MAX) + posState]) == 0)
+                {
+                    // Short rep: a single byte at the last distance
+                    if (rep0 >= out.size())
+                        return false;
+                    state = state < 7 ? 9 : 11;
+                    out.push_back(byteAt(rep0 + 1));
+                    continue;
+                }
+            }
+            else
+            {
+                uint32_t distance;
+                if (_DecodeBit(_isRepG1[state]) == 0)
+                {
+                    distance = rep1;
+                }
+                else
+                {
+                    if (_DecodeBit(_isRepG2[state]) == 0)
+                    {
+                        distance = rep2;
+                    }
+                    else
+                    {
+                        distance = rep3;
+                        rep3 = rep2;
+                    }
+                    rep2 = rep1;
+                }
+                rep1 = rep0;
+                rep0 = distance;
+            }
+            length = _DecodeLength(_repLengthDecoder, posState);
+            state = state < 7 ? 8 : 11;
+        }
+        else
+        {
+            rep3 = rep2;
+            rep2 = rep1;
+            rep1 = rep0;
+            length = _DecodeLength(_lengthDecoder, posState);
+            state = state < 7 ? 7 : 10;
+            rep0 = _DecodeDistance(length);
+            if (rep0 == 0xFFFFFFFF)
+            {
+                // End marker
+                return !_corrupted && _code == 0 && (!sizeDefined || remaining() == 0);
+            }
+            if (sizeDefined && remaining() == 0)
+                return false;
+        }
+
+        if (rep0 >= out.size())
+            return false;
+        length += MATCH_MIN_LEN;
+        if (sizeDefined && remaining() < length)
+            return false;
+        if (out.size() + length > maxOutput)
+            return false;
+        // Byte by byte, the source may overlap the bytes being written
+        for (unsigned i = 0; i < length; i++)
+            out.push_back(byteAt(rep0 + 1));
+    }
+    return false;
+}
+
+void zsim::LzmaDecoder::_InitProbs()
+{
+    const Prob half = BIT_MODEL_TOTAL / 2;
+    _literalProbs.assign((size_t)0x300 << (_lc + _lp), half);
+    std::fill(std::begin(_isMatch), std::end(_isMatch), half);
+    std::fill(std::begin(_isRep), std::end(_isRep), half);
+    std::fill(std::begin(_isRepG0), std::end(_isRepG0), half);
+    std::fill(std::begin(_isRepG1), std::end(_isRepG1), half);
+    std::fill(std::begin(_isRepG2), std::end(_isRepG2), half);
+    std::fill(std::begin(_isRep0Long), std::end(_isRep0Long), half);
+    std::fill(&_posSlot[0][0], &_posSlot[0][0] + sizeof(_posSlot) / sizeof(Prob), half);
+    std::fill(std::begin(_posDecoders), std::end(_posDecoders), half);
+    std::fill(std::begin(_align), std::end(_align), half);
+    for (LengthDecoder* decoder : { &_lengthDecoder, &_repLengthDecoder })
+    {
+        decoder->choice = half;
+        decoder->choice2 = half;
+        std::fill(&decoder->low[0][0], &decoder->low[0][0] + sizeof(decoder->low) / sizeof(Prob), half);
+        std::fill(&decoder->mid[0][0], &decoder->mid[0][0] + sizeof(decoder->mid) / sizeof(Prob), half);
+        std::fill(std::begin(decoder->high), std::end(decoder->high), half);
+    }
+}
+
+uint8_t zsim::LzmaDecoder::_NextByte()
+{
+    if (_pos >= _size)
+    {
+        _corrupted = true;
+        return 0;
+    }
+    return _data[_pos++];
+}
+
+void zsim::LzmaDecoder::_Normalize()
+{
+    if (_range < (1u << 24))
+    {
+        _range <<= 8;
+        _code = (_code << 8) | _NextByte();
+    }
+}
+
+unsigned zsim::LzmaDecoder::_DecodeBit(Prob& prob)
+{
+    uint32_t bound = (_range >> NUM_BIT_MODEL_TOTAL_BITS) * prob;
+    unsigned bit;
+    if (_code < bound)
+    {
+        prob += (BIT_MODEL_TOTAL - prob) >> NUM_MOVE_BITS;
+        _range = bound;
+        bit = 0;
+    }
+    else
+    {
+        prob -= prob >> NUM_MOVE_BITS;
+        _code -= bound;
+        _range -= bound;
+        bit = 1;
+    }
+    _Normalize();
+    return bit;
+}
+
+uint32_t zsim::LzmaDecoder::_DecodeDirectBits(int count)
+{
+    uint32_t result = 0;
+    for (; count > 0; count--)
+    {
+        _range >>= 1;
+        _code -= _range;
+        // All ones if the code went below zero, in which case the bit is 0 and the subtraction is undone
+        uint32_t mask = 0 - (_code >> 31);
+        _code += _range & mask;
+        if (_code == _range)
+            _corrupted = true;
+        _Normalize();
+        result = (result << 1) + (mask + 1);
+    }
+    return result;
+}
+
+unsigned zsim::LzmaDecoder::_DecodeTree(Prob* probs, int bits)
+{
+    unsigned m = 1;
+    for (int i = 0; i < bits; i++)
+        m = (m << 1) + _DecodeBit(probs[m]);
+    return m - (1u << bits);
+}
+
+unsigned zsim::LzmaDecoder::_DecodeReverseTree(Prob* probs, int bits)
+{
+    unsigned m = 1;
+    unsigned symbol = 0;
+    for (int i = 0; i < bits; i++)
+    {
+        unsigned bit = _DecodeBit(probs[m]);
+        m = (m << 1) + bit;
+        symbol |= bit << i;
+    }
+    return symbol;
+}
+
+unsigned zsim::LzmaDecoder::_DecodeLength(LengthDecoder& decoder, unsigned posState)
+{
+    if (_DecodeBit(decoder.choice) == 0)
+        return _DecodeTree(decoder.low[posState], 3);
+    if (_DecodeBit(decoder.choice2) == 0)
+        return 8 + _DecodeTree(decoder.mid[posState], 3);
+    return 16 + _DecodeTree(decoder.high, 8);
+}
+
+uint32_t zsim::LzmaDecoder::_DecodeDistance(unsigned length)
+{
+    unsigned lengthState = std::min(length, 3u);
+    unsigned posSlot = _DecodeTree(_posSlot[lengthState], 6);
+    if (posSlot < 4)
+        return posSlot;
+
+    int directBits = (posSlot >> 1) - 1;
+    uint32_t distance = (2 | (posSlot & 1)) << directBits;
+    if (posSlot < END_POS_MODEL_INDEX)
+        return distance + _DecodeReverseTree(_posDecoders + distance - posSlot, directBits);
+    distance += _DecodeDirectBits(directBits - NUM_ALIGN_BITS) << NUM_ALIGN_BITS;
+    return distance + _DecodeReverseTree(_align, NUM_ALIGN_BITS);
+}
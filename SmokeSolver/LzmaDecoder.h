@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace zsim
+{
+    // Decoder for LZMA streams in the "alone" (.lzma) format: a properties byte, the dictionary size and the
+    // uncompressed size (all ones when unknown), then the range coded data. This is the format osu! uses for
+    // replay frames. The output doubles as the dictionary, so memory use is the size of the output
+    class LzmaDecoder
+    {
+    public:
+        // Decodes 'data' into 'out'. Fails on corrupted or truncated input and if the output would grow past
+        // 'maxOutput' bytes
+        static bool Decode(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t maxOutput = 64 << 20);
+
+    private:
+        static constexpr int NUM_BIT_MODEL_TOTAL_BITS = 11;
+        static constexpr uint32_t BIT_MODEL_TOTAL = 1 << NUM_BIT_MODEL_TOTAL_BITS;
+        static constexpr int NUM_MOVE_BITS = 5;
+        static constexpr int NUM_STATES = 12;
+        static constexpr int NUM_POS_BITS_MAX = 4;
+        static constexpr int END_POS_MODEL_INDEX = 14;
+        static constexpr int NUM_FULL_DISTANCES = 1 << (END_POS_MODEL_INDEX >> 1);
+        static constexpr int NUM_ALIGN_BITS = 4;
+        static constexpr int MATCH_MIN_LEN = 2;
+
+        using Prob = uint16_t;
+
+        struct LengthDecoder
+        {
+            Prob choice;
+            Prob choice2;
+            Prob low[1 << NUM_POS_BITS_MAX][1 << 3];
+            Prob mid[1 << NUM_POS_BITS_MAX][1 << 3];
+            Prob high[1 << 8];
+        };
+
+        const uint8_t* _data;
+        size_t _size;
+        size_t _pos = 0;
+        uint32_t _range = 0xFFFFFFFF;
+        uint32_t _code = 0;
+        bool _corrupted = false;
+
+        int _lc = 0;
+        int _lp = 0;
+        int _pb = 0;
+        std::vector<Prob> _literalProbs;
+        Prob _isMatch[NUM_STATES << NUM_POS_BITS_MAX];
+        Prob _isRep[NUM_STATES];
+        Prob _isRepG0[NUM_STATES];
+        Prob _isRepG1[NUM_STATES];
+        Prob _isRepG2[NUM_STATES];
+        Prob _isRep0Long[NUM_STATES << NUM_POS_BITS_MAX];
+        Prob _posSlot[4][1 << 6];
+        Prob _posDecoders[1 + NUM_FULL_DISTANCES - END_POS_MODEL_INDEX];
+        Prob _align[1 << NUM_ALIGN_BITS];
+        LengthDecoder _lengthDecoder;
+        LengthDecoder _repLengthDecoder;
+
+        LzmaDecoder(const uint8_t* data, size_t size) : _data(data), _size(size) {}
+
+        bool _Run(std::vector<uint8_t>& out, size_t maxOutput);
+        void _InitProbs();
+
+        uint8_t _NextByte();
+        void _Normalize();
+        unsigned _DecodeBit(Prob& prob);
+        uint32_t _DecodeDirectBits(int count);
+        unsigned _DecodeTree(Prob* probs, int bits);
+        unsigned _DecodeReverseTree(Prob* probs, int bits);
+        unsigned _DecodeLength(LengthDecoder& decoder, unsigned posState);
+        uint32_t _DecodeDistance(unsigned length);
+    };
+}
@@ -0,0 +1,267 @@
+#include "MultigridPoissonSolver.h"
+#include "Grid2D.h"
+
+#include <algorithm>
+#include <cmath>
+
+zsim::MultigridPoissonSolver::MultigridPoissonSolver(int width, int height, int pitch, int maxLevels)
+    : _maxLevels(std::max(maxLevels, 1))
+{
+    int levelWidth = width;
+    int levelHeight = height;
+    float spacingSqr = 1.0f;
+    while (true)
+    {
+        Level level;
+        level.width = levelWidth;
+        level.height = levelHeight;
+        // The finest level shares the layout of the caller's arrays
+        level.pitch = _levels.empty() ? pitch : Grid2D<float>::PitchFor(levelWidth);
+        level.spacingSqr = spacingSqr;
+        int size = level.pitch * (levelHeight + 2);
+        // The finest level pressure is provided by the caller
+        if (!_levels.empty())
+            level.p.resize(size, 0.0f);
+        level.f.resize(size, 0.0f);
+        level.r.resize(size, 0.0f);
+        _levels.push_back(std::move(level));
+
+        // Stop coarsening once the grid can be solved cheaply by relaxation alone
+        if ((int)_levels.size() >= _maxLevels || levelWidth <= 4 || levelHeight <= 4)
+            break;
+
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+        spacingSqr *= 4.0f;
+    }
+}
+
+zsim::ProjectionStats zsim::MultigridPoissonSolver::Solve(float* p, const float* div, const ProjectionSettings& settings)
+{
+    ProjectionStats stats;
+    Level& fine = _levels[0];
+    _fineP = p;
+
+    // The pure Neumann problem only has a solution if the right hand side sums to 0,
+    // so the mean is removed. This doesn't change the pressure gradient
+    double sum = 0.0;
+    for (int y = 1; y <= fine.height; y++)
+        for (int x = 1; x <= fine.width; x++)
+            sum += div[fine.IndexAt(x, y)];
+    float mean = float(sum / (double(fine.width) * fine.height));
+
+    float rhsNorm = 0.0f;
+    for (int y = 1; y <= fine.height; y++)
+    {
+        for (int x = 1; x <= fine.width; x++)
+        {
+            int index = fine.IndexAt(x, y);
+            fine.f[index] = div[index] - mean;
+            rhsNorm = std::max(rhsNorm, std::fabs(fine.f[index]));
+        }
+    }
+
+    std::fill(p, p + fine.pitch * (fine.height + 2), 0.0f);
+    if (rhsNorm == 0.0f)
+        return stats;
+
+    for (int cycle = 0; cycle < settings.maxCycles; cycle++)
+    {
+        _VCycle(0, settings);
+        stats.iterations++;
+
+        _ComputeResidual(0);
+        stats.residual = _MaxAbsResidual(0) / rhsNorm;
+        if (stats.residual <= settings.tolerance)
+            break;
+    }
+
+    _fineP = nullptr;
+    return stats;
+}
+
+void zsim::MultigridPoissonSolver::_VCycle(int level, const ProjectionSettings& settings)
+{
+    if (level == (int)_levels.size() - 1)
+    {
+        _Smooth(level, settings.coarseIterations, settings.multigridSmoother);
+        return;
+    }
+
+    _Smooth(level, settings.preSmoothIterations, settings.multigridSmoother);
+    _ComputeResidual(level);
+    _Restrict(level);
+
+    Level& coarse = _levels[level + 1];
+    std::fill(coarse.p.begin(), coarse.p.end(), 0.0f);
+    _VCycle(level + 1, settings);
+
+    _ProlongAndCorrect(level + 1);
+    _Smooth(level, settings.postSmoothIterations, settings.multigridSmoother);
+}
+
+void zsim::MultigridPoissonSolver::_Smooth(int level, int iterations, MultigridSmoother smoother)
+{
+    Level& lvl = _levels[level];
+    float* p = _P(level);
+    const float* f = lvl.f.data();
+    const int W = lvl.width;
+    const int H = lvl.height;
+    const int stride = lvl.pitch;
+    const float s = lvl.spacingSqr;
+
+    for (int k = 0; k < iterations; k++)
+    {
+        if (smoother == MultigridSmoother::GAUSS_SEIDEL)
+        {
+            for (int y = 1; y <= H; y++)
+            {
+                for (int x = 1; x <= W; x++)
+                {
+                    int index = lvl.IndexAt(x, y);
+                    p[index] = (f[index] * s + p[index - 1] + p[index + 1] + p[index - stride] + p[index + stride]) / 4;
+                }
+            }
+        }
+        else if (smoother == MultigridSmoother::RED_BLACK)
+        {
+            for (int color = 0; color < 2; color++)
+            {
+                for (int y = 1; y <= H; y++)
+                {
+                    // First cell in the row with (x + y) % 2 == color
+                    for (int x = 1 + ((y + 1 + color) & 1); x <= W; x += 2)
+                    {
+                        int index = lvl.IndexAt(x, y);
+                        p[index] = (f[index] * s + p[index - 1] + p[index + 1] + p[index - stride] + p[index + stride]) / 4;
+                    }
+                }
+                // Red cells read the boundary too, so it must be kept up to date between colors
+                _SetBoundary(lvl, p);
+            }
+        }
+        else // JACOBI
+        {
+            // Weighted Jacobi, 2/3 gives the best high frequency damping for the 5 point stencil
+            const float omega = 2.0f / 3.0f;
+            lvl.scratch.resize(lvl.r.size());
+            float* out = lvl.scratch.data();
+            for (int y = 1; y <= H; y++)
+            {
+                for (int x = 1; x <= W; x++)
+                {
+                    int index = lvl.IndexAt(x, y);
+                    float relaxed = (f[index] * s + p[index - 1] + p[index + 1] + p[index - stride] + p[index + stride]) / 4;
+                    out[index] = p[index] + omega * (relaxed - p[index]);
+                }
+            }
+            for (int y = 1; y <= H; y++)
+                std::copy(out + lvl.IndexAt(1, y), out + lvl.IndexAt(W + 1, y), p + lvl.IndexAt(1, y));
+        }
+        _SetBoundary(lvl, p);
+    }
+}
+
+void zsim::MultigridPoissonSolver::_ComputeResidual(int level)
+{
+    Level& lvl = _levels[level];
+    const float* p = _P(level);
+    const int stride = lvl.pitch;
+    const float invS = 1.0f / lvl.spacingSqr;
+
+    for (int y = 1; y <= lvl.height; y++)
+    {
+        for (int x = 1; x <= lvl.width; x++)
+        {
+            int index = lvl.IndexAt(x, y);
+            float laplacian = 4 * p[index] - p[index - 1] - p[index + 1] - p[index - stride] - p[index + stride];
+            lvl.r[index] = lvl.f[index] - laplacian * invS;
+        }
+    }
+}
+
+void zsim::MultigridPoissonSolver::_Restrict(int fineLevel)
+{
+    const Level& fine = _levels[fineLevel];
+    Level& coarse = _levels[fineLevel + 1];
+
+    for (int y = 1; y <= coarse.height; y++)
+    {
+        int fy0 = 2 * y - 1;
+        int fy1 = std::min(2 * y, fine.height);
+        for (int x = 1; x <= coarse.width; x++)
+        {
+            int fx0 = 2 * x - 1;
+            int fx1 = std::min(2 * x, fine.width);
+
+            // Average of the 4 fine cells covered by this coarse cell. On odd sized levels the last coarse
+            // cell overhangs the fine grid, the missing cells count as having no residual
+            float sum = fine.r[fine.IndexAt(fx0, fy0)];
+            if (fx1 != fx0)
+                sum += fine.r[fine.IndexAt(fx1, fy0)];
+            if (fy1 != fy0)
+            {
+                sum += fine.r[fine.IndexAt(fx0, fy1)];
+                if (fx1 != fx0)
+                    sum += fine.r[fine.IndexAt(fx1, fy1)];
+            }
+            coarse.f[coarse.IndexAt(x, y)] = sum * 0.25f;
+        }
+    }
+}
+
+void zsim::MultigridPoissonSolver::_ProlongAndCorrect(int coarseLevel)
+{
+    const Level& coarse = _levels[coarseLevel];
+    Level& fine = _levels[coarseLevel - 1];
+    const float* e = _P(coarseLevel);
+    float* p = _P(coarseLevel - 1);
+
+    // Fine cell i lies at coarse coordinate i / 2 + 0.25, which gives the usual 3/4 - 1/4 weights.
+    // Indices can reach the coarse boundary cells, which mirror the edge values
+    for (int y = 1; y <= fine.height; y++)
+    {
+        int cy0 = y / 2;
+        float ty = (y & 1) ? 0.75f : 0.25f;
+        for (int x = 1; x <= fine.width; x++)
+        {
+            int cx0 = x / 2;
+            float tx = (x & 1) ? 0.75f : 0.25f;
+
+            float top = e[coarse.IndexAt(cx0, cy0)] * (1 - tx) + e[coarse.IndexAt(cx0 + 1, cy0)] * tx;
+            float bottom = e[coarse.IndexAt(cx0, cy0 + 1)] * (1 - tx) + e[coarse.IndexAt(cx0 + 1, cy0 + 1)] * tx;
+            p[fine.IndexAt(x, y)] += top * (1 - ty) + bottom * ty;
+        }
+    }
+    _SetBoundary(fine, p);
+}
+
+float zsim::MultigridPoissonSolver::_MaxAbsResidual(int level)
+{
+    const Level& lvl = _levels[level];
+    float maxResidual = 0.0f;
+    for (int y = 1; y <= lvl.height; y++)
+        for (int x = 1; x <= lvl.width; x++)
+            maxResidual = std::max(maxResidual, std::fabs(lvl.r[lvl.IndexAt(x, y)]));
+    return maxResidual;
+}
+
+void zsim::MultigridPoissonSolver::_SetBoundary(const Level& level, float* x)
+{
+    const int W = level.width;
+    const int H = level.height;
+    for (int i = 1; i <= H; i++)
+    {
+        x[level.IndexAt(0, i)] = x[level.IndexAt(1, i)];
+        x[level.IndexAt(W + 1, i)] = x[level.IndexAt(W, i)];
+    }
+    for (int i = 1; i <= W; i++)
+    {
+        x[level.IndexAt(i, 0)] = x[level.IndexAt(i, 1)];
+        x[level.IndexAt(i, H + 1)] = x[level.IndexAt(i, H)];
+    }
+    x[level.IndexAt(0, 0)] = 0.5f * (x[level.IndexAt(1, 0)] + x[level.IndexAt(0, 1)]);
+    x[level.IndexAt(0, H + 1)] = 0.5f * (x[level.IndexAt(1, H + 1)] + x[level.IndexAt(0, H)]);
+    x[level.IndexAt(W + 1, 0)] = 0.5f * (x[level.IndexAt(W, 0)] + x[level.IndexAt(W + 1, 1)]);
+    x[level.IndexAt(W + 1, H + 1)] = 0.5f * (x[level.IndexAt(W, H + 1)] + x[level.IndexAt(W + 1, H)]);
+}
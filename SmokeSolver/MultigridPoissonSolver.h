@@ -0,0 +1,57 @@
+#pragma once
+
+#include "SmokeSolverSettings.h"
+
+#include <vector>
+
+namespace zsim
+{
+    // Geometric multigrid solver for the pressure equation used by the projection step:
+    //  4 * p[i, j] - p[i - 1, j] - p[i + 1, j] - p[i, j - 1] - p[i, j + 1] = div[i, j]
+    // with zero gradient (Neumann) boundaries, on a (width + 2) * (height + 2) grid with rows 'pitch' cells apart.
+    //
+    // Cell-centered hierarchy, 4 cell averaging restriction and bilinear prolongation.
+    // Odd sized levels get a coarse grid that overhangs by half a cell instead of requiring power of 2 grids.
+    class MultigridPoissonSolver
+    {
+    public:
+        // 'pitch' is the row pitch of the arrays passed to Solve() (see Grid2D)
+        MultigridPoissonSolver(int width, int height, int pitch, int maxLevels);
+
+        // Overwrites the interior and boundary of 'p'. 'div' is only read
+        ProjectionStats Solve(float* p, const float* div, const ProjectionSettings& settings);
+
+        int LevelCount() const { return (int)_levels.size(); }
+        int MaxLevels() const { return _maxLevels; }
+
+    private:
+        struct Level
+        {
+            int width;
+            int height;
+            int pitch;
+            // Squared cell size relative to the finest level
+            float spacingSqr;
+            std::vector<float> p;
+            std::vector<float> f;
+            std::vector<float> r;
+            std::vector<float> scratch;
+
+            int IndexAt(int x, int y) const { return y * pitch + x; }
+        };
+        std::vector<Level> _levels;
+        int _maxLevels;
+
+        // Points to the caller provided pressure array while solving
+        float* _fineP = nullptr;
+        float* _P(int level) { return level == 0 ? _fineP : _levels[level].p.data(); }
+
+        void _VCycle(int level, const ProjectionSettings& settings);
+        void _Smooth(int level, int iterations, MultigridSmoother smoother);
+        void _ComputeResidual(int level);
+        void _Restrict(int fineLevel);
+        void _ProlongAndCorrect(int coarseLevel);
+        float _MaxAbsResidual(int level);
+        static void _SetBoundary(const Level& level, float* x);
+    };
+}
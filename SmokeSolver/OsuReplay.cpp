@@ -0,0 +1,250 @@
+#include "OsuReplay.h"
+#include "LzmaDecoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    // Replays store a random seed in a frame with this time delta
+    constexpr int64_t SEED_FRAME_DELTA = -12345;
+
+    class Reader
+    {
+    public:
+        Reader(const uint8_t* data, size_t size) : _data(data), _size(size) {}
+
+        template<class T>
+        bool Value(T& value)
+        {
+            // Little endian
+            if (_size - _pos < sizeof(T))
+                return false;
+            uint64_t bits = 0;
+            for (size_t i = 0; i < sizeof(T); i++)
+                bits |= uint64_t(_data[_pos + i]) << (8 * i);
+            _pos += sizeof(T);
+            value = (T)bits;
+            return true;
+        }
+
+        // 0x00 for an empty string, or 0x0b, the ULEB128 length and UTF-8 bytes
+        bool String(std::string& value)
+        {
+            uint8_t tag;
+            if (!Value(tag))
+                return false;
+            value.clear();
+            if (tag == 0x00)
+                return true;
+            if (tag != 0x0b)
+                return false;
+
+            uint64_t length = 0;
+            for (int shift = 0;; shift += 7)
+            {
+                uint8_t byte;
+                if (shift >= 64 || !Value(byte))
+                    return false;
+                length |= uint64_t(byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                    break;
+            }
+            if (_size - _pos < length)
+                return false;
+            value.assign(reinterpret_cast<const char*>(_data + _pos), (size_t)length);
+            _pos += (size_t)length;
+            return true;
+        }
+
+        bool Skip(size_t count)
+        {
+            if (_size - _pos < count)
+                return false;
+            _pos += count;
+            return true;
+        }
+
+        const uint8_t* Current() const { return _data + _pos; }
+
+    private:
+        const uint8_t* _data;
+        size_t _size;
+        size_t _pos = 0;
+    };
+
+    bool EndsWith(const std::string& text, const std::string& suffix)
+    {
+        if (text.size() < suffix.size())
+            return false;
+        return std::equal(suffix.rbegin(), suffix.rend(), text.rbegin(), [](char a, char b) {
+            return std::tolower((unsigned char)a) == std::tolower((unsigned char)b);
+        });
+    }
+}
+
+bool zsim::OsuReplay::Decode(const uint8_t* data, size_t size)
+{
+    Reader reader(data, size);
+    uint8_t mode;
+    int32_t gameVersion;
+    std::string beatmap;
+    std::string player;
+    std::string replayHash;
+    if (!reader.Value(mode) || !reader.Value(gameVersion))
+        return false;
+    // Other modes don't record a cursor
+    if (mode != 0)
+        return false;
+    if (!reader.String(beatmap) || !reader.String(player) || !reader.String(replayHash))
+        return false;
+
+    // Hit counts, score, max combo, perfect flag
+    int32_t playMods;
+    std::string lifeBar;
+    int32_t compressedSize;
+    if (!reader.Skip(6 * 2 + 4 + 2 + 1) || !reader.Value(playMods) || !reader.String(lifeBar))
+        return false;
+    // Timestamp
+    if (!reader.Skip(8) || !reader.Value(compressedSize) || compressedSize < 0)
+        return false;
+    const uint8_t* compressed = reader.Current();
+    if (!reader.Skip((size_t)compressedSize))
+        return false;
+
+    std::vector<uint8_t> text;
+    if (!LzmaDecoder::Decode(compressed, (size_t)compressedSize, text))
+        return false;
+
+    // Parses the frames in place, the text is not null terminated
+    std::vector<OsuReplayFrame> parsed;
+    parsed.reserve(text.size() / 16);
+    int64_t time = 0;
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        size_t end = std::find(text.begin() + pos, text.end(), ',') - text.begin();
+        // Fields are short, longer ones are corrupted anyway
+        char fields[4][32];
+        int fieldCount = 0;
+        size_t fieldStart = pos;
+        for (size_t i = pos; i <= end && fieldCount < 4; i++)
+        {
+            if (i == end || text[i] == '|')
+            {
+                size_t length = std::min<size_t>(i - fieldStart, sizeof(fields[0]) - 1);
+                std::copy(text.begin() + fieldStart, text.begin() + fieldStart + length, fields[fieldCount]);
+                fields[fieldCount][length] = '\0';
+                fieldCount++;
+                fieldStart = i + 1;
+            }
+        }
+        pos = end + 1;
+        // The stream ends with a trailing comma
+        if (fieldCount == 1 && fields[0][0] == '\0')
+            continue;
+        if (fieldCount != 4)
+            return false;
+
+        int64_t delta = std::strtoll(fields[0], nullptr, 10);
+        if (delta == SEED_FRAME_DELTA)
+            continue;
+        time += delta;
+
+        OsuReplayFrame frame;
+        frame.timeMs = time;
+        frame.x = std::strtof(fields[1], nullptr);
+        frame.y = std::strtof(fields[2], nullptr);
+        frame.keys = (int)std::strtol(fields[3], nullptr, 10);
+        parsed.push_back(frame);
+    }
+
+    version = gameVersion;
+    beatmapHash = std::move(beatmap);
+    playerName = std::move(player);
+    mods = playMods;
+    frames = std::move(parsed);
+    return true;
+}
+
+bool zsim::OsuReplay::Load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return Decode(data.data(), data.size());
+}
+
+zsim::InputTrace zsim::OsuReplay::ToInputTrace(SmokeSimType simType, int width, int height, int keyMask, int smokeKey) const
+{
+    InputTrace trace;
+    trace.simType = simType;
+    trace.width = width;
+    trace.height = height;
+    if (frames.empty())
+        return trace;
+
+    // Some replays start with frames a few milliseconds apart going back in time
+    int64_t startTime = frames.front().timeMs;
+    int64_t timeUs = 0;
+    bool hasCursor = false;
+    int cursorX = 0;
+    int cursorY = 0;
+    bool keyDown = false;
+    for (const OsuReplayFrame& frame : frames)
+    {
+        InputEvent event;
+        timeUs = std::max(timeUs, (frame.timeMs - startTime) * 1000);
+        event.timeUs = timeUs;
+
+        float windowX, windowY;
+        OsuPlayfieldToWindow(frame.x, frame.y, width, height, windowX, windowY);
+        int x = (int)std::lround(windowX);
+        int y = (int)std::lround(windowY);
+        if (!hasCursor || x != cursorX || y != cursorY)
+        {
+            hasCursor = true;
+            cursorX = x;
+            cursorY = y;
+            event.kind = InputEvent::Kind::CURSOR;
+            event.x = x;
+            event.y = y;
+            trace.events.push_back(event);
+        }
+
+        bool down = (frame.keys & keyMask) != 0;
+        if (down != keyDown)
+        {
+            keyDown = down;
+            event.kind = InputEvent::Kind::KEY;
+            event.key = smokeKey;
+            event.down = down;
+            trace.events.push_back(event);
+        }
+    }
+    return trace;
+}
+
+void zsim::OsuPlayfieldToWindow(float x, float y, int width, int height, float& windowX, float& windowY)
+{
+    float scale = height * 0.8f / 384.0f;
+    windowX = (width - 512.0f * scale) * 0.5f + x * scale;
+    windowY = (height - 384.0f * scale) * 0.5f + y * scale;
+}
+
+bool zsim::LoadInputTrace(const std::string& path, SmokeSimType simType, int width, int height, int keyMask, int smokeKey, InputTrace& trace)
+{
+    if (!EndsWith(path, ".osr"))
+        return trace.Load(path);
+
+    OsuReplay replay;
+    if (!replay.Load(path))
+        return false;
+    trace = replay.ToInputTrace(simType, width, height, keyMask, smokeKey);
+    return true;
+}
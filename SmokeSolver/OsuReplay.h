@@ -0,0 +1,64 @@
+#pragma once
+
+#include "InputTrace.h"
+#include "SmokeSimType.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace zsim
+{
+    struct OsuReplayFrame
+    {
+        // Milliseconds of song time
+        int64_t timeMs = 0;
+        // osu!pixels, the playfield is 512x384
+        float x = 0.0f;
+        float y = 0.0f;
+        // Combination of OsuReplay::Keys
+        int keys = 0;
+    };
+
+    // osu! replay (.osr) of an osu!standard play.
+    //
+    // The header is read up to the frame stream, which is LZMA compressed text of "time delta|x|y|keys"
+    // frames separated by commas. Positions are where the cursor was on screen, so Hard Rock plays need no flip
+    class OsuReplay
+    {
+    public:
+        enum Keys
+        {
+            MOUSE1 = 1,
+            MOUSE2 = 2,
+            // Keyboard presses also set the matching mouse bit
+            KEY1 = 4,
+            KEY2 = 8,
+            SMOKE = 16
+        };
+
+        int version = 0;
+        std::string beatmapHash;
+        std::string playerName;
+        int mods = 0;
+        // In time order
+        std::vector<OsuReplayFrame> frames;
+
+        // Returns false if the data is truncated, corrupted or not an osu!standard replay
+        bool Decode(const uint8_t* data, size_t size);
+        bool Load(const std::string& path);
+
+        // Converts the frames to overlay input for a 'width' x 'height' overlay covering the osu! window.
+        // Frames with any of 'keyMask' held hold down 'smokeKey', a Windows virtual key code. The trace
+        // starts at the first frame
+        InputTrace ToInputTrace(SmokeSimType simType, int width, int height, int keyMask, int smokeKey) const;
+    };
+
+    // Maps osu!pixels to pixels of a 'width' x 'height' window. The playfield is scaled to 80% of the
+    // window height and centered, which matches the osu! client layout to within a few pixels
+    void OsuPlayfieldToWindow(float x, float y, int width, int height, float& windowX, float& windowY);
+
+    // Loads an input trace file, or converts an .osr replay with ToInputTrace. The other arguments are only
+    // used for replays
+    bool LoadInputTrace(const std::string& path, SmokeSimType simType, int width, int height, int keyMask, int smokeKey, InputTrace& trace);
+}
@@ -0,0 +1,238 @@
+#include "PcgPoissonSolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+zsim::PcgPoissonSolver::PcgPoissonSolver(int width, int height)
+    : _width(width),
+    _height(height)
+{
+    for (Grid2D<float>* field : { &_r, &_z, &_s, &_q, &_diagonal, &_precon })
+        field->Resize(width, height);
+
+    for (int j = 1; j <= _height; j++)
+        for (int i = 1; i <= _width; i++)
+            _diagonal(i, j) = float((i > 1) + (i < _width) + (j > 1) + (j < _height));
+
+    _BuildPreconditioner();
+}
+
+zsim::ProjectionStats zsim::PcgPoissonSolver::Solve(float* p, const float* div, const ProjectionSettings& settings)
+{
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    auto elapsedMs = [&]() { return std::chrono::duration<float, std::milli>(Clock::now() - start).count(); };
+
+    ProjectionStats stats;
+    const int pitch = _r.Pitch();
+
+    // The pure Neumann problem only has a solution if the right hand side sums to 0,
+    // so the mean is removed. This doesn't change the pressure gradient
+    double sum = 0.0;
+    for (int j = 1; j <= _height; j++)
+        for (int i = 1; i <= _width; i++)
+            sum += div[j * pitch + i];
+    float mean = float(sum / (double(_width) * _height));
+
+    float rhsNorm = 0.0f;
+    for (int j = 1; j <= _height; j++)
+    {
+        for (int i = 1; i <= _width; i++)
+        {
+            _r(i, j) = div[j * pitch + i] - mean;
+            rhsNorm = std::max(rhsNorm, std::fabs(_r(i, j)));
+        }
+    }
+    if (rhsNorm == 0.0f)
+    {
+        for (int j = 1; j <= _height; j++)
+            std::fill(p + j * pitch + 1, p + j * pitch + _width + 1, 0.0f);
+        stats.milliseconds = elapsedMs();
+        return stats;
+    }
+
+    // r = b - A * p, with the previous pressure as the starting guess
+    for (int j = 1; j <= _height; j++)
+        std::copy(p + j * pitch + 1, p + j * pitch + _width + 1, _s.Row(j) + 1);
+    _MultiplyS();
+    for (int j = 1; j <= _height; j++)
+        for (int i = 1; i <= _width; i++)
+            _r(i, j) -= _q(i, j);
+
+    stats.residual = _MaxAbs(_r) / rhsNorm;
+    if (stats.residual <= settings.tolerance)
+    {
+        stats.milliseconds = elapsedMs();
+        return stats;
+    }
+
+    _ApplyPreconditioner();
+    for (int j = 1; j <= _height; j++)
+        std::copy(_z.Row(j) + 1, _z.Row(j) + _width + 1, _s.Row(j) + 1);
+    double sigma = _Dot(_z, _r);
+
+    for (int iteration = 0; iteration < settings.pcgMaxIterations; iteration++)
+    {
+        _MultiplyS();
+        double sq = _Dot(_s, _q);
+        if (sq == 0.0)
+            break;
+        float alpha = float(sigma / sq);
+        for (int j = 1; j <= _height; j++)
+        {
+            float* pRow = p + j * pitch;
+            const float* sRow = _s.Row(j);
+            const float* qRow = _q.Row(j);
+            float* rRow = _r.Row(j);
+            for (int i = 1; i <= _width; i++)
+            {
+                pRow[i] += alpha * sRow[i];
+                rRow[i] -= alpha * qRow[i];
+            }
+        }
+        stats.iterations++;
+
+        stats.residual = _MaxAbs(_r) / rhsNorm;
+        if (stats.residual <= settings.tolerance)
+            break;
+        if (settings.pcgTimeBudgetMs > 0.0f && elapsedMs() >= settings.pcgTimeBudgetMs)
+            break;
+
+        _ApplyPreconditioner();
+        double sigmaNew = _Dot(_z, _r);
+        float beta = float(sigmaNew / sigma);
+        sigma = sigmaNew;
+        for (int j = 1; j <= _height; j++)
+        {
+            float* sRow = _s.Row(j);
+            const float* zRow = _z.Row(j);
+            for (int i = 1; i <= _width; i++)
+                sRow[i] = zRow[i] + beta * sRow[i];
+        }
+    }
+
+    stats.milliseconds = elapsedMs();
+    return stats;
+}
+
+void zsim::PcgPoissonSolver::_BuildPreconditioner()
+{
+    // Modified incomplete Cholesky, with the safety fallback for cells where the factorization breaks down
+    const float tau = 0.97f;
+    const float sigma = 0.25f;
+    for (int j = 1; j <= _height; j++)
+    {
+        for (int i = 1; i <= _width; i++)
+        {
+            float diagonal = _diagonal(i, j);
+            float e = diagonal;
+            if (i > 1)
+            {
+                float left = _precon(i - 1, j);
+                e -= left * left * (1.0f + (j < _height ? tau : 0.0f));
+            }
+            if (j > 1)
+            {
+                float up = _precon(i, j - 1);
+                e -= up * up * (1.0f + (i < _width ? tau : 0.0f));
+            }
+            if (e < sigma * diagonal)
+                e = diagonal;
+            _precon(i, j) = e > 0.0f ? 1.0f / std::sqrt(e) : 0.0f;
+        }
+    }
+}
+
+void zsim::PcgPoissonSolver::_ApplyPreconditioner()
+{
+    // Each cell depends on its left and upper (forward) or right and lower (backward) neighbour,
+    // which makes a single row one long dependency chain. A band of rows is walked along the
+    // diagonal instead, each row one cell behind the previous, so the band's chains run side by side.
+    // The ghost cells of '_precon' are 0, which removes the terms of missing neighbours
+    const int pitch = _q.Pitch();
+
+    // Forward substitution into '_q'
+    for (int jStart = 1; jStart <= _height; jStart += BAND_ROWS)
+    {
+        int rows = std::min(BAND_ROWS, _height - jStart + 1);
+        for (int step = 1; step < _width + rows; step++)
+        {
+            // Rows whose cell 'step - k' lies inside the grid
+            int kStart = std::max(0, step - _width);
+            int kEnd = std::min(rows, step);
+            for (int k = kStart; k < kEnd; k++)
+            {
+                int index = _q.IndexAt(step - k, jStart + k);
+                float t = _r[index] + _precon[index - 1] * _q[index - 1] + _precon[index - pitch] * _q[index - pitch];
+                _q[index] = t * _precon[index];
+            }
+        }
+    }
+    // Backward substitution into '_z'
+    for (int jStart = _height; jStart >= 1; jStart -= BAND_ROWS)
+    {
+        int rows = std::min(BAND_ROWS, jStart);
+        for (int step = _width; step > -rows; step--)
+        {
+            int kStart = std::max(0, 1 - step);
+            int kEnd = std::min(rows, _width + 1 - step);
+            for (int k = kStart; k < kEnd; k++)
+            {
+                int index = _z.IndexAt(step + k, jStart - k);
+                float t = _q[index] + _precon[index] * (_z[index + 1] + _z[index + pitch]);
+                _z[index] = t * _precon[index];
+            }
+        }
+    }
+}
+
+void zsim::PcgPoissonSolver::_MultiplyS()
+{
+    const int pitch = _s.Pitch();
+    for (int j = 1; j <= _height; j++)
+    {
+        const float* s = _s.Row(j);
+        const float* diagonal = _diagonal.Row(j);
+        float* q = _q.Row(j);
+        for (int i = 1; i <= _width; i++)
+            q[i] = diagonal[i] * s[i] - s[i - 1] - s[i + 1] - s[i - pitch] - s[i + pitch];
+    }
+}
+
+double zsim::PcgPoissonSolver::_Dot(const Grid2D<float>& a, const Grid2D<float>& b) const
+{
+    double sum = 0.0;
+    for (int j = 1; j <= _height; j++)
+    {
+        const float* aRow = a.Row(j);
+        const float* bRow = b.Row(j);
+        // Independent partial sums, so the adds don't wait on each other
+        float lanes[LANES] = {};
+        int i = 1;
+        for (; i + LANES <= _width + 1; i += LANES)
+            for (int k = 0; k < LANES; k++)
+                lanes[k] += aRow[i + k] * bRow[i + k];
+        for (; i <= _width; i++)
+            lanes[0] += aRow[i] * bRow[i];
+        for (int k = 0; k < LANES; k++)
+            sum += lanes[k];
+    }
+    return sum;
+}
+
+float zsim::PcgPoissonSolver::_MaxAbs(const Grid2D<float>& x) const
+{
+    float lanes[LANES] = {};
+    for (int j = 1; j <= _height; j++)
+    {
+        const float* row = x.Row(j);
+        int i = 1;
+        for (; i + LANES <= _width + 1; i += LANES)
+            for (int k = 0; k < LANES; k++)
+                lanes[k] = std::max(lanes[k], std::fabs(row[i + k]));
+        for (; i <= _width; i++)
+            lanes[0] = std::max(lanes[0], std::fabs(row[i]));
+    }
+    return *std::max_element(lanes, lanes + LANES);
+}
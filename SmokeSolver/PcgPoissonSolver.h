@@ -0,0 +1,49 @@
+#pragma once
+
+#include "SmokeSolverSettings.h"
+#include "Grid2D.h"
+
+namespace zsim
+{
+    // Preconditioned conjugate gradient solver for the pressure equation used by the projection step:
+    //  4 * p[i, j] - p[i - 1, j] - p[i + 1, j] - p[i, j - 1] - p[i, j + 1] = div[i, j]
+    // with zero gradient (Neumann) boundaries. Arrays passed to Solve() are laid out like a Grid2D<float>
+    // of the same size.
+    //
+    // The preconditioner is MIC(0), a modified incomplete Cholesky factorization of the 5 point Laplacian.
+    // Its triangular solves are sequential, so the solver runs on the calling thread
+    class PcgPoissonSolver
+    {
+    public:
+        PcgPoissonSolver(int width, int height);
+
+        // Starts from the current interior of 'p' (warm start) and overwrites it. The boundary of 'p'
+        // is not touched. 'div' is only read
+        ProjectionStats Solve(float* p, const float* div, const ProjectionSettings& settings);
+
+    private:
+        static constexpr int LANES = 8;
+        // Rows processed together by the triangular solves
+        static constexpr int BAND_ROWS = 8;
+
+        int _width;
+        int _height;
+        // Ghost cells of these stay 0, which stands in for the missing neighbours at the walls
+        Grid2D<float> _r;
+        Grid2D<float> _z;
+        Grid2D<float> _s;
+        Grid2D<float> _q;
+        // Number of interior neighbours of each cell
+        Grid2D<float> _diagonal;
+        // Inverse diagonal of the incomplete Cholesky factor
+        Grid2D<float> _precon;
+
+        void _BuildPreconditioner();
+        // z = M^-1 * r
+        void _ApplyPreconditioner();
+        // q = A * s
+        void _MultiplyS();
+        double _Dot(const Grid2D<float>& a, const Grid2D<float>& b) const;
+        float _MaxAbs(const Grid2D<float>& x) const;
+    };
+}
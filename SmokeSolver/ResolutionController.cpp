@@ -0,0 +1,114 @@
+#include "ResolutionController.h"
+
+#include <algorithm>
+
+zsim::ResolutionController::ResolutionController(const ResolutionSettings& settings, ProjectionMode mode, int cellSize, int pressureIterations)
+    : _settings(settings)
+{
+    _settings.minCellSize = std::max(_settings.minCellSize, 1);
+    _settings.maxCellSize = std::max(_settings.maxCellSize, _settings.minCellSize);
+    _cellSize = std::clamp(cellSize, _settings.minCellSize, _settings.maxCellSize);
+
+    _minPressureIterations = _settings.minPressureIterations;
+    _maxPressureIterations = _settings.maxPressureIterations;
+    if (mode == ProjectionMode::PCG)
+    {
+        _minPressureIterations = _settings.minPcgIterations;
+        _maxPressureIterations = _settings.maxPcgIterations;
+    }
+    else if (mode == ProjectionMode::FFT)
+    {
+        // The exact solve has no iteration count, only the grid resolution is adjusted
+        _minPressureIterations = pressureIterations;
+        _maxPressureIterations = pressureIterations;
+    }
+    _minPressureIterations = std::max(_minPressureIterations, 1);
+    _maxPressureIterations = std::max({ _maxPressureIterations, _minPressureIterations, pressureIterations });
+    _pressureIterations = std::clamp(pressureIterations, _minPressureIterations, _maxPressureIterations);
+    _iterationStep = std::max((_maxPressureIterations - _minPressureIterations) / 8, 1);
+    _cooldown = _settings.cooldownSteps;
+}
+
+bool zsim::ResolutionController::AddSample(float stepMs)
+{
+    if (_cooldown > 0)
+    {
+        _cooldown--;
+        return false;
+    }
+
+    if (_smoothedMs == 0.0f)
+        _smoothedMs = stepMs;
+    else
+        _smoothedMs += (stepMs - _smoothedMs) * 0.1f;
+
+    if (_smoothedMs > _settings.targetStepMs * _settings.upperThreshold)
+    {
+        _overBudgetSteps++;
+        _underBudgetSteps = 0;
+    }
+    else if (_smoothedMs < _settings.targetStepMs * _settings.lowerThreshold)
+    {
+        _underBudgetSteps++;
+        _overBudgetSteps = 0;
+    }
+    else
+    {
+        _overBudgetSteps = 0;
+        _underBudgetSteps = 0;
+    }
+
+    bool changed = false;
+    if (_overBudgetSteps >= _settings.switchDelaySteps)
+        changed = _Decrease();
+    else if (_underBudgetSteps >= _settings.switchDelaySteps)
+        changed = _Increase();
+
+    if (changed)
+        _OnChanged();
+    return changed;
+}
+
+bool zsim::ResolutionController::_Decrease()
+{
+    if (_pressureIterations > _minPressureIterations)
+    {
+        _pressureIterations = std::max(_pressureIterations - _iterationStep, _minPressureIterations);
+        return true;
+    }
+    if (_cellSize < _settings.maxCellSize)
+    {
+        _cellSize++;
+        return true;
+    }
+    return false;
+}
+
+bool zsim::ResolutionController::_Increase()
+{
+    if (_cellSize > _settings.minCellSize)
+    {
+        // Step cost scales with the cell count
+        float ratio = _cellSize / float(_cellSize - 1);
+        if (_smoothedMs * ratio * ratio < _settings.targetStepMs * _settings.upperThreshold)
+        {
+            _cellSize--;
+            return true;
+        }
+        // Finer grid wouldn't fit, more iterations are cheaper
+    }
+    if (_pressureIterations < _maxPressureIterations)
+    {
+        _pressureIterations = std::min(_pressureIterations + _iterationStep, _maxPressureIterations);
+        return true;
+    }
+    return false;
+}
+
+void zsim::ResolutionController::_OnChanged()
+{
+    _smoothedMs = 0.0f;
+    _overBudgetSteps = 0;
+    _underBudgetSteps = 0;
+    _cooldown = _settings.cooldownSteps;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "SmokeSolverSettings.h"
+
+namespace zsim
+{
+    // Keeps the solver step time inside a budget by trading pressure iterations and grid resolution.
+    //
+    // When over budget, pressure iterations are dropped first and the grid is coarsened once they reach the
+    // minimum. When there is headroom, the same steps are undone in reverse order. The grid is only refined
+    // if the cost estimate for the finer grid still fits the budget, which together with the separate upper
+    // and lower thresholds keeps it from switching back and forth
+    class ResolutionController
+    {
+    public:
+        // 'pressureIterations' is the configured count of 'mode' (sweeps, V-cycles or the PCG cap). The upper
+        // bound is raised to it if needed, so enabling the controller alone never lowers it
+        ResolutionController(const ResolutionSettings& settings, ProjectionMode mode, int cellSize, int pressureIterations);
+
+        // Feeds the duration of one solver step. Returns true if the cell size or iteration count changed
+        bool AddSample(float stepMs);
+
+        int CellSize() const { return _cellSize; }
+        int PressureIterations() const { return _pressureIterations; }
+        // Exponential moving average of recent step times, 0 right after a change
+        float SmoothedStepMs() const { return _smoothedMs; }
+
+    private:
+        ResolutionSettings _settings;
+        int _cellSize;
+        int _pressureIterations;
+        // Iteration bounds of the projection mode
+        int _minPressureIterations;
+        int _maxPressureIterations;
+        // Iterations added or dropped per change, so wide ranges like the PCG one are crossed in a few changes
+        int _iterationStep;
+
+        float _smoothedMs = 0.0f;
+        int _overBudgetSteps = 0;
+        int _underBudgetSteps = 0;
+        int _cooldown = 0;
+
+        bool _Decrease();
+        bool _Increase();
+        void _OnChanged();
+    };
+}
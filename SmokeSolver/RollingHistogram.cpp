@@ -0,0 +1,108 @@
+#include "RollingHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+void zsim::LogHistogram::Add(double value)
+{
+    _counts[_BucketIndex(value)]++;
+    _count++;
+    _sum += value;
+    _max = std::max(_max, value);
+}
+
+void zsim::LogHistogram::Merge(const LogHistogram& other)
+{
+    for (size_t i = 0; i < _counts.size(); i++)
+        _counts[i] += other._counts[i];
+    _count += other._count;
+    _sum += other._sum;
+    _max = std::max(_max, other._max);
+}
+
+void zsim::LogHistogram::Clear()
+{
+    _counts.fill(0);
+    _count = 0;
+    _sum = 0.0;
+    _max = 0.0;
+}
+
+double zsim::LogHistogram::Percentile(double fraction) const
+{
+    if (_count == 0)
+        return 0.0;
+    int64_t rank = std::clamp((int64_t)std::ceil(fraction * _count), (int64_t)1, _count);
+    int64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++)
+    {
+        seen += _counts[i];
+        if (seen >= rank)
+            return i == BUCKET_COUNT - 1 ? _max : std::min(_BucketUpperBound(i), _max);
+    }
+    return _max;
+}
+
+int zsim::LogHistogram::_BucketIndex(double value)
+{
+    if (!(value >= MIN_VALUE))
+        return 0;
+    // value / MIN_VALUE = mantissa * 2^exponent, mantissa in [0.5, 1)
+    int exponent;
+    double mantissa = std::frexp(value / MIN_VALUE, &exponent);
+    int octave = exponent - 1;
+    if (octave >= OCTAVES)
+        return BUCKET_COUNT - 1;
+    int sub = std::min((int)((mantissa * 2.0 - 1.0) * SUB_BUCKETS), SUB_BUCKETS - 1);
+    return 1 + octave * SUB_BUCKETS + sub;
+}
+
+double zsim::LogHistogram::_BucketUpperBound(int index)
+{
+    if (index == 0)
+        return MIN_VALUE;
+    int octave = (index - 1) / SUB_BUCKETS;
+    int sub = (index - 1) % SUB_BUCKETS;
+    return MIN_VALUE * std::ldexp(1.0 + (sub + 1) / (double)SUB_BUCKETS, octave);
+}
+
+zsim::RollingHistogram::RollingHistogram(double windowSeconds, int slots)
+    : _slotSeconds(windowSeconds / std::max(slots, 1)),
+    _slots(std::max(slots, 1)),
+    _slotTimes(std::max(slots, 1), -1)
+{
+}
+
+void zsim::RollingHistogram::Add(double value, double nowSeconds)
+{
+    if (_firstSampleTime < 0.0)
+        _firstSampleTime = nowSeconds;
+    int64_t slotTime = _SlotTime(nowSeconds);
+    size_t index = (size_t)(slotTime % (int64_t)_slots.size());
+    if (_slotTimes[index] != slotTime)
+    {
+        _slots[index].Clear();
+        _slotTimes[index] = slotTime;
+    }
+    _slots[index].Add(value);
+}
+
+zsim::LogHistogram zsim::RollingHistogram::Window(double nowSeconds) const
+{
+    int64_t slotTime = _SlotTime(nowSeconds);
+    LogHistogram merged;
+    for (size_t i = 0; i < _slots.size(); i++)
+        if (_slotTimes[i] >= 0 && _slotTimes[i] > slotTime - (int64_t)_slots.size())
+            merged.Merge(_slots[i]);
+    return merged;
+}
+
+double zsim::RollingHistogram::Rate(double nowSeconds) const
+{
+    if (_firstSampleTime < 0.0)
+        return 0.0;
+    // From the start of the oldest slot in the window, or the first sample if that came later
+    double windowStart = (_SlotTime(nowSeconds) - (int64_t)_slots.size() + 1) * _slotSeconds;
+    double span = nowSeconds - std::max(windowStart, _firstSampleTime);
+    return span > 0.0 ? Window(nowSeconds).Count() / span : 0.0;
+}
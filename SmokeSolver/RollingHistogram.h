@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace zsim
+{
+    // Fixed memory histogram with logarithmic buckets, 8 per power of two from 0.001 to about 67 million
+    // (1 ns to 18 hours in milliseconds). Percentiles are within 1/8 of the true value
+    class LogHistogram
+    {
+    public:
+        void Add(double value);
+        void Merge(const LogHistogram& other);
+        void Clear();
+
+        int64_t Count() const { return _count; }
+        double Mean() const { return _count > 0 ? _sum / _count : 0.0; }
+        double Max() const { return _max; }
+        // Upper bound of the bucket holding the sample at 'fraction', capped at the maximum. 0 when empty
+        double Percentile(double fraction) const;
+
+    private:
+        static constexpr int SUB_BUCKETS = 8;
+        static constexpr int OCTAVES = 36;
+        static constexpr double MIN_VALUE = 0.001;
+        // Bucket 0 holds everything below MIN_VALUE, the last bucket everything above the range
+        static constexpr int BUCKET_COUNT = SUB_BUCKETS * OCTAVES + 2;
+
+        std::array<uint32_t, BUCKET_COUNT> _counts{};
+        int64_t _count = 0;
+        double _sum = 0.0;
+        double _max = 0.0;
+
+        static int _BucketIndex(double value);
+        static double _BucketUpperBound(int index);
+    };
+
+    // Samples of the last 'windowSeconds', kept as one histogram per slot so old samples expire
+    // a slot at a time. Not thread safe
+    class RollingHistogram
+    {
+    public:
+        explicit RollingHistogram(double windowSeconds = 5.0, int slots = 5);
+
+        // 'nowSeconds' is any monotonic clock, and must not go backwards between calls
+        void Add(double value, double nowSeconds);
+        // Merged histogram of the slots inside the window ending at 'nowSeconds'
+        LogHistogram Window(double nowSeconds) const;
+        // Samples per second in the window ending at 'nowSeconds'
+        double Rate(double nowSeconds) const;
+        double WindowSeconds() const { return _slotSeconds * _slots.size(); }
+
+    private:
+        double _slotSeconds;
+        std::vector<LogHistogram> _slots;
+        // Index of the time slot each histogram holds, -1 if unused
+        std::vector<int64_t> _slotTimes;
+        double _firstSampleTime = -1.0;
+
+        int64_t _SlotTime(double seconds) const { return (int64_t)(seconds / _slotSeconds); }
+    };
+}
@@ -0,0 +1,58 @@
+#include "SimulationThread.h"
+#include "TraceZones.h"
+
+#include <algorithm>
+#include <chrono>
+
+zsim::SimulationThread::~SimulationThread()
+{
+    Stop();
+}
+
+void zsim::SimulationThread::Start(std::function<void(float dt)> step, StepPolicy policy, float stepRate)
+{
+    Stop();
+    _stop.store(false);
+    _thread = std::thread(&SimulationThread::_Run, this, std::move(step), policy, stepRate);
+}
+
+void zsim::SimulationThread::Stop()
+{
+    _stop.store(true);
+    if (_thread.joinable())
+        _thread.join();
+}
+
+void zsim::SimulationThread::_Run(std::function<void(float dt)> step, StepPolicy policy, float stepRate)
+{
+    using clock = std::chrono::steady_clock;
+    const auto stepInterval = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / std::max(stepRate, 1.0f)));
+
+    ZSIM_TRACE_THREAD_NAME("Simulation");
+    auto lastStepTime = clock::now();
+    auto nextStepTime = lastStepTime + stepInterval;
+    while (!_stop.load())
+    {
+        if (policy == StepPolicy::FIXED_RATE)
+        {
+            std::this_thread::sleep_until(nextStepTime);
+            nextStepTime += stepInterval;
+        }
+
+        auto stepStart = clock::now();
+        float dt = std::chrono::duration<float>(stepStart - lastStepTime).count();
+        lastStepTime = stepStart;
+
+        {
+            ZSIM_TRACE_ZONE("simulation step");
+            step(dt);
+        }
+
+        auto stepEnd = clock::now();
+        _lastStepMs.store(std::chrono::duration<float, std::milli>(stepEnd - stepStart).count());
+
+        // Don't try to catch up after a long step, just continue from now
+        if (nextStepTime < stepEnd)
+            nextStepTime = stepEnd + stepInterval;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+namespace zsim
+{
+    enum class StepPolicy
+    {
+        // Steps at a fixed rate. Missed steps are dropped instead of being caught up on
+        FIXED_RATE,
+        // Steps again as soon as the previous step finishes
+        AS_FAST_AS_POSSIBLE
+    };
+
+    // Runs a simulation step function on its own thread, independent of the render loop
+    class SimulationThread
+    {
+    public:
+        SimulationThread() {}
+        ~SimulationThread();
+        SimulationThread(const SimulationThread&) = delete;
+        SimulationThread& operator=(const SimulationThread&) = delete;
+
+        // 'step' receives the real time since the previous step in seconds. 'stepRate' is in steps per second
+        // and only used with StepPolicy::FIXED_RATE
+        void Start(std::function<void(float dt)> step, StepPolicy policy, float stepRate);
+        // Blocks until the current step finishes
+        void Stop();
+        bool Running() const { return _thread.joinable(); }
+
+        // Duration of the most recent step() call
+        float LastStepMs() const { return _lastStepMs.load(); }
+
+    private:
+        std::thread _thread;
+        std::atomic<bool> _stop = false;
+        std::atomic<float> _lastStepMs = 0.0f;
+
+        void _Run(std::function<void(float dt)> step, StepPolicy policy, float stepRate);
+    };
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+namespace zsim
+{
+    enum class SmokeSimType
+    {
+        CURSOR_TRAIL,
+        ENHANCED_SMOKE
+    };
+}
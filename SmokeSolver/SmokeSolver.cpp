@@ -0,0 +1,935 @@
+#include "SmokeSolver.h"
+#include "AutoTuner.h"
+#include "TraceZones.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+    // Adds its lifetime to 'time', unless null, and records it as a trace zone
+    class StageScope
+    {
+    public:
+        StageScope([[maybe_unused]] zsim::SolverStage stage, zsim::StageTime* time)
+            : _time(time)
+#ifdef ZSIM_TRACE_ZONES
+            , _zone(zsim::SolverStageName(stage))
+#endif
+        {
+            if (_time)
+                _start = std::chrono::steady_clock::now();
+        }
+        ~StageScope()
+        {
+            if (!_time)
+                return;
+            _time->milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+            _time->calls++;
+        }
+        StageScope(const StageScope&) = delete;
+        StageScope& operator=(const StageScope&) = delete;
+
+    private:
+        zsim::StageTime* _time;
+        std::chrono::steady_clock::time_point _start;
+#ifdef ZSIM_TRACE_ZONES
+        zsim::TraceZone _zone;
+#endif
+    };
+}
+
+zsim::SmokeSolver::SmokeSolver(SmokeSimType simType, int width, int height, int cellSize, int threadCount)
+    : _simType(simType),
+    _width(width),
+    _height(height),
+    _totalWidth(width + 2),
+    _totalHeight(height + 2),
+    _pitch(Grid2D<float>::PitchFor(width)),
+    _cellSize(cellSize)
+{
+    for (int i = 0; i < threadCount; i++)
+        _threadPool.AddThread();
+    SetSimdLevel(SimdLevel::AVX2);
+
+    for (Grid2D<float>* field : { &u, &v, &u_prev, &v_prev, &dens, &dens_prev })
+        field->Resize(width, height);
+    if (_simType == SmokeSimType::CURSOR_TRAIL)
+    {
+        temp.Resize(width, height);
+        temp_prev.Resize(width, height);
+    }
+
+    SetTileSettings(_tiles);
+}
+
+// Defined before its first use so the template can be instantiated in this file
+template <typename F>
+void zsim::SmokeSolver::_ParallelFor(int start, int end, const F& func)
+{
+    // Bands thinner than a few rows cost more to schedule than to compute.
+    // Only a reference to 'func' is wrapped, so the std::function stays in its inline storage however much
+    // 'func' captures, and dispatching a stage doesn't allocate
+    _threadPool.ParallelFor(start, end, 8, [&func](int bandStart, int bandEnd) { func(bandStart, bandEnd); });
+}
+
+template <typename F>
+void zsim::SmokeSolver::_ForEachRowSpan(const F& func)
+{
+    _ParallelFor(1, _height + 1, [&](int startRow, int endRow) {
+        for (int j = startRow; j < endRow; j++)
+            for (const CellSpan& span : _tileRowSpans[(j - 1) / _tiles.tileSize])
+                func(j, span.start, span.end);
+        });
+}
+
+void zsim::SmokeSolver::ClearSources()
+{
+    // Step() only writes the source fields inside the processed spans and on the boundary
+    _ForEachRowSpan([=](int j, int iStart, int iEnd) {
+        int start = _IndexAt(iStart, j);
+        int end = _IndexAt(iEnd, j);
+        std::fill(u_prev.Data() + start, u_prev.Data() + end, 0.0f);
+        std::fill(v_prev.Data() + start, v_prev.Data() + end, 0.0f);
+        std::fill(dens_prev.Data() + start, dens_prev.Data() + end, 0.0f);
+        if (!temp_prev.Empty())
+            std::fill(temp_prev.Data() + start, temp_prev.Data() + end, 0.0f);
+        });
+    for (Grid2D<float>* field : { &u_prev, &v_prev, &dens_prev, &temp_prev })
+    {
+        if (field->Empty())
+            continue;
+        std::fill(field->Row(0), field->Row(0) + _totalWidth, 0.0f);
+        std::fill(field->Row(_height + 1), field->Row(_height + 1) + _totalWidth, 0.0f);
+        field->ForEachRow(1, _height + 1, [=](int, float* row) {
+            row[0] = 0.0f;
+            row[_width + 1] = 0.0f;
+            });
+    }
+}
+
+void zsim::SmokeSolver::AddStroke(const SmokeStroke& stroke, float dt)
+{
+    StageScope scope(SolverStage::STROKES, _StageTimer(SolverStage::STROKES));
+    float deltaX = stroke.endX - stroke.startX;
+    float deltaY = stroke.endY - stroke.startY;
+    float movedPixels = std::sqrt(deltaX * deltaX + deltaY * deltaY);
+    float movedCells = movedPixels / _cellSize;
+
+    float lineThickness = stroke.lineThickness;
+    float fadeRange = stroke.fadeRange;
+
+    float cursorVelX = (deltaX / float(_cellSize * _height)) / dt * stroke.windMultiplier;
+    float cursorVelY = (deltaY / float(_cellSize * _height)) / dt * stroke.windMultiplier;
+
+    // Find bounding rectangle
+    int boundLeft;
+    int boundTop;
+    int boundRight;
+    int boundBottom;
+    {
+        float left = std::min(stroke.startX, stroke.endX) - lineThickness;
+        float right = std::max(stroke.startX, stroke.endX) + lineThickness;
+        float top = std::min(stroke.startY, stroke.endY) - lineThickness;
+        float bottom = std::max(stroke.startY, stroke.endY) + lineThickness;
+        boundLeft = (int)std::floor(left / _cellSize);
+        boundTop = (int)std::floor(top / _cellSize);
+        boundRight = (int)std::ceil(right / _cellSize);
+        boundBottom = (int)std::ceil(bottom / _cellSize);
+        if (boundLeft < 0)
+            boundLeft = 0;
+        if (boundTop < 0)
+            boundTop = 0;
+        if (boundRight >= _width)
+            boundRight = _width - 1;
+        if (boundBottom >= _height)
+            boundBottom = _height - 1;
+    }
+
+    // Wake up the tiles receiving sources
+    for (int tileY = boundTop / _tiles.tileSize; tileY <= (boundBottom - 1) / _tiles.tileSize && boundTop < boundBottom; tileY++)
+        for (int tileX = boundLeft / _tiles.tileSize; tileX <= (boundRight - 1) / _tiles.tileSize && boundLeft < boundRight; tileX++)
+            _tileActive[_TileIndexAt(tileX, tileY)] = 1;
+
+    // Unit vector along the segment. A stationary cursor only touches the end point circles
+    bool hasDirection = movedPixels > 0.0f;
+    float dirX = hasDirection ? deltaX / movedPixels : 0.0f;
+    float dirY = hasDirection ? deltaY / movedPixels : 0.0f;
+
+    // Iterate through cells in bounding rectangle to check which fall inside the line
+    for (int y = boundTop; y < boundBottom; y++)
+    {
+        for (int x = boundLeft; x < boundRight; x++)
+        {
+            float cellCenterX = float(x * _cellSize + _cellSize / 2.0f);
+            float cellCenterY = float(y * _cellSize + _cellSize / 2.0f);
+            int cellIndex = _IndexAt(x + 1, y + 1);
+
+            float toStartX = cellCenterX - stroke.startX;
+            float toStartY = cellCenterY - stroke.startY;
+            float toEndX = cellCenterX - stroke.endX;
+            float toEndY = cellCenterY - stroke.endY;
+
+            bool cellNearLine = false;
+            float distanceToLine = 0.0f;
+
+            // Between start and end point
+            if (hasDirection && toStartX * dirX + toStartY * dirY >= 0.0f && toEndX * -dirX + toEndY * -dirY >= 0.0f)
+            {
+                float distToLineCenter = std::fabs(toStartX * dirY - toStartY * dirX);
+                if (distToLineCenter <= lineThickness)
+                {
+                    distanceToLine = distToLineCenter;
+                    cellNearLine = true;
+                }
+            }
+            // Near start point
+            if (!cellNearLine && toStartX * toStartX + toStartY * toStartY <= lineThickness * lineThickness)
+            {
+                distanceToLine = std::sqrt(toStartX * toStartX + toStartY * toStartY);
+                cellNearLine = true;
+            }
+            // Near end point
+            if (!cellNearLine && toEndX * toEndX + toEndY * toEndY <= lineThickness * lineThickness)
+            {
+                distanceToLine = std::sqrt(toEndX * toEndX + toEndY * toEndY);
+                cellNearLine = true;
+            }
+
+            if (!cellNearLine)
+                continue;
+
+            if (stroke.addWind)
+            {
+                if (distanceToLine <= stroke.windThickness)
+                {
+                    u_prev[cellIndex] = cursorVelX - u[cellIndex];
+                    v_prev[cellIndex] = cursorVelY - v[cellIndex];
+                }
+            }
+            if (stroke.addSmoke)
+            {
+                float targetDensity = stroke.lineDensity;
+                if (distanceToLine > lineThickness - fadeRange)
+                    targetDensity *= ((lineThickness - distanceToLine) / fadeRange);
+
+                if (dens[cellIndex] < targetDensity)
+                    dens_prev[cellIndex] = targetDensity - dens[cellIndex];
+                if (!temp.Empty() && temp[cellIndex] < stroke.cursorTemp)
+                    temp_prev[cellIndex] = (stroke.cursorTemp - temp[cellIndex]) / (1.0f + movedCells);
+            }
+        }
+    }
+}
+
+void zsim::SmokeSolver::ApplySources(float dt, float dtSim, const SmokeStepParams& params)
+{
+    StageScope scope(SolverStage::SOURCES, _StageTimer(SolverStage::SOURCES));
+    // Strokes may have woken up tiles since the last step
+    _UpdateProcessedTiles();
+
+    if (_simType == SmokeSimType::CURSOR_TRAIL)
+        _ApplySources<SmokeSimType::CURSOR_TRAIL>(dt, dtSim, params);
+    else
+        _ApplySources<SmokeSimType::ENHANCED_SMOKE>(dt, dtSim, params);
+
+    // Decay touches every tile with density, the strokes wake up the tiles they draw into
+    if (!_tiles.enabled)
+    {
+        _sourceDamage.AddAll();
+        return;
+    }
+    _sourceDamage.Clear();
+    for (int tileY = 0; tileY < _tileCountY; tileY++)
+    {
+        for (int tileX = 0; tileX < _tileCountX; tileX++)
+        {
+            int tile = _TileIndexAt(tileX, tileY);
+            if (_tileVisible[tile] || _tileActive[tile])
+                _sourceDamage.Add(tileX, tileY);
+        }
+    }
+}
+
+template <zsim::SmokeSimType Type>
+void zsim::SmokeSolver::_ApplySources(float dt, float dtSim, const SmokeStepParams& params)
+{
+    using Mode = SmokeModeTraits<Type>;
+    const float densityReduction = params.densityReductionRate * dtSim;
+    const float temperatureReduction = params.temperatureReductionRate * dtSim;
+
+    float* u = this->u.Data();
+    float* v = this->v.Data();
+    float* dens = this->dens.Data();
+    float* temp = this->temp.Data();
+    const float* u0 = u_prev.Data();
+    const float* v0 = v_prev.Data();
+    const float* dens0 = dens_prev.Data();
+    const float* temp0 = temp_prev.Data();
+    _rowMaxDensity.assign(_height + 2, 0.0f);
+    float* rowMaxDensity = _rowMaxDensity.data();
+
+    // Newly processed cells are 0 apart from their sources, so decay and buoyancy don't change them
+    _ForEachRowSpan([=](int j, int iStart, int iEnd) {
+        float maxDensity = rowMaxDensity[j];
+        for (int i = _IndexAt(iStart, j); i < _IndexAt(iEnd, j); i++)
+        {
+            // Kill velocities and densities
+            float uValue = u[i] * 0.9995f;
+            float vValue = v[i] * 0.9995f;
+            float densValue = dens[i] - densityReduction;
+            if (densValue < 0.0f)
+                densValue = 0.0f;
+
+            float vSource = v0[i];
+            if constexpr (Mode::hasTemperature)
+            {
+                float tempValue = temp[i] * 0.9995f;
+                if constexpr (Mode::temperatureFades)
+                    tempValue -= temperatureReduction;
+                if (tempValue < 0.0f)
+                    tempValue = 0.0f;
+
+                // Apply heat to velocity
+                if constexpr (Mode::buoyancy)
+                {
+                    if (tempValue > 0.0f)
+                        vSource -= tempValue * dt;
+                }
+                temp[i] = tempValue + temp0[i];
+            }
+
+            u[i] = uValue + u0[i];
+            v[i] = vValue + vSource;
+            densValue += dens0[i];
+            dens[i] = densValue;
+            maxDensity = std::max(maxDensity, densValue);
+        }
+        rowMaxDensity[j] = maxDensity;
+        });
+}
+
+void zsim::SmokeSolver::Step(float dt, const SmokeStepParams& params)
+{
+    _VelocityStep(_width, _height, u.Data(), v.Data(), u_prev.Data(), v_prev.Data(), params.velocityDiffusion, dt);
+    _DensityStep(_width, _height, dens.Data(), dens_prev.Data(), u.Data(), v.Data(), params.densityDiffusion, dt);
+    if (_simType == SmokeSimType::CURSOR_TRAIL)
+    {
+        _DensityStep(_width, _height, temp.Data(), temp_prev.Data(), u.Data(), v.Data(), params.temperatureDiffusion, dt);
+        _UpdateActiveTiles<SmokeSimType::CURSOR_TRAIL>();
+    }
+    else
+    {
+        _UpdateActiveTiles<SmokeSimType::ENHANCED_SMOKE>();
+    }
+}
+
+void zsim::SmokeSolver::ResetVelocity()
+{
+    v.Fill(0.0f);
+    u.Fill(0.0f);
+}
+
+float zsim::SmokeSolver::MaxSpeed() const
+{
+    float result = 0.0f;
+    for (int j = 1; j <= _height; j++)
+    {
+        const float* uRow = u.Row(j);
+        const float* vRow = v.Row(j);
+        for (int i = 1; i <= _width; i++)
+            result = std::max(result, std::max(std::fabs(uRow[i]), std::fabs(vRow[i])));
+    }
+    return result;
+}
+
+bool zsim::SmokeSolver::HasDensityAbove(float threshold) const
+{
+    return std::any_of(_rowMaxDensity.begin(), _rowMaxDensity.end(), [=](float value) { return value > threshold; });
+}
+
+void zsim::SmokeSolver::Resample(int width, int height, int cellSize)
+{
+    if (width == _width && height == _height && cellSize == _cellSize)
+        return;
+
+    const int oldWidth = _width;
+    const int oldHeight = _height;
+    const int oldPitch = _pitch;
+    // Cell centers of the new grid in old grid coordinates
+    const float scale = cellSize / (float)_cellSize;
+
+    _SetBoundary(_width, _height, 1, u.Data());
+    _SetBoundary(_width, _height, 2, v.Data());
+    _SetBoundary(_width, _height, 0, dens.Data());
+    if (!temp.Empty())
+        _SetBoundary(_width, _height, 0, temp.Data());
+
+    _width = width;
+    _height = height;
+    _totalWidth = width + 2;
+    _totalHeight = height + 2;
+    _pitch = Grid2D<float>::PitchFor(width);
+    _cellSize = cellSize;
+
+    for (Grid2D<float>* field : { &u, &v, &dens, &temp })
+    {
+        if (field->Empty())
+            continue;
+        Grid2D<float> oldField = std::move(*field);
+        const float* old = oldField.Data();
+        field->Resize(width, height);
+        float* x = field->Data();
+        _ParallelFor(1, _height + 1, [&](int startRow, int endRow) {
+            for (int j = startRow; j < endRow; j++)
+            {
+                float y = std::clamp((j - 0.5f) * scale + 0.5f, 0.5f, oldHeight + 0.5f);
+                int j0 = (int)y;
+                float t1 = y - j0;
+                float t0 = 1 - t1;
+                for (int i = 1; i <= _width; i++)
+                {
+                    float sx = std::clamp((i - 0.5f) * scale + 0.5f, 0.5f, oldWidth + 0.5f);
+                    int i0 = (int)sx;
+                    float s1 = sx - i0;
+                    float s0 = 1 - s1;
+
+                    int index00 = j0 * oldPitch + i0;
+                    x[_IndexAt(i, j)] =
+                        s0 * (t0 * old[index00] + t1 * old[index00 + oldPitch]) +
+                        s1 * (t0 * old[index00 + 1] + t1 * old[index00 + oldPitch + 1]);
+                }
+            }
+            });
+    }
+    _SetBoundary(_width, _height, 1, u.Data());
+    _SetBoundary(_width, _height, 2, v.Data());
+    _SetBoundary(_width, _height, 0, dens.Data());
+    if (!temp.Empty())
+        _SetBoundary(_width, _height, 0, temp.Data());
+
+    for (Grid2D<float>* field : { &u_prev, &v_prev, &dens_prev, &temp_prev, &_advectBack })
+        if (!field->Empty())
+            field->Resize(width, height);
+
+    if (_multigrid)
+        _multigrid = std::make_unique<MultigridPoissonSolver>(_width, _height, _pitch, _projection.multigridLevels);
+    if (_fft)
+        _fft = std::make_unique<FftPoissonSolver>(_width, _height, _pitch);
+    if (_pcg)
+    {
+        _pcg = std::make_unique<PcgPoissonSolver>(_width, _height);
+        for (Grid2D<float>& pressure : _pressure)
+            pressure.Resize(_width, _height);
+    }
+    SetTileSettings(_tiles);
+}
+
+void zsim::SmokeSolver::SetSimdLevel(SimdLevel level)
+{
+    _simdLevel = std::min(level, DetectSimdLevel());
+    _advectRow = GetAdvectRowKernel(_simdLevel);
+}
+
+void zsim::SmokeSolver::SetAdvectionMode(AdvectionMode mode)
+{
+    _advection = mode;
+    if (_advection == AdvectionMode::MACCORMACK)
+    {
+        if (_advectBack.Empty())
+            _advectBack.Resize(_width, _height);
+    }
+    else
+    {
+        _advectBack.Clear();
+    }
+}
+
+void zsim::SmokeSolver::SetTileSettings(const TileSettings& settings)
+{
+    _tiles = settings;
+    _tiles.tileSize = std::max(_tiles.tileSize, 1);
+    _tileCountX = (_width + _tiles.tileSize - 1) / _tiles.tileSize;
+    _tileCountY = (_height + _tiles.tileSize - 1) / _tiles.tileSize;
+    _tileRowSpans.resize(_tileCountY);
+    _stepDamage.Reset(_tileCountX, _tileCountY);
+    _stepDamage.AddAll();
+    _sourceDamage.Reset(_tileCountX, _tileCountY);
+    _sourceDamage.AddAll();
+    _ActivateAllTiles();
+}
+
+int zsim::SmokeSolver::ProcessedTileCount() const
+{
+    return (int)std::count(_tileProcessed.begin(), _tileProcessed.end(), 1);
+}
+
+void zsim::SmokeSolver::SetProjectionSettings(const ProjectionSettings& settings)
+{
+    _projection = settings;
+    if (_projection.mode == ProjectionMode::MULTIGRID)
+    {
+        if (!_multigrid || _multigrid->MaxLevels() != _projection.multigridLevels)
+            _multigrid = std::make_unique<MultigridPoissonSolver>(_width, _height, _pitch, _projection.multigridLevels);
+    }
+    else
+    {
+        _multigrid.reset();
+    }
+
+    if (_projection.mode == ProjectionMode::PCG)
+    {
+        if (!_pcg)
+        {
+            _pcg = std::make_unique<PcgPoissonSolver>(_width, _height);
+            for (Grid2D<float>& pressure : _pressure)
+                pressure.Resize(_width, _height);
+        }
+    }
+    else
+    {
+        _pcg.reset();
+        for (Grid2D<float>& pressure : _pressure)
+            pressure.Clear();
+    }
+
+    if (_projection.mode == ProjectionMode::FFT)
+    {
+        if (!_fft)
+            _fft = std::make_unique<FftPoissonSolver>(_width, _height, _pitch);
+    }
+    else
+    {
+        _fft.reset();
+    }
+}
+
+void zsim::SmokeSolver::_ActivateAllTiles()
+{
+    // Processing everything once also clears any stale values in the source fields
+    _tileActive.assign(_tileCountX * _tileCountY, 1);
+    _tileProcessed.assign(_tileCountX * _tileCountY, 1);
+    // Forces the next step to report every tile as damaged
+    _tileVisible.assign(_tileCountX * _tileCountY, 1);
+    _tileDamaged.assign(_tileCountX * _tileCountY, 1);
+    for (auto& spans : _tileRowSpans)
+    {
+        // Spans are separated by at least one tile, so this is enough for any set of processed tiles
+        spans.reserve((_tileCountX + 1) / 2);
+        spans.assign(1, { 1, _width + 1 });
+    }
+}
+
+void zsim::SmokeSolver::_UpdateProcessedTiles()
+{
+    // The pressure solve is global in every mode but Gauss-Seidel, so every tile takes part
+    bool processAll = !_tiles.enabled || _multigrid || _pcg || _fft;
+
+    for (int tileY = 0; tileY < _tileCountY; tileY++)
+    {
+        for (int tileX = 0; tileX < _tileCountX; tileX++)
+        {
+            bool processed = processAll;
+            // Active tile or a neighbour of one
+            for (int y = std::max(tileY - 1, 0); y <= std::min(tileY + 1, _tileCountY - 1) && !processed; y++)
+                for (int x = std::max(tileX - 1, 0); x <= std::min(tileX + 1, _tileCountX - 1) && !processed; x++)
+                    processed = _tileActive[_TileIndexAt(x, y)];
+            _tileProcessed[_TileIndexAt(tileX, tileY)] = processed;
+        }
+    }
+
+    for (int tileY = 0; tileY < _tileCountY; tileY++)
+    {
+        auto& spans = _tileRowSpans[tileY];
+        spans.clear();
+        for (int tileX = 0; tileX < _tileCountX; tileX++)
+        {
+            if (!_tileProcessed[_TileIndexAt(tileX, tileY)])
+                continue;
+
+            int start = 1 + tileX * _tiles.tileSize;
+            int end = std::min(start + _tiles.tileSize, _width + 1);
+            if (!spans.empty() && spans.back().end == start)
+                spans.back().end = end;
+            else
+                spans.push_back({ start, end });
+        }
+    }
+}
+
+template <zsim::SmokeSimType Type>
+void zsim::SmokeSolver::_UpdateActiveTiles()
+{
+    StageScope scope(SolverStage::TILES, _StageTimer(SolverStage::TILES));
+    using Mode = SmokeModeTraits<Type>;
+    if (!_tiles.enabled)
+    {
+        _stepDamage.AddAll();
+        return;
+    }
+
+    const int tileSize = _tiles.tileSize;
+    const float densityThreshold = _tiles.densityThreshold;
+    const float velocityThreshold = _tiles.velocityThreshold;
+    _ParallelFor(0, _tileCountX * _tileCountY, [=](int startTile, int endTile) {
+        for (int tile = startTile; tile < endTile; tile++)
+        {
+            _tileDamaged[tile] = 0;
+            if (!_tileProcessed[tile])
+                continue;
+
+            int startX = 1 + (tile % _tileCountX) * tileSize;
+            int startY = 1 + (tile / _tileCountX) * tileSize;
+            int endX = std::min(startX + tileSize, _width + 1);
+            int endY = std::min(startY + tileSize, _height + 1);
+
+            bool active = false;
+            for (int j = startY; j < endY && !active; j++)
+            {
+                for (int i = startX; i < endX; i++)
+                {
+                    int index = _IndexAt(i, j);
+                    bool hot = false;
+                    if constexpr (Mode::hasTemperature)
+                        hot = temp[index] > densityThreshold;
+                    if (dens[index] > densityThreshold ||
+                        hot ||
+                        std::fabs(u[index]) > velocityThreshold ||
+                        std::fabs(v[index]) > velocityThreshold)
+                    {
+                        active = true;
+                        break;
+                    }
+                }
+            }
+            _tileActive[tile] = active;
+
+            bool visible = false;
+            if (active)
+            {
+                dens.ForEachTileRow(startX, startY, endX, endY, [&](int, const float* cells, int count) {
+                    visible = visible || std::any_of(cells, cells + count, [](float value) { return value != 0.0f; });
+                    });
+            }
+            _tileDamaged[tile] = _tileVisible[tile] || visible;
+            _tileVisible[tile] = visible;
+
+            // Inactive tiles are skipped by the next steps, which is only exact if they hold no values
+            if (!active)
+            {
+                auto clear = [](int, float* cells, int count) { std::fill(cells, cells + count, 0.0f); };
+                u.ForEachTileRow(startX, startY, endX, endY, clear);
+                v.ForEachTileRow(startX, startY, endX, endY, clear);
+                dens.ForEachTileRow(startX, startY, endX, endY, clear);
+                if constexpr (Mode::hasTemperature)
+                    temp.ForEachTileRow(startX, startY, endX, endY, clear);
+            }
+        }
+        });
+
+    _stepDamage.Clear();
+    for (int tileY = 0; tileY < _tileCountY; tileY++)
+        for (int tileX = 0; tileX < _tileCountX; tileX++)
+            if (_tileDamaged[_TileIndexAt(tileX, tileY)])
+                _stepDamage.Add(tileX, tileY);
+}
+
+void zsim::SmokeSolver::_SetBoundary(int W, int H, int b, float* x)
+{
+    StageScope scope(SolverStage::SET_BOUNDARY, _StageTimer(SolverStage::SET_BOUNDARY));
+    switch ((BoundaryKind)b)
+    {
+    case BoundaryKind::VELOCITY_X:
+        _SetBoundary<BoundaryKind::VELOCITY_X>(W, H, x);
+        break;
+    case BoundaryKind::VELOCITY_Y:
+        _SetBoundary<BoundaryKind::VELOCITY_Y>(W, H, x);
+        break;
+    default:
+        _SetBoundary<BoundaryKind::SCALAR>(W, H, x);
+        break;
+    }
+}
+
+template <zsim::BoundaryKind Kind>
+void zsim::SmokeSolver::_SetBoundary(int W, int H, float* x)
+{
+    constexpr float signX = Kind == BoundaryKind::VELOCITY_X ? -1.0f : 1.0f;
+    constexpr float signY = Kind == BoundaryKind::VELOCITY_Y ? -1.0f : 1.0f;
+    for (int i = 1; i <= H; i++)
+    {
+        x[_IndexAt(0, i)] = signX * x[_IndexAt(1, i)];
+        x[_IndexAt(W + 1, i)] = signX * x[_IndexAt(W, i)];
+    }
+    for (int i = 1; i <= W; i++)
+    {
+        x[_IndexAt(i, 0)] = signY * x[_IndexAt(i, 1)];
+        x[_IndexAt(i, H + 1)] = signY * x[_IndexAt(i, H)];
+    }
+    x[_IndexAt(0, 0)] = 0.5 * (x[_IndexAt(1, 0)] + x[_IndexAt(0, 1)]);
+    x[_IndexAt(0, H + 1)] = 0.5 * (x[_IndexAt(1, H + 1)] + x[_IndexAt(0, H)]);
+    x[_IndexAt(W + 1, 0)] = 0.5 * (x[_IndexAt(W, 0)] + x[_IndexAt(W + 1, 1)]);
+    x[_IndexAt(W + 1, H + 1)] = 0.5 * (x[_IndexAt(W, H + 1)] + x[_IndexAt(W + 1, H)]);
+}
+
+void zsim::SmokeSolver::_Diffuse(int W, int H, int b, float* x, float* x0, float diff, float dt)
+{
+    StageScope scope(SolverStage::DIFFUSE, _StageTimer(SolverStage::DIFFUSE));
+    if (diff <= 0.0f)
+    {
+        _ForEachRowSpan([=](int j, int iStart, int iEnd) {
+            std::copy(x0 + _IndexAt(iStart, j), x0 + _IndexAt(iEnd, j), x + _IndexAt(iStart, j));
+            });
+        return;
+    }
+
+    float a = dt * diff;
+    if (_relaxation == RelaxationMode::RED_BLACK)
+    {
+        _RelaxRedBlack(W, H, b, x, x0, a, 1 + 4 * a, 4);
+        return;
+    }
+
+    for (int k = 0; k < 4; k++)
+    {
+        _ForEachRowSpan([=](int j, int iStart, int iEnd) {
+            for (int i = iStart; i < iEnd; i++)
+            {
+                int index = _IndexAt(i, j);
+                x[index] = (
+                    x0[index] + a * (
+                        x[_IndexToLeft(index)] +
+                        x[_IndexToRight(index)] +
+                        x[_IndexAbove(index)] +
+                        x[_IndexBelow(index)]
+                        )
+                    ) / (1 + 4 * a);
+            }
+            });
+    }
+
+    _SetBoundary(W, H, b, x);
+}
+
+void zsim::SmokeSolver::_RelaxRedBlack(int W, int H, int b, float* x, const float* x0, float a, float c, int iterations)
+{
+    for (int k = 0; k < iterations; k++)
+    {
+        for (int color = 0; color < 2; color++)
+        {
+            // Cells of one color only depend on cells of the other, so the row bands can be split arbitrarily
+            _ForEachRowSpan([=](int j, int iStart, int iEnd) {
+                // First cell in the span with (i + j) % 2 == color
+                for (int i = iStart + ((iStart + j + color) & 1); i < iEnd; i += 2)
+                {
+                    int index = _IndexAt(i, j);
+                    x[index] = (
+                        x0[index] + a * (
+                            x[_IndexToLeft(index)] +
+                            x[_IndexToRight(index)] +
+                            x[_IndexAbove(index)] +
+                            x[_IndexBelow(index)]
+                            )
+                        ) / c;
+                }
+                });
+            // Boundary cells next to the other color must be up to date before it is relaxed
+            _SetBoundary(W, H, b, x);
+        }
+    }
+}
+
+void zsim::SmokeSolver::_Advect(int W, int H, int b, float* d, float* d0, float* u, float* v, float dt, bool conserve)
+{
+    StageScope scope(SolverStage::ADVECT, _StageTimer(SolverStage::ADVECT));
+    float dt0 = dt * H;
+
+    // Sums are accumulated per row and added up in order afterwards, so the conservation ratio
+    // doesn't depend on how rows are split between threads
+    _oldRowSums.resize(H + 2);
+    _newRowSums.resize(H + 2);
+    float* oldRowSums = _oldRowSums.data();
+    float* newRowSums = _newRowSums.data();
+
+    // Rows without processed cells contribute nothing
+    if (conserve)
+    {
+        std::fill(_oldRowSums.begin(), _oldRowSums.end(), 0.0f);
+        std::fill(_newRowSums.begin(), _newRowSums.end(), 0.0f);
+    }
+
+    AdvectRowFunc advectRow = _advectRow;
+    const int pitch = _pitch;
+    const bool maccormack = _advection == AdvectionMode::MACCORMACK;
+    float* back = _advectBack.Data();
+    if (maccormack)
+    {
+        // Forward pass, then its result traced back to where it started
+        _ForEachRowSpan([=](int j, int iStart, int iEnd) {
+            advectRow(W, H, pitch, j, iStart, iEnd, dt0, u, v, d0, d);
+            });
+        _SetBoundary(W, H, b, d);
+        _ForEachRowSpan([=](int j, int iStart, int iEnd) {
+            advectRow(W, H, pitch, j, iStart, iEnd, -dt0, u, v, d, back);
+            });
+    }
+
+    _ForEachRowSpan([=](int j, int iStart, int iEnd) {
+        if (maccormack)
+            MacCormackCorrectRow(W, H, pitch, j, iStart, iEnd, dt0, u, v, d0, back, d);
+        else
+            advectRow(W, H, pitch, j, iStart, iEnd, dt0, u, v, d0, d);
+        if (!conserve)
+            return;
+
+        // Cells outside the spans are 0 in both fields, so the sums match a full row sweep
+        float oldValSum = oldRowSums[j];
+        float newValSum = newRowSums[j];
+        for (int i = iStart; i < iEnd; i++)
+        {
+            oldValSum += d0[_IndexAt(i, j)];
+            newValSum += d[_IndexAt(i, j)];
+        }
+        oldRowSums[j] = oldValSum;
+        newRowSums[j] = newValSum;
+        });
+
+    if (conserve)
+    {
+        double oldValSum = 0.0;
+        double newValSum = 0.0;
+        for (int j = 1; j <= H; j++)
+        {
+            oldValSum += oldRowSums[j];
+            newValSum += newRowSums[j];
+        }
+
+        if (newValSum != 0.0)
+        {
+            float ratio = float(oldValSum / newValSum);
+            _ForEachRowSpan([=](int j, int iStart, int iEnd) {
+                for (int i = iStart; i < iEnd; i++)
+                    d[_IndexAt(i, j)] *= ratio;
+                });
+        }
+    }
+
+    _SetBoundary(W, H, b, d);
+}
+
+void zsim::SmokeSolver::_Project(int W, int H, float* u, float* v, float* p, float* div, int solve)
+{
+    StageScope scope(SolverStage::PROJECT, _StageTimer(SolverStage::PROJECT));
+    // Warm started from the pressure the same solve found in the previous step
+    if (_pcg)
+        p = _pressure[solve].Data();
+
+    int i, j, k;
+    float h;
+
+    h = 1.0 / H;
+    _ForEachRowSpan([=](int j, int iStart, int iEnd) {
+        for (int i = iStart; i < iEnd; i++)
+        {
+            div[_IndexAt(i, j)] = -0.5 * h * (
+                u[_IndexAt(i + 1, j)] - u[_IndexAt(i - 1, j)] +
+                v[_IndexAt(i, j + 1)] - v[_IndexAt(i, j - 1)]
+                );
+            if (!_pcg)
+                p[_IndexAt(i, j)] = 0;
+        }
+        });
+    _SetBoundary(W, H, 0, div);
+    _SetBoundary(W, H, 0, p);
+
+    auto solveStart = std::chrono::steady_clock::now();
+    if (_multigrid)
+    {
+        _lastProjectionStats = _multigrid->Solve(p, div, _projection);
+        _SetBoundary(W, H, 0, p);
+    }
+    else if (_pcg)
+    {
+        _lastProjectionStats = _pcg->Solve(p, div, _projection);
+        _SetBoundary(W, H, 0, p);
+    }
+    else if (_fft)
+    {
+        _lastProjectionStats = _fft->Solve(p, div);
+        _SetBoundary(W, H, 0, p);
+    }
+    else
+    {
+        if (_relaxation == RelaxationMode::RED_BLACK)
+        {
+            _RelaxRedBlack(W, H, 0, p, div, 1.0f, 4.0f, _projection.gaussSeidelIterations);
+        }
+        else
+        {
+            // Updates in place, so this one runs on a single thread
+            for (k = 0; k < _projection.gaussSeidelIterations; k++)
+            {
+                for (j = 1; j <= H; j++)
+                {
+                    for (const CellSpan& span : _tileRowSpans[(j - 1) / _tiles.tileSize])
+                    {
+                        for (i = span.start; i < span.end; i++)
+                        {
+                            p[_IndexAt(i, j)] = (
+                                div[_IndexAt(i, j)] +
+                                p[_IndexAt(i - 1, j)] +
+                                p[_IndexAt(i + 1, j)] +
+                                p[_IndexAt(i, j - 1)] +
+                                p[_IndexAt(i, j + 1)]
+                                ) / 4;
+                        }
+                    }
+                }
+                _SetBoundary(W, H, 0, p);
+            }
+        }
+        _lastProjectionStats.iterations = _projection.gaussSeidelIterations;
+        _lastProjectionStats.residual = 0.0f;
+    }
+    _lastProjectionStats.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - solveStart).count();
+    _stepProjectionStats[solve] = _lastProjectionStats;
+
+    _ForEachRowSpan([=](int j, int iStart, int iEnd) {
+        for (int i = iStart; i < iEnd; i++)
+        {
+            u[_IndexAt(i, j)] -= 0.5 * (p[_IndexAt(i + 1, j)] - p[_IndexAt(i - 1, j)]) / h;
+            v[_IndexAt(i, j)] -= 0.5 * (p[_IndexAt(i, j + 1)] - p[_IndexAt(i, j - 1)]) / h;
+        }
+        });
+    _SetBoundary(W, H, 1, u);
+    _SetBoundary(W, H, 2, v);
+}
+
+void zsim::SmokeSolver::_VelocityStep(int W, int H, float* u, float* v, float* u0, float* v0, float visc, float dt)
+{
+    // Sources were added by ApplySources()
+    _SwapPtr(&u0, &u);
+    _Diffuse(W, H, 1, u, u0, visc, dt);
+    _SwapPtr(&v0, &v);
+    _Diffuse(W, H, 2, v, v0, visc, dt);
+
+    _Project(W, H, u, v, u0, v0, 0);
+
+    _SwapPtr(&u0, &u);
+    _SwapPtr(&v0, &v);
+
+    _Advect(W, H, 1, u, u0, u0, v0, dt, false);
+    _Advect(W, H, 2, v, v0, u0, v0, dt, false);
+
+    _Project(W, H, u, v, u0, v0, 1);
+}
+
+void zsim::SmokeSolver::_DensityStep(int W, int H, float* x, float* x0, float* u, float* v, float diff, float dt)
+{
+    _SwapPtr(&x0, &x);
+    _Diffuse(W, H, 0, x, x0, diff, dt);
+
+    _SwapPtr(&x0, &x);
+    _Advect(W, H, 0, x, x0, u, v, dt, true);
+}
@@ -0,0 +1,269 @@
+#pragma once
+
+#include "SmokeSimType.h"
+#include "SmokeSolverSettings.h"
+#include "MultigridPoissonSolver.h"
+#include "PcgPoissonSolver.h"
+#include "FftPoissonSolver.h"
+#include "AdvectKernels.h"
+#include "BlockRegion.h"
+#include "Grid2D.h"
+#include "ThreadPool.h"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace zsim
+{
+    // A single cursor movement segment, in pixels relative to the top left corner of the grid
+    struct SmokeStroke
+    {
+        float startX = 0.0f;
+        float startY = 0.0f;
+        float endX = 0.0f;
+        float endY = 0.0f;
+
+        bool addWind = true;
+        bool addSmoke = true;
+
+        float lineThickness = 0.0f;
+        float fadeRange = 0.0f;
+        float lineDensity = 0.0f;
+        float windThickness = 0.0f;
+        float windMultiplier = 0.0f;
+        float cursorTemp = 0.0f;
+    };
+
+    // What each overlay type simulates. Resolved at compile time, so the per cell loops don't branch on the type
+    template <SmokeSimType Type>
+    struct SmokeModeTraits;
+
+    template <>
+    struct SmokeModeTraits<SmokeSimType::CURSOR_TRAIL>
+    {
+        // Temperature fields are allocated, advected and diffused
+        static constexpr bool hasTemperature = true;
+        // Temperature drops by SmokeStepParams::temperatureReductionRate
+        static constexpr bool temperatureFades = true;
+        // Hot cells accelerate upwards
+        static constexpr bool buoyancy = true;
+    };
+
+    template <>
+    struct SmokeModeTraits<SmokeSimType::ENHANCED_SMOKE>
+    {
+        static constexpr bool hasTemperature = false;
+        static constexpr bool temperatureFades = false;
+        static constexpr bool buoyancy = false;
+    };
+
+    // How a field is mirrored into the boundary cells. Velocity components flip sign at the walls they point into
+    enum class BoundaryKind
+    {
+        SCALAR = 0,
+        VELOCITY_X = 1,
+        VELOCITY_Y = 2
+    };
+
+    struct SmokeStepParams
+    {
+        float velocityDiffusion = 0.0f;
+        float densityDiffusion = 0.0f;
+        float temperatureDiffusion = 0.0f;
+        float densityReductionRate = 0.0f;
+        float temperatureReductionRate = 0.0f;
+    };
+
+    // Stable fluids solver for the smoke overlays. Has no platform or rendering dependencies,
+    // the owner is responsible for feeding input and displaying the density field.
+    //
+    // A frame consists of:
+    //  ClearSources() -> AddStroke() (any number of times) -> ApplySources() -> Step()
+    //
+    // All fields are Grid2D fields with a 1 cell boundary around the grid and a shared padded pitch.
+    // Use IndexAt() to address cells of the raw pointers
+    class SmokeSolver
+    {
+    public:
+        // 'threadCount' of 0 runs every stage on the calling thread
+        SmokeSolver(SmokeSimType simType, int width, int height, int cellSize, int threadCount);
+        SmokeSolver(const SmokeSolver&) = delete;
+        SmokeSolver& operator=(const SmokeSolver&) = delete;
+
+        SmokeSimType SimType() const { return _simType; }
+        int Width() const { return _width; }
+        int Height() const { return _height; }
+        int TotalWidth() const { return _totalWidth; }
+        int TotalHeight() const { return _totalHeight; }
+        // Distance between rows in cells, at least TotalWidth()
+        int Pitch() const { return _pitch; }
+        int CellSize() const { return _cellSize; }
+        int IndexAt(int x, int y) const { return y * _pitch + x; }
+
+        float* U() { return u.Data(); }
+        float* V() { return v.Data(); }
+        float* Density() { return dens.Data(); }
+        // Null if the simulation type has no temperature (see SmokeModeTraits)
+        float* Temperature() { return temp.Data(); }
+        const float* Density() const { return dens.Data(); }
+        const float* Temperature() const { return temp.Data(); }
+        bool HasTemperature() const { return !temp.Empty(); }
+
+        // Zeroes the source fields. Must be called at the start of every frame
+        void ClearSources();
+        // Rasterizes a cursor movement segment into the source fields
+        void AddStroke(const SmokeStroke& stroke, float dt);
+        // Applies velocity/density/temperature decay and buoyancy, then adds the source fields to the simulated
+        // fields, in a single pass over the grid. Must be called before every Step() and before advancing the
+        // fields with an external solver. 'dt' is the real frame time, 'dtSim' is the (possibly slowed down)
+        // simulation time step
+        void ApplySources(float dt, float dtSim, const SmokeStepParams& params);
+        // Advances the simulation by 'dt'
+        void Step(float dt, const SmokeStepParams& params);
+        // Zeroes all velocities
+        void ResetVelocity();
+        // Returns true if any cell had a density above 'threshold' after the last ApplySources(),
+        // which measures it on the way
+        bool HasDensityAbove(float threshold) const;
+        // Switches to a new grid resolution, bilinearly resampling the simulated fields. Velocities are
+        // measured in grid heights, so they carry over unchanged. Source fields are cleared
+        void Resample(int width, int height, int cellSize);
+
+        // Levels above the one supported by the CPU are clamped. Defaults to the highest supported level
+        void SetSimdLevel(SimdLevel level);
+        SimdLevel GetSimdLevel() const { return _simdLevel; }
+        void SetRelaxationMode(RelaxationMode mode) { _relaxation = mode; }
+        RelaxationMode GetRelaxationMode() const { return _relaxation; }
+        void SetAdvectionMode(AdvectionMode mode);
+        AdvectionMode GetAdvectionMode() const { return _advection; }
+        // Wakes every tile, so the next step simulates the whole grid once
+        void SetTileSettings(const TileSettings& settings);
+        const TileSettings& GetTileSettings() const { return _tiles; }
+        // Tiles simulated by the last step, including the halo
+        int ProcessedTileCount() const;
+        // Tiles whose density may have changed during the last Step(), including ones that just became empty.
+        // In tile units (see TileSettings::tileSize). Covers the whole grid when tiles are disabled
+        const BlockRegion& LastStepDamage() const { return _stepDamage; }
+        // Tiles whose density the last ApplySources() may have changed, for frames that skip Step()
+        const BlockRegion& LastSourceDamage() const { return _sourceDamage; }
+        // Largest velocity component, in grid heights per second like the velocities themselves
+        float MaxSpeed() const;
+        void SetProjectionSettings(const ProjectionSettings& settings);
+        const ProjectionSettings& GetProjectionSettings() const { return _projection; }
+        // Stats of the last pressure solve. Only iterative modes with early exit measure the residual
+        const ProjectionStats& LastProjectionStats() const { return _lastProjectionStats; }
+        // Stats of both pressure solves of the last Step(), after diffusion and after advection
+        const std::array<ProjectionStats, 2>& LastStepProjectionStats() const { return _stepProjectionStats; }
+        // Accumulates the time spent in each SolverStage. Off by default, since timing the boundary
+        // updates of every relaxation sweep has a small cost
+        void SetStageTiming(bool enabled) { _stageTiming = enabled; }
+        bool GetStageTiming() const { return _stageTiming; }
+        // Totals since creation or the last reset, indexed by SolverStage
+        const std::array<StageTime, (size_t)SolverStage::COUNT>& GetStageTimes() const { return _stageTimes; }
+        void ResetStageTimes() { _stageTimes.fill(StageTime()); }
+        // Busy/idle time of each solver thread since creation or the last reset
+        std::vector<ThreadPool::WorkerStats> GetThreadStats() const { return _threadPool.GetWorkerStats(); }
+        void ResetThreadStats() { _threadPool.ResetWorkerStats(); }
+
+    private:
+        SmokeSimType _simType;
+        int _width;
+        int _height;
+        int _totalWidth;
+        int _totalHeight;
+        int _pitch;
+        int _cellSize;
+
+        ThreadPool _threadPool;
+
+        SimdLevel _simdLevel = SimdLevel::SCALAR;
+        AdvectRowFunc _advectRow = nullptr;
+        RelaxationMode _relaxation = RelaxationMode::RED_BLACK;
+        AdvectionMode _advection = AdvectionMode::SEMI_LAGRANGIAN;
+        ProjectionSettings _projection;
+
+        struct CellSpan
+        {
+            int start;
+            int end;
+        };
+        TileSettings _tiles;
+        int _tileCountX = 0;
+        int _tileCountY = 0;
+        // Tiles that contain smoke or flow. Cells of inactive tiles are kept at exactly 0
+        std::vector<char> _tileActive;
+        std::vector<char> _tileProcessed;
+        // Tiles with any non zero density
+        std::vector<char> _tileVisible;
+        // Processed tiles that were or became visible in the last step
+        std::vector<char> _tileDamaged;
+        BlockRegion _stepDamage;
+        BlockRegion _sourceDamage;
+        // Interior columns [start, end) of processed tiles for each tile row, adjacent tiles merged.
+        // The source fields (used as scratch by Step) can only be non zero inside these spans and the boundary
+        std::vector<std::vector<CellSpan>> _tileRowSpans;
+
+        bool _stageTiming = false;
+        std::array<StageTime, (size_t)SolverStage::COUNT> _stageTimes;
+
+        ProjectionStats _lastProjectionStats;
+        std::array<ProjectionStats, 2> _stepProjectionStats;
+        std::unique_ptr<MultigridPoissonSolver> _multigrid = nullptr;
+        std::unique_ptr<PcgPoissonSolver> _pcg = nullptr;
+        std::unique_ptr<FftPoissonSolver> _fft = nullptr;
+        // Pressure of each of the two solves in a step, kept for warm starting the next step in PCG mode
+        std::array<Grid2D<float>, 2> _pressure;
+
+        Grid2D<float> u;
+        Grid2D<float> v;
+        Grid2D<float> u_prev;
+        Grid2D<float> v_prev;
+        Grid2D<float> dens;
+        Grid2D<float> dens_prev;
+        Grid2D<float> temp;
+        Grid2D<float> temp_prev;
+        // Backward pass of MacCormack advection, only allocated in that mode
+        Grid2D<float> _advectBack;
+        // Per row partial sums for the advection conservation ratio
+        std::vector<float> _oldRowSums;
+        std::vector<float> _newRowSums;
+        // Per row maximum density, measured by ApplySources()
+        std::vector<float> _rowMaxDensity;
+        int _IndexAt(int x, int y) { return y * _pitch + x; }
+        inline int _IndexAbove(int index) { return index - _pitch; }
+        inline int _IndexBelow(int index) { return index + _pitch; }
+        inline int _IndexToLeft(int index) { return index - 1; }
+        inline int _IndexToRight(int index) { return index + 1; }
+        void _SwapPtr(float** l, float** r) { float* temp = *r; *r = *l; *l = temp; }
+        int _TileIndexAt(int tileX, int tileY) const { return tileY * _tileCountX + tileX; }
+        // Accumulator for 'stage', null if stage timing is off
+        StageTime* _StageTimer(SolverStage stage) { return _stageTiming ? &_stageTimes[(size_t)stage] : nullptr; }
+        void _ActivateAllTiles();
+        // Marks the tiles to simulate this step and rebuilds '_tileRowSpans'
+        void _UpdateProcessedTiles();
+        // Puts processed tiles with no smoke or flow to sleep
+        template <SmokeSimType Type>
+        void _UpdateActiveTiles();
+        template <SmokeSimType Type>
+        void _ApplySources(float dt, float dtSim, const SmokeStepParams& params);
+        // Calls func(j, iStart, iEnd) for every span of processed cells, rows are split across the thread pool
+        template <typename F>
+        void _ForEachRowSpan(const F& func);
+        // 'b' is a BoundaryKind, dispatched once per call to a loop specialized for it
+        void _SetBoundary(int W, int H, int b, float* x);
+        template <BoundaryKind Kind>
+        void _SetBoundary(int W, int H, float* x);
+        // Splits [start, end) into contiguous bands across the thread pool and waits for all of them to finish
+        template <typename F>
+        void _ParallelFor(int start, int end, const F& func);
+        // Solves x[i, j] = (x0[i, j] + a * (sum of 4 neighbours)) / c with red-black Gauss-Seidel sweeps
+        void _RelaxRedBlack(int W, int H, int b, float* x, const float* x0, float a, float c, int iterations);
+        void _Diffuse(int W, int H, int b, float* x, float* x0, float diff, float dt);
+        void _Advect(int W, int H, int b, float* d, float* d0, float* u, float* v, float dt, bool conserve);
+        // 'p' and 'div' are scratch fields. 'solve' (0 or 1) picks the warm start pressure in PCG mode
+        void _Project(int W, int H, float* u, float* v, float* p, float* div, int solve);
+        void _VelocityStep(int W, int H, float* u, float* v, float* u0, float* v0, float visc, float dt);
+        void _DensityStep(int W, int H, float* x, float* x0, float* u, float* v, float diff, float dt);
+    };
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstdint>
+
+namespace zsim
+{
+    // Instruction set used by the vectorized kernels. Higher levels include the lower ones
+    enum class SimdLevel
+    {
+        SCALAR,
+        SSE41,
+        AVX2
+    };
+
+    // Ordering of the Gauss-Seidel sweeps used by diffusion and the non multigrid pressure solve
+    enum class RelaxationMode
+    {
+        // Every thread relaxes its own band of rows in place, reading cells that other threads are writing.
+        // The result depends on thread timing
+        BANDED,
+        // Checkerboard ordering, cells of one color only read cells of the other color.
+        // Bit-reproducible regardless of the thread count
+        RED_BLACK
+    };
+
+    // Scheme used to advect density, temperature and velocity
+    enum class AdvectionMode
+    {
+        // First order semi-Lagrangian: each cell bilinearly samples the field at its back-traced position
+        SEMI_LAGRANGIAN,
+        // MacCormack: a second, backward semi-Lagrangian pass estimates the error of the first one, which is
+        // then subtracted. Results are clamped to the 4 values the first pass interpolated between, so the
+        // correction can't create new extremes. About twice the cost of SEMI_LAGRANGIAN, with much less smearing
+        MACCORMACK
+    };
+
+    struct TileSettings
+    {
+        // Only tiles containing smoke or flow, plus a 1 tile halo around them, are simulated.
+        // Must be disabled when the fields are advanced by an external solver instead of Step()
+        bool enabled = true;
+        int tileSize = 32;
+        // A tile goes to sleep (and is zeroed) once all of its cells are below these thresholds
+        float densityThreshold = 0.0001f;
+        float velocityThreshold = 0.0001f;
+    };
+
+    enum class ProjectionMode
+    {
+        // Fixed number of Gauss-Seidel sweeps starting from p = 0
+        GAUSS_SEIDEL,
+        // Geometric multigrid V-cycles until the residual drops below the tolerance
+        MULTIGRID,
+        // Conjugate gradients with a modified incomplete Cholesky preconditioner, warm started from the
+        // pressure of the previous step. Runs until the residual drops below the tolerance, the iteration cap
+        // or the time budget is reached
+        PCG,
+        // Exact solve by discrete cosine transforms, one forward and one inverse 2D transform per projection
+        FFT
+    };
+
+    enum class MultigridSmoother
+    {
+        GAUSS_SEIDEL,
+        RED_BLACK,
+        JACOBI
+    };
+
+    struct ProjectionSettings
+    {
+        ProjectionMode mode = ProjectionMode::GAUSS_SEIDEL;
+        int gaussSeidelIterations = 4;
+
+        // Upper bound on the grid hierarchy depth, coarsening also stops once a level gets too small
+        int multigridLevels = 8;
+        MultigridSmoother multigridSmoother = MultigridSmoother::RED_BLACK;
+        int preSmoothIterations = 2;
+        int postSmoothIterations = 2;
+        int coarseIterations = 32;
+        int maxCycles = 4;
+        // Solving stops once max|residual| / max|rhs| falls below this value. Used by multigrid and PCG
+        float tolerance = 0.01f;
+
+        int pcgMaxIterations = 40;
+        // Wall time a single PCG solve may take, 0 for no limit
+        float pcgTimeBudgetMs = 1.0f;
+    };
+
+    struct ProjectionStats
+    {
+        // Sweeps, V-cycles or PCG iterations. Always 1 for FFT
+        int iterations = 0;
+        // max|residual| / max|rhs| after the solve. Not measured by Gauss-Seidel
+        float residual = 0.0f;
+        float milliseconds = 0.0f;
+    };
+
+    // Parts of the solver timed by SmokeSolver::SetStageTiming()
+    enum class SolverStage
+    {
+        // AddStroke(), rasterizing cursor movement into the source fields
+        STROKES,
+        // ApplySources(), decay, buoyancy and source injection fused into one pass
+        SOURCES,
+        DIFFUSE,
+        ADVECT,
+        PROJECT,
+        // Also counted in the stage that called it
+        SET_BOUNDARY,
+        // Tile activity and damage tracking at the end of Step()
+        TILES,
+        COUNT
+    };
+
+    struct StageTime
+    {
+        double milliseconds = 0.0;
+        int64_t calls = 0;
+    };
+
+    struct ResolutionSettings
+    {
+        bool enabled = false;
+        // Target duration of a single solver step
+        float targetStepMs = 2.0f;
+        // Cell size (in pixels) bounds. Larger cells mean a coarser and cheaper grid
+        int minCellSize = 2;
+        int maxCellSize = 12;
+        // Bounds for the Gauss-Seidel iteration count, or the V-cycle count in multigrid mode
+        int minPressureIterations = 2;
+        int maxPressureIterations = 8;
+        // Bounds for the iteration cap in PCG mode, where a single iteration is much cheaper
+        int minPcgIterations = 10;
+        int maxPcgIterations = 80;
+        // The smoothed step time has to stay above target * upperThreshold (or below target * lowerThreshold)
+        // for 'switchDelaySteps' steps in a row before anything changes
+        float upperThreshold = 1.1f;
+        float lowerThreshold = 0.7f;
+        int switchDelaySteps = 30;
+        // Steps ignored after a change, so the new timings aren't mixed with the old ones
+        int cooldownSteps = 60;
+    };
+
+    // Batching of the tiny steps taken while the simulation runs slowed down (see StepScheduler)
+    struct StepSchedulerSettings
+    {
+        bool enabled = true;
+        // Simulated time collected before a step runs
+        float maxStepDt = 1.0f / 144.0f;
+        // A step runs earlier once the fastest velocity would carry the smoke this many cells over the
+        // collected time, which keeps the batched step as accurate as the unbatched ones
+        float maxCellsPerStep = 0.5f;
+    };
+}
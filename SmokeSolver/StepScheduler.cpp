@@ -0,0 +1,40 @@
+#include "StepScheduler.h"
+
+#include <algorithm>
+
+zsim::StepScheduler::StepScheduler(const StepSchedulerSettings& settings)
+    : _settings(settings)
+{
+    _settings.maxStepDt = std::max(_settings.maxStepDt, 0.0f);
+    _settings.maxCellsPerStep = std::max(_settings.maxCellsPerStep, 0.0f);
+}
+
+float zsim::StepScheduler::Advance(float dt, bool batch, float cellsPerSecond)
+{
+    _pendingDt += dt;
+
+    _stepDt = _settings.maxStepDt;
+    if (cellsPerSecond > 0.0f)
+        _stepDt = std::min(_stepDt, _settings.maxCellsPerStep / cellsPerSecond);
+
+    // Time left over from a slowdown goes into the first normal step
+    if (!_settings.enabled || !batch || _pendingDt >= _stepDt)
+    {
+        float stepDt = _pendingDt;
+        _pendingDt = 0.0f;
+        return stepDt;
+    }
+    return 0.0f;
+}
+
+float zsim::StepScheduler::Progress() const
+{
+    if (_stepDt <= 0.0f)
+        return 1.0f;
+    return std::min(_pendingDt / _stepDt, 1.0f);
+}
+
+void zsim::StepScheduler::Reset()
+{
+    _pendingDt = 0.0f;
+}
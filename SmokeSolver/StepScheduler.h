@@ -0,0 +1,35 @@
+#pragma once
+
+#include "SmokeSolverSettings.h"
+
+namespace zsim
+{
+    // Decides when the solver steps while the simulation is slowed down.
+    //
+    // A slowed down frame only advances the fluid by a fraction of a normal step, which costs as much as a
+    // full one. Instead, simulated time is collected over several frames and the solver advances once by
+    // the sum, when it reaches 'maxStepDt' or when the fluid is fast enough to move 'maxCellsPerStep' cells.
+    // Sources are still applied every frame, so drawing stays responsive. Outside of slowdowns every frame steps
+    class StepScheduler
+    {
+    public:
+        explicit StepScheduler(const StepSchedulerSettings& settings);
+
+        // Adds 'dt' of simulated time. 'batch' is true while the simulation is slowed down and
+        // 'cellsPerSecond' is the fastest velocity of the fluid in grid cells per second.
+        // Returns the time the solver should advance by now, or 0 if the step should be skipped
+        float Advance(float dt, bool batch, float cellsPerSecond);
+        // How far the collected time is towards the next batched step, in [0, 1]
+        float Progress() const;
+        // Drops the collected time
+        void Reset();
+
+        const StepSchedulerSettings& Settings() const { return _settings; }
+
+    private:
+        StepSchedulerSettings _settings;
+        float _pendingDt = 0.0f;
+        // Collected time at which the next batched step runs
+        float _stepDt = 0.0f;
+    };
+}
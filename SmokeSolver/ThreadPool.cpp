@@ -0,0 +1,216 @@
+#include "ThreadPool.h"
+#include "TraceZones.h"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ZSIM_CPU_RELAX() _mm_pause()
+#else
+#define ZSIM_CPU_RELAX() std::this_thread::yield()
+#endif
+
+namespace
+{
+    constexpr int MIN_SPIN_COUNT = 64;
+    constexpr int MAX_SPIN_COUNT = 16384;
+
+    int64_t NowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop.store(true);
+    }
+    _workAvailable.notify_all();
+    for (auto& worker : _workers)
+        if (worker->handle.joinable())
+            worker->handle.join();
+}
+
+void ThreadPool::AddThread()
+{
+    auto worker = std::make_unique<Worker>();
+    worker->handle = std::thread(&ThreadPool::_WorkerThread, this, worker.get());
+    _workers.push_back(std::move(worker));
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+    if (_workers.empty())
+    {
+        task();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _Push(std::move(task));
+        _pendingTasks++;
+    }
+    _workAvailable.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (_pendingTasks > 0)
+    {
+        std::function<void()> task;
+        if (_TryPop(task))
+        {
+            lock.unlock();
+            {
+                ZSIM_TRACE_ZONE("pool task");
+                task();
+            }
+            _FinishTask();
+            lock.lock();
+            continue;
+        }
+        _allDone.wait(lock, [&] { return _pendingTasks == 0 || _queueSize > 0; });
+    }
+}
+
+void ThreadPool::ParallelFor(int start, int end, int grain, const std::function<void(int, int)>& func)
+{
+    int count = end - start;
+    if (count <= 0)
+        return;
+
+    // One chunk per worker plus one for the calling thread
+    int maxChunks = std::max(1, count / std::max(grain, 1));
+    int chunkCount = std::min(ThreadCount() + 1, maxChunks);
+    if (chunkCount == 1)
+    {
+        func(start, end);
+        return;
+    }
+
+    int chunkSize = count / chunkCount;
+    int remainder = count % chunkCount;
+    int chunkStart = start;
+    for (int i = 0; i < chunkCount; i++)
+    {
+        int chunkEnd = chunkStart + chunkSize + (i < remainder ? 1 : 0);
+        Submit([&func, chunkStart, chunkEnd]() { func(chunkStart, chunkEnd); });
+        chunkStart = chunkEnd;
+    }
+    Wait();
+}
+
+std::vector<ThreadPool::WorkerStats> ThreadPool::GetWorkerStats() const
+{
+    std::vector<WorkerStats> stats;
+    for (auto& worker : _workers)
+    {
+        WorkerStats workerStats;
+        workerStats.busyNs = worker->busyNs.load();
+        workerStats.idleNs = worker->idleNs.load();
+        workerStats.tasksCompleted = worker->tasksCompleted.load();
+        stats.push_back(workerStats);
+    }
+    return stats;
+}
+
+void ThreadPool::ResetWorkerStats()
+{
+    for (auto& worker : _workers)
+    {
+        worker->busyNs.store(0);
+        worker->idleNs.store(0);
+        worker->tasksCompleted.store(0);
+    }
+}
+
+void ThreadPool::_WorkerThread(Worker* worker)
+{
+    ZSIM_TRACE_THREAD_NAME("Pool worker");
+    while (true)
+    {
+        int64_t idleStart = NowNs();
+
+        // Work usually arrives in bursts (one solver stage after another), so spin briefly before parking
+        bool foundWork = false;
+        for (int i = 0; i < worker->spinCount; i++)
+        {
+            if (_queuedCount.load(std::memory_order_relaxed) > 0 || _stop.load(std::memory_order_relaxed))
+            {
+                foundWork = true;
+                break;
+            }
+            ZSIM_CPU_RELAX();
+        }
+        if (foundWork)
+            worker->spinCount = std::min(worker->spinCount * 2, MAX_SPIN_COUNT);
+        else
+            worker->spinCount = std::max(worker->spinCount / 2, MIN_SPIN_COUNT);
+
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _workAvailable.wait(lock, [&] { return _stop || _queueSize > 0; });
+            if (!_TryPop(task))
+                return; // Stopping with an empty queue
+        }
+
+        int64_t busyStart = NowNs();
+        worker->idleNs.fetch_add(busyStart - idleStart, std::memory_order_relaxed);
+        task();
+        int64_t busyEnd = NowNs();
+        worker->busyNs.fetch_add(busyEnd - busyStart, std::memory_order_relaxed);
+#ifdef ZSIM_TRACE_ZONES
+        if (zsim::TraceZones::Recording())
+            zsim::TraceZones::Record("pool task", busyStart, busyEnd);
+#endif
+        worker->tasksCompleted.fetch_add(1, std::memory_order_relaxed);
+
+        _FinishTask();
+    }
+}
+
+void ThreadPool::_Push(std::function<void()> task)
+{
+    if (_queueSize == _queue.size())
+    {
+        // Full, unroll into a larger buffer
+        std::vector<std::function<void()>> grown(std::max<size_t>(_queue.size() * 2, 16));
+        for (size_t i = 0; i < _queueSize; i++)
+            grown[i] = std::move(_queue[(_queueHead + i) % _queue.size()]);
+        _queue = std::move(grown);
+        _queueHead = 0;
+    }
+    _queue[(_queueHead + _queueSize) % _queue.size()] = std::move(task);
+    _queueSize++;
+    _queuedCount.fetch_add(1);
+}
+
+bool ThreadPool::_TryPop(std::function<void()>& task)
+{
+    if (_queueSize == 0)
+        return false;
+
+    task = std::move(_queue[_queueHead]);
+    _queue[_queueHead] = nullptr;
+    _queueHead = (_queueHead + 1) % _queue.size();
+    _queueSize--;
+    _queuedCount.fetch_sub(1);
+    return true;
+}
+
+void ThreadPool::_FinishTask()
+{
+    bool done;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        done = --_pendingTasks == 0;
+    }
+    if (done)
+        _allDone.notify_all();
+}
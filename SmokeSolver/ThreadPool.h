@@ -0,0 +1,78 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <cstdint>
+
+// Task queue with parked workers. An idle worker spins briefly for new work before
+// sleeping on a condition variable, so an idle pool costs no CPU time
+class ThreadPool
+{
+public:
+    struct WorkerStats
+    {
+        // Time spent running tasks
+        int64_t busyNs = 0;
+        // Time spent spinning or parked while waiting for tasks. A wait is counted once the next task arrives
+        int64_t idleNs = 0;
+        int64_t tasksCompleted = 0;
+    };
+
+    ThreadPool() {}
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void AddThread();
+    int ThreadCount() const { return (int)_workers.size(); }
+
+    // Queues a task. With no threads the task runs immediately on the calling thread
+    void Submit(std::function<void()> task);
+    // Blocks until every submitted task has finished. The calling thread runs queued tasks while waiting
+    void Wait();
+    // Splits [start, end) into contiguous chunks of at least 'grain' items, runs func(chunkStart, chunkEnd)
+    // for each of them across the pool and the calling thread, and waits for all of them to finish
+    void ParallelFor(int start, int end, int grain, const std::function<void(int, int)>& func);
+
+    std::vector<WorkerStats> GetWorkerStats() const;
+    void ResetWorkerStats();
+
+private:
+    struct Worker
+    {
+        std::thread handle;
+        // Number of spin iterations before parking. Grows when spinning finds work, shrinks when it doesn't
+        int spinCount = 1024;
+
+        std::atomic<int64_t> busyNs = 0;
+        std::atomic<int64_t> idleNs = 0;
+        std::atomic<int64_t> tasksCompleted = 0;
+    };
+    std::vector<std::unique_ptr<Worker>> _workers;
+
+    std::mutex _mutex;
+    std::condition_variable _workAvailable;
+    std::condition_variable _allDone;
+    // Ring buffer of queued tasks. It only grows, so once it has reached the burst size of the solver stages,
+    // queueing a task doesn't allocate (a deque allocates and frees blocks as tasks pass through it)
+    std::vector<std::function<void()>> _queue;
+    size_t _queueHead = 0;
+    size_t _queueSize = 0;
+    // Queued and running tasks
+    int _pendingTasks = 0;
+    // Mirrors _queueSize so spinning workers don't need the lock
+    std::atomic<int> _queuedCount = 0;
+    std::atomic<bool> _stop = false;
+
+    void _WorkerThread(Worker* worker);
+    // Must be called with '_mutex' locked
+    void _Push(std::function<void()> task);
+    // Pops a task if one is queued. Must be called with '_mutex' locked
+    bool _TryPop(std::function<void()>& task);
+    void _FinishTask();
+};
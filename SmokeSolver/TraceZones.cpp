@@ -0,0 +1,202 @@
+#include "TraceZones.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    constexpr uint64_t BUFFER_SIZE = 1 << 16;
+    // Buffers of exited threads kept for export, e.g. of the workers of a solver that was just recreated
+    constexpr int MAX_EXITED_BUFFERS = 16;
+
+    struct ZoneRecord
+    {
+        const char* name;
+        int64_t startNs;
+        int64_t endNs;
+    };
+
+    struct ThreadBuffer
+    {
+        int id = 0;
+        // Guarded by the registry mutex
+        std::string name;
+        bool exited = false;
+        std::vector<ZoneRecord> zones = std::vector<ZoneRecord>(BUFFER_SIZE);
+        // Total zones recorded, zone i is at i % BUFFER_SIZE
+        std::atomic<uint64_t> written = 0;
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        int nextId = 1;
+    };
+
+    Registry& GetRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    // Marks the buffer as exited when its thread exits, dropping the oldest exited buffers over the limit
+    struct ThreadBufferHolder
+    {
+        std::shared_ptr<ThreadBuffer> buffer;
+
+        ~ThreadBufferHolder()
+        {
+            if (!buffer)
+                return;
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            buffer->exited = true;
+            int exitedCount = 0;
+            for (const auto& other : registry.buffers)
+                if (other->exited)
+                    exitedCount++;
+            // Buffers are in creation order
+            for (auto it = registry.buffers.begin(); it != registry.buffers.end() && exitedCount > MAX_EXITED_BUFFERS;)
+            {
+                if ((*it)->exited)
+                {
+                    it = registry.buffers.erase(it);
+                    exitedCount--;
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+    };
+    thread_local ThreadBufferHolder threadBuffer;
+
+    ThreadBuffer& CurrentBuffer()
+    {
+        if (!threadBuffer.buffer)
+        {
+            auto buffer = std::make_shared<ThreadBuffer>();
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            buffer->id = registry.nextId++;
+            registry.buffers.push_back(buffer);
+            threadBuffer.buffer = std::move(buffer);
+        }
+        return *threadBuffer.buffer;
+    }
+
+    void WriteJsonString(std::ostream& out, const std::string& text)
+    {
+        out << '"';
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                out << '\\' << c;
+            else if ((unsigned char)c < 0x20)
+                out << ' ';
+            else
+                out << c;
+        }
+        out << '"';
+    }
+}
+
+std::atomic<bool> zsim::TraceZones::_recording = true;
+
+void zsim::TraceZones::SetThreadName(const std::string& name)
+{
+    ThreadBuffer& buffer = CurrentBuffer();
+    std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+    buffer.name = name;
+}
+
+void zsim::TraceZones::Record(const char* name, int64_t startNs, int64_t endNs)
+{
+    ThreadBuffer& buffer = CurrentBuffer();
+    uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    buffer.zones[index % BUFFER_SIZE] = { name, startNs, endNs };
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+int64_t zsim::TraceZones::NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool zsim::TraceZones::WriteChromeTrace(const std::string& path, double seconds)
+{
+    struct ThreadZones
+    {
+        int id;
+        std::string name;
+        std::vector<ZoneRecord> zones;
+    };
+    std::vector<ThreadZones> threads;
+
+    int64_t cutoffNs = NowNs() - (int64_t)(seconds * 1e9);
+    {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (const auto& buffer : registry.buffers)
+        {
+            ThreadZones thread{ buffer->id, buffer->name, {} };
+            uint64_t end = buffer->written.load(std::memory_order_acquire);
+            uint64_t begin = end > BUFFER_SIZE ? end - BUFFER_SIZE : 0;
+            std::vector<ZoneRecord> copied;
+            for (uint64_t i = begin; i < end; i++)
+                copied.push_back(buffer->zones[i % BUFFER_SIZE]);
+
+            // The owning thread keeps recording during the copy, the oldest zones may have been overwritten.
+            // Zone 'after' may be half written, and its slot is the one of zone 'after - BUFFER_SIZE'
+            uint64_t after = buffer->written.load(std::memory_order_acquire);
+            uint64_t firstValid = after + 1 > BUFFER_SIZE ? after + 1 - BUFFER_SIZE : 0;
+            for (uint64_t i = std::max(begin, firstValid); i < end; i++)
+            {
+                const ZoneRecord& zone = copied[i - begin];
+                if (zone.endNs >= cutoffNs)
+                    thread.zones.push_back(zone);
+            }
+            threads.push_back(std::move(thread));
+        }
+    }
+
+    int64_t originNs = INT64_MAX;
+    for (const ThreadZones& thread : threads)
+        for (const ZoneRecord& zone : thread.zones)
+            originNs = std::min(originNs, zone.startNs);
+
+    std::ofstream file(path);
+    if (!file)
+        return false;
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    char times[64];
+    for (const ThreadZones& thread : threads)
+    {
+        if (!thread.name.empty())
+        {
+            file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.id << ",\"args\":{\"name\":";
+            WriteJsonString(file, thread.name);
+            file << "}}";
+            first = false;
+        }
+        for (const ZoneRecord& zone : thread.zones)
+        {
+            // Microseconds
+            std::snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f", (zone.startNs - originNs) / 1e3, (zone.endNs - zone.startNs) / 1e3);
+            file << (first ? "" : ",\n") << "{\"name\":";
+            WriteJsonString(file, zone.name);
+            file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.id << ',' << times << '}';
+            first = false;
+        }
+    }
+    file << "\n]}\n";
+    return (bool)file;
+}
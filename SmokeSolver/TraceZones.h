@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace zsim
+{
+    // Scoped timing zones for finding where a frame went, exported as Chrome trace_event JSON which opens in
+    // Perfetto (ui.perfetto.dev) or chrome://tracing.
+    //
+    // Zones are only compiled in when ZSIM_TRACE_ZONES is defined, otherwise the macros below expand to
+    // nothing. Each thread records into its own ring buffer, so a zone costs two clock reads and a few
+    // stores while recording and a relaxed load while not. A buffer holds the last 65536 zones of its thread,
+    // the buffers of the 16 threads that exited last are kept as well
+    class TraceZones
+    {
+    public:
+        static constexpr bool Enabled()
+        {
+#ifdef ZSIM_TRACE_ZONES
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        // Recording starts enabled
+        static void SetRecording(bool recording) { _recording.store(recording, std::memory_order_relaxed); }
+        static bool Recording() { return _recording.load(std::memory_order_relaxed); }
+
+        // Track name of the calling thread in the exported trace
+        static void SetThreadName(const std::string& name);
+        // 'name' must outlive the export, usually a string literal
+        static void Record(const char* name, int64_t startNs, int64_t endNs);
+        static int64_t NowNs();
+
+        // Writes the zones of every thread that ended in the last 'seconds'. Returns false if the file
+        // couldn't be written
+        static bool WriteChromeTrace(const std::string& path, double seconds);
+
+    private:
+        static std::atomic<bool> _recording;
+    };
+
+    // Records its lifetime as a zone
+    class TraceZone
+    {
+    public:
+        explicit TraceZone(const char* name)
+            : _name(name),
+            _startNs(TraceZones::Recording() ? TraceZones::NowNs() : -1)
+        {
+        }
+        ~TraceZone()
+        {
+            if (_startNs >= 0)
+                TraceZones::Record(_name, _startNs, TraceZones::NowNs());
+        }
+        TraceZone(const TraceZone&) = delete;
+        TraceZone& operator=(const TraceZone&) = delete;
+
+    private:
+        const char* _name;
+        int64_t _startNs;
+    };
+}
+
+#ifdef ZSIM_TRACE_ZONES
+#define ZSIM_TRACE_CONCAT_INNER(a, b) a##b
+#define ZSIM_TRACE_CONCAT(a, b) ZSIM_TRACE_CONCAT_INNER(a, b)
+// Times the rest of the enclosing scope
+#define ZSIM_TRACE_ZONE(name) ::zsim::TraceZone ZSIM_TRACE_CONCAT(traceZone, __LINE__)(name)
+#define ZSIM_TRACE_THREAD_NAME(name) ::zsim::TraceZones::SetThreadName(name)
+#else
+#define ZSIM_TRACE_ZONE(name) ((void)0)
+#define ZSIM_TRACE_THREAD_NAME(name) ((void)0)
+#endif
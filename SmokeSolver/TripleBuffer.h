@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+
+namespace zsim
+{
+    // Single producer, single consumer triple buffer. The producer always has a buffer to write into and
+    // the consumer always reads the latest completed one. Neither side locks or waits for the other
+    template <typename T>
+    class TripleBuffer
+    {
+    public:
+        TripleBuffer() {}
+        TripleBuffer(const TripleBuffer&) = delete;
+        TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+        // Only accessed by the producer
+        T& WriteBuffer() { return _buffers[_writeIndex]; }
+        // Which of the 3 buffers WriteBuffer() currently is
+        int WriteIndex() const { return _writeIndex; }
+
+        // Hands the write buffer over to the consumer and takes the previously published (or released) one.
+        // Returns true if the buffer taken back was published but never acquired
+        bool Publish()
+        {
+            int previous = _middle.exchange(_writeIndex | NEW_DATA_BIT, std::memory_order_acq_rel);
+            _writeIndex = previous & INDEX_MASK;
+            return (previous & NEW_DATA_BIT) != 0;
+        }
+
+        // Switches the read buffer to the latest published one. Returns false if nothing new was published
+        bool Acquire()
+        {
+            if (!(_middle.load(std::memory_order_acquire) & NEW_DATA_BIT))
+                return false;
+            _readIndex = _middle.exchange(_readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+            return true;
+        }
+
+        // Only accessed by the consumer. Default constructed until the first Acquire() succeeds
+        const T& ReadBuffer() const { return _buffers[_readIndex]; }
+
+    private:
+        static constexpr int INDEX_MASK = 3;
+        static constexpr int NEW_DATA_BIT = 4;
+
+        T _buffers[3];
+        int _writeIndex = 0;
+        // Index of the buffer between the two sides, plus NEW_DATA_BIT if it hasn't been read yet
+        std::atomic<int> _middle = 1;
+        int _readIndex = 2;
+    };
+}
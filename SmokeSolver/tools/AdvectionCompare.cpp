@@ -0,0 +1,232 @@
+// Headless comparison of the advection schemes: how sharp the smoke stays and what a frame costs,
+// for each scheme at each cell size.
+//
+// Usage: SmokeSolverAdvectionCompare [--type trail|smoke] [--width W] [--height H] [--rate STEPS_PER_SECOND]
+//                                    [--threads N] [--steps N] [--cells 2,3,4,6]
+//
+// Sharpness is reported as the detail length sqrt(sum(d^2) / sum(|grad d|^2)) of the density field, in screen
+// pixels: the typical distance over which the smoke changes. Blurrier fields have longer detail lengths.
+// The workload is the scripted cursor sweep of the auto tuner
+
+#include "SmokeSolver/SmokeSolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Settings
+    {
+        zsim::SmokeSimType simType = zsim::SmokeSimType::CURSOR_TRAIL;
+        int pixelWidth = 1920;
+        int pixelHeight = 1080;
+        float stepRate = 144.0f;
+        int threadCount = 4;
+        int steps = 300;
+        std::vector<int> cellSizes = { 2, 3, 4, 6 };
+    };
+
+    struct Result
+    {
+        float frameMs = 0.0f;
+        float detailPx = 0.0f;
+    };
+
+    float Median(std::vector<float> values)
+    {
+        if (values.empty())
+            return 0.0f;
+        auto mid = values.begin() + values.size() / 2;
+        std::nth_element(values.begin(), mid, values.end());
+        return *mid;
+    }
+
+    float DetailLength(zsim::SmokeSolver& solver)
+    {
+        const float* d = solver.Density();
+        int pitch = solver.Pitch();
+        double energy = 0.0;
+        double gradientEnergy = 0.0;
+        for (int y = 1; y < solver.Height(); y++)
+        {
+            for (int x = 1; x < solver.Width(); x++)
+            {
+                int index = y * pitch + x;
+                double dx = d[index + 1] - d[index];
+                double dy = d[index + pitch] - d[index];
+                energy += (double)d[index] * d[index];
+                gradientEnergy += dx * dx + dy * dy;
+            }
+        }
+        if (gradientEnergy == 0.0)
+            return 0.0f;
+        // Differences are per cell, so the length comes out in cells
+        return float(std::sqrt(energy / gradientEnergy) * solver.CellSize());
+    }
+
+    Result Run(const Settings& settings, int cellSize, zsim::AdvectionMode mode)
+    {
+        int width = std::max(settings.pixelWidth / cellSize, 1);
+        int height = std::max(settings.pixelHeight / cellSize, 1);
+        zsim::SmokeSolver solver(settings.simType, width, height, cellSize, settings.threadCount);
+        solver.SetAdvectionMode(mode);
+
+        // Same parameters and stroke as the auto tuner
+        bool trail = settings.simType == zsim::SmokeSimType::CURSOR_TRAIL;
+        zsim::SmokeStepParams params;
+        params.temperatureDiffusion = trail ? 6.0f : 0.0f;
+        params.densityReductionRate = trail ? 0.15f : 0.02f;
+        params.temperatureReductionRate = trail ? 0.05f : 0.0f;
+        zsim::SmokeStroke stroke;
+        stroke.lineThickness = 10.0f;
+        stroke.fadeRange = 8.0f;
+        stroke.lineDensity = 0.7f;
+        stroke.windThickness = 10.0f;
+        stroke.windMultiplier = 0.2f;
+        stroke.cursorTemp = trail ? 0.4f : 0.0f;
+
+        const float dt = 1.0f / std::max(settings.stepRate, 1.0f);
+        // The first half lets the trail build up, the second half is measured
+        const int warmupSteps = settings.steps / 2;
+        std::vector<float> frameMs;
+        std::vector<float> detailPx;
+        float prevX = 0.0f;
+        float prevY = 0.0f;
+        for (int step = 0; step < settings.steps; step++)
+        {
+            float t = step * dt;
+            float x = settings.pixelWidth * (0.5f + 0.4f * std::sin(t * 3.1f));
+            float y = settings.pixelHeight * (0.5f + 0.4f * std::sin(t * 4.3f + 0.5f));
+            if (step == 0)
+            {
+                prevX = x;
+                prevY = y;
+            }
+
+            auto start = Clock::now();
+            solver.ClearSources();
+            stroke.startX = prevX;
+            stroke.startY = prevY;
+            stroke.endX = x;
+            stroke.endY = y;
+            solver.AddStroke(stroke, dt);
+            solver.ApplySources(dt, dt, params);
+            solver.Step(dt, params);
+            auto end = Clock::now();
+
+            prevX = x;
+            prevY = y;
+            if (step < warmupSteps)
+                continue;
+            frameMs.push_back(std::chrono::duration<float, std::milli>(end - start).count());
+            detailPx.push_back(DetailLength(solver));
+        }
+
+        Result result;
+        result.frameMs = Median(frameMs);
+        result.detailPx = Median(detailPx);
+        return result;
+    }
+
+    std::vector<int> ParseList(const char* text)
+    {
+        std::vector<int> values;
+        for (const char* c = text; *c; )
+        {
+            int value = std::atoi(c);
+            if (value > 0)
+                values.push_back(value);
+            const char* comma = std::strchr(c, ',');
+            if (!comma)
+                break;
+            c = comma + 1;
+        }
+        return values;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Settings settings;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--type") && hasValue)
+            settings.simType = !std::strcmp(argv[++i], "smoke") ? zsim::SmokeSimType::ENHANCED_SMOKE : zsim::SmokeSimType::CURSOR_TRAIL;
+        else if (!std::strcmp(argv[i], "--width") && hasValue)
+            settings.pixelWidth = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--height") && hasValue)
+            settings.pixelHeight = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--rate") && hasValue)
+            settings.stepRate = (float)std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--threads") && hasValue)
+            settings.threadCount = std::max(std::atoi(argv[++i]), 1);
+        else if (!std::strcmp(argv[i], "--steps") && hasValue)
+            settings.steps = std::max(std::atoi(argv[++i]), 2);
+        else if (!std::strcmp(argv[i], "--cells") && hasValue)
+            settings.cellSizes = ParseList(argv[++i]);
+        else
+        {
+            std::fprintf(stderr, "Unknown argument '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (settings.pixelWidth <= 0 || settings.pixelHeight <= 0 || settings.cellSizes.empty())
+    {
+        std::fprintf(stderr, "Invalid overlay size or cell sizes\n");
+        return 1;
+    }
+
+    struct Row
+    {
+        int cellSize;
+        Result semiLagrangian;
+        Result macCormack;
+    };
+    std::vector<Row> rows;
+    for (int cellSize : settings.cellSizes)
+    {
+        Row row;
+        row.cellSize = cellSize;
+        row.semiLagrangian = Run(settings, cellSize, zsim::AdvectionMode::SEMI_LAGRANGIAN);
+        row.macCormack = Run(settings, cellSize, zsim::AdvectionMode::MACCORMACK);
+        rows.push_back(row);
+        std::fprintf(stderr, "\r%d/%d", (int)rows.size(), (int)settings.cellSizes.size());
+    }
+    std::fprintf(stderr, "\n");
+
+    std::printf("cellSize,semiLagrangianMs,semiLagrangianDetailPx,macCormackMs,macCormackDetailPx\n");
+    for (const Row& row : rows)
+    {
+        std::printf("%d,%.3f,%.2f,%.3f,%.2f\n",
+            row.cellSize,
+            row.semiLagrangian.frameMs,
+            row.semiLagrangian.detailPx,
+            row.macCormack.frameMs,
+            row.macCormack.detailPx);
+    }
+
+    // For every MacCormack run, the finest semi-Lagrangian cell size it is at least as sharp as
+    std::printf("\n");
+    for (const Row& mc : rows)
+    {
+        const Row* match = nullptr;
+        for (const Row& sl : rows)
+            if (mc.macCormack.detailPx <= sl.semiLagrangian.detailPx && (!match || sl.cellSize < match->cellSize))
+                match = &sl;
+        if (!match || match->cellSize >= mc.cellSize)
+            continue;
+        std::printf("MacCormack at cell size %d (%.2f px, %.3f ms) is as sharp as semi-Lagrangian at cell size %d (%.2f px, %.3f ms)\n",
+            mc.cellSize, mc.macCormack.detailPx, mc.macCormack.frameMs,
+            match->cellSize, match->semiLagrangian.detailPx, match->semiLagrangian.frameMs);
+    }
+    return 0;
+}
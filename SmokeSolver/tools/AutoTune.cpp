@@ -0,0 +1,116 @@
+// Headless version of the auto-tune button in the smoke overlay settings.
+//
+// Usage: SmokeSolverAutoTune [--type trail|smoke] [--width W] [--height H] [--rate STEPS_PER_SECOND]
+//                            [--csv PATH] [--config PATH]
+//
+// Prints the measured table and the picked configuration. With --config, the picked values are written into
+// the overlay's config file (key=value lines, same format as Options)
+
+#include "SmokeSolver/AutoTuner.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+
+namespace
+{
+    bool UpdateConfig(const std::string& path, const std::map<std::string, std::string>& values)
+    {
+        std::map<std::string, std::string> config;
+        std::ifstream fin(path);
+        std::string line;
+        while (std::getline(fin, line))
+        {
+            size_t split = line.find('=');
+            if (split == std::string::npos || split == 0)
+                continue;
+            config[line.substr(0, split)] = line.substr(split + 1);
+        }
+        fin.close();
+
+        for (auto& value : values)
+            config[value.first] = value.second;
+
+        std::ofstream fout(path);
+        if (!fout)
+            return false;
+        for (auto& option : config)
+            fout << option.first << '=' << option.second << '\n';
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    zsim::AutoTuneSettings settings;
+    std::string csvPath;
+    std::string configPath;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--type") && hasValue)
+            settings.simType = !std::strcmp(argv[++i], "smoke") ? zsim::SmokeSimType::ENHANCED_SMOKE : zsim::SmokeSimType::CURSOR_TRAIL;
+        else if (!std::strcmp(argv[i], "--width") && hasValue)
+            settings.pixelWidth = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--height") && hasValue)
+            settings.pixelHeight = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--rate") && hasValue)
+            settings.targetStepRate = (float)std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--csv") && hasValue)
+            csvPath = argv[++i];
+        else if (!std::strcmp(argv[i], "--config") && hasValue)
+            configPath = argv[++i];
+        else
+        {
+            std::fprintf(stderr, "Unknown argument '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (settings.pixelWidth <= 0 || settings.pixelHeight <= 0)
+    {
+        std::fprintf(stderr, "Invalid overlay size\n");
+        return 1;
+    }
+
+    zsim::AutoTuneResult result = zsim::RunAutoTune(settings, [](int done, int total) {
+        std::fprintf(stderr, "\r%d/%d", done, total);
+        return true;
+        });
+    std::fprintf(stderr, "\n");
+
+    std::string csv = result.ToCsv();
+    std::fputs(csv.c_str(), stdout);
+    if (!csvPath.empty())
+        std::ofstream(csvPath) << csv;
+
+    const zsim::AutoTuneSample* best = result.Best();
+    if (!best)
+        return 1;
+    std::printf("\nBudget %.2f ms, picked cell size %d, %d threads, %s, %s (%.2f ms)%s\n",
+        result.budgetMs,
+        best->cellSize,
+        best->threadCount,
+        zsim::SimdLevelName(best->simdLevel),
+        zsim::ProjectionModeName(best->projectionMode),
+        best->totalMs,
+        best->meetsTarget ? "" : ", nothing met the budget");
+
+    if (!configPath.empty())
+    {
+        std::string prefix = settings.simType == zsim::SmokeSimType::CURSOR_TRAIL ? "smokesim.cursortrail." : "smokesim.enhancedsmoke.";
+        std::map<std::string, std::string> values;
+        values[prefix + "cellSize"] = std::to_string(best->cellSize);
+        values[prefix + "threadCount"] = std::to_string(best->threadCount);
+        values[prefix + "simdLevel"] = std::to_string((int)best->simdLevel);
+        values[prefix + "projectionMode"] = std::to_string((int)best->projectionMode);
+        if (!UpdateConfig(configPath, values))
+        {
+            std::fprintf(stderr, "Couldn't write '%s'\n", configPath.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
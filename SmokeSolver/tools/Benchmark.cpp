@@ -0,0 +1,426 @@
+// Solver benchmark: times every stage of a step, the full step and the color conversion for each combination
+// of simulation type, overlay resolution, cell size, thread count and pressure solver.
+//
+// Usage: SmokeSolverBenchmark [--types trail,smoke] [--resolutions 1080p,1440p,4k,WxH] [--cells 2,3,4,5,6,8]
+//                             [--threads 1,2,4] [--projection gauss-seidel,multigrid,pcg,fft]
+//                             [--warmup N] [--steps N] [--format csv|json] [--output PATH]
+//
+// The workload is the scripted cursor sweep of the auto tuner. Stage times are means per step, over the
+// measured steps; the boundary stage is also counted in the stages that call it. Step, frame and color times
+// are medians. Every row has the same columns in the same order, so runs from different commits can be diffed
+
+#include "SmokeSolver/SmokeSolver.h"
+#include "SmokeSolver/ColorMapper.h"
+#include "SmokeSolver/AutoTuner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr int STAGE_COUNT = (int)zsim::SolverStage::COUNT;
+
+    struct Resolution
+    {
+        std::string name;
+        int width;
+        int height;
+    };
+
+    struct Settings
+    {
+        std::vector<zsim::SmokeSimType> simTypes = { zsim::SmokeSimType::CURSOR_TRAIL, zsim::SmokeSimType::ENHANCED_SMOKE };
+        std::vector<Resolution> resolutions = { { "1080p", 1920, 1080 }, { "1440p", 2560, 1440 }, { "4k", 3840, 2160 } };
+        std::vector<int> cellSizes = { 2, 3, 4, 5, 6, 8 };
+        // Empty means 1, 2, 4, ... up to the hardware thread count
+        std::vector<int> threadCounts;
+        std::vector<zsim::ProjectionMode> projectionModes = { zsim::ProjectionMode::GAUSS_SEIDEL };
+        float stepRate = 144.0f;
+        int warmupSteps = 20;
+        int measuredSteps = 60;
+        bool json = false;
+        std::string outputPath;
+    };
+
+    struct Case
+    {
+        zsim::SmokeSimType simType;
+        Resolution resolution;
+        int cellSize;
+        int threadCount;
+        zsim::ProjectionMode projectionMode;
+    };
+
+    struct Measurement
+    {
+        int gridWidth = 0;
+        int gridHeight = 0;
+        zsim::SimdLevel simdLevel = zsim::SimdLevel::SCALAR;
+        // Per step means
+        double stageMs[STAGE_COUNT] = {};
+        double stageCalls[STAGE_COUNT] = {};
+        // Medians
+        float stepMs = 0.0f;
+        float colorMs = 0.0f;
+        float frameMs = 0.0f;
+    };
+
+    float ElapsedMs(Clock::time_point start, Clock::time_point end)
+    {
+        return std::chrono::duration<float, std::milli>(end - start).count();
+    }
+
+    float Median(std::vector<float> values)
+    {
+        if (values.empty())
+            return 0.0f;
+        auto mid = values.begin() + values.size() / 2;
+        std::nth_element(values.begin(), mid, values.end());
+        return *mid;
+    }
+
+    Measurement Run(const Settings& settings, const Case& c)
+    {
+        Measurement result;
+        int width = std::max(c.resolution.width / c.cellSize, 1);
+        int height = std::max(c.resolution.height / c.cellSize, 1);
+        zsim::SmokeSolver solver(c.simType, width, height, c.cellSize, c.threadCount);
+        zsim::ProjectionSettings projection;
+        projection.mode = c.projectionMode;
+        solver.SetProjectionSettings(projection);
+        result.gridWidth = width;
+        result.gridHeight = height;
+        result.simdLevel = solver.GetSimdLevel();
+
+        zsim::ColorMapper colorMapper;
+        colorMapper.SetColor(0xFF888888);
+        std::vector<uint32_t> pixels((size_t)width * height);
+
+        // Same parameters and stroke as the auto tuner
+        bool trail = c.simType == zsim::SmokeSimType::CURSOR_TRAIL;
+        zsim::SmokeStepParams params;
+        params.temperatureDiffusion = trail ? 6.0f : 0.0f;
+        params.densityReductionRate = trail ? 0.15f : 0.02f;
+        params.temperatureReductionRate = trail ? 0.05f : 0.0f;
+        zsim::SmokeStroke stroke;
+        stroke.lineThickness = 10.0f;
+        stroke.fadeRange = 8.0f;
+        stroke.lineDensity = 0.7f;
+        stroke.windThickness = 10.0f;
+        stroke.windMultiplier = 0.2f;
+        stroke.cursorTemp = trail ? 0.4f : 0.0f;
+
+        const float dt = 1.0f / std::max(settings.stepRate, 1.0f);
+        std::vector<float> stepMs;
+        std::vector<float> colorMs;
+        std::vector<float> frameMs;
+        float prevX = 0.0f;
+        float prevY = 0.0f;
+        for (int step = 0; step < settings.warmupSteps + settings.measuredSteps; step++)
+        {
+            if (step == settings.warmupSteps)
+            {
+                solver.ResetStageTimes();
+                solver.SetStageTiming(true);
+            }
+
+            float t = step * dt;
+            float x = c.resolution.width * (0.5f + 0.4f * std::sin(t * 3.1f));
+            float y = c.resolution.height * (0.5f + 0.4f * std::sin(t * 4.3f + 0.5f));
+            if (step == 0)
+            {
+                prevX = x;
+                prevY = y;
+            }
+
+            auto start = Clock::now();
+            solver.ClearSources();
+            stroke.startX = prevX;
+            stroke.startY = prevY;
+            stroke.endX = x;
+            stroke.endY = y;
+            solver.AddStroke(stroke, dt);
+            solver.ApplySources(dt, dt, params);
+            auto stepStart = Clock::now();
+            solver.Step(dt, params);
+            auto stepEnd = Clock::now();
+            // The whole grid, as after a resize. The overlay only converts the damaged tiles
+            for (int row = 0; row < height; row++)
+            {
+                int index = solver.IndexAt(1, row + 1);
+                const float* temperature = solver.HasTemperature() ? solver.Temperature() + index : nullptr;
+                colorMapper.Map(solver.Density() + index, temperature, width, pixels.data() + (size_t)row * width);
+            }
+            auto end = Clock::now();
+
+            prevX = x;
+            prevY = y;
+            if (step < settings.warmupSteps)
+                continue;
+            stepMs.push_back(ElapsedMs(stepStart, stepEnd));
+            colorMs.push_back(ElapsedMs(stepEnd, end));
+            frameMs.push_back(ElapsedMs(start, end));
+        }
+
+        const auto& stageTimes = solver.GetStageTimes();
+        for (int stage = 0; stage < STAGE_COUNT; stage++)
+        {
+            result.stageMs[stage] = stageTimes[stage].milliseconds / settings.measuredSteps;
+            result.stageCalls[stage] = double(stageTimes[stage].calls) / settings.measuredSteps;
+        }
+        result.stepMs = Median(stepMs);
+        result.colorMs = Median(colorMs);
+        result.frameMs = Median(frameMs);
+        return result;
+    }
+
+    const char* SimTypeName(zsim::SmokeSimType simType)
+    {
+        return simType == zsim::SmokeSimType::CURSOR_TRAIL ? "trail" : "smoke";
+    }
+
+    std::vector<std::string> Split(const char* text)
+    {
+        std::vector<std::string> items;
+        std::string item;
+        for (const char* c = text; ; c++)
+        {
+            if (*c == ',' || *c == '\0')
+            {
+                if (!item.empty())
+                    items.push_back(item);
+                item.clear();
+                if (*c == '\0')
+                    break;
+            }
+            else
+            {
+                item += *c;
+            }
+        }
+        return items;
+    }
+
+    bool ParseResolution(const std::string& text, Resolution& resolution)
+    {
+        if (text == "1080p")
+            resolution = { text, 1920, 1080 };
+        else if (text == "1440p")
+            resolution = { text, 2560, 1440 };
+        else if (text == "4k")
+            resolution = { text, 3840, 2160 };
+        else if (std::sscanf(text.c_str(), "%dx%d", &resolution.width, &resolution.height) == 2)
+            resolution.name = text;
+        else
+            return false;
+        return resolution.width > 0 && resolution.height > 0;
+    }
+
+    bool ParseProjectionMode(const std::string& text, zsim::ProjectionMode& mode)
+    {
+        for (zsim::ProjectionMode candidate : { zsim::ProjectionMode::GAUSS_SEIDEL, zsim::ProjectionMode::MULTIGRID, zsim::ProjectionMode::PCG, zsim::ProjectionMode::FFT })
+        {
+            if (text == zsim::ProjectionModeName(candidate))
+            {
+                mode = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void WriteCsv(std::FILE* out, const std::vector<Case>& cases, const std::vector<Measurement>& measurements)
+    {
+        std::fprintf(out, "type,resolution,pixelWidth,pixelHeight,cellSize,gridWidth,gridHeight,threadCount,simdLevel,projectionMode");
+        for (int stage = 0; stage < STAGE_COUNT; stage++)
+            std::fprintf(out, ",%sMs", zsim::SolverStageName((zsim::SolverStage)stage));
+        std::fprintf(out, ",stepMs,colorMs,frameMs\n");
+
+        for (size_t i = 0; i < cases.size(); i++)
+        {
+            const Case& c = cases[i];
+            const Measurement& m = measurements[i];
+            std::fprintf(out, "%s,%s,%d,%d,%d,%d,%d,%d,%s,%s",
+                SimTypeName(c.simType),
+                c.resolution.name.c_str(),
+                c.resolution.width,
+                c.resolution.height,
+                c.cellSize,
+                m.gridWidth,
+                m.gridHeight,
+                c.threadCount,
+                zsim::SimdLevelName(m.simdLevel),
+                zsim::ProjectionModeName(c.projectionMode));
+            for (int stage = 0; stage < STAGE_COUNT; stage++)
+                std::fprintf(out, ",%.4f", m.stageMs[stage]);
+            std::fprintf(out, ",%.4f,%.4f,%.4f\n", m.stepMs, m.colorMs, m.frameMs);
+        }
+    }
+
+    void WriteJson(std::FILE* out, const Settings& settings, const std::vector<Case>& cases, const std::vector<Measurement>& measurements)
+    {
+        std::fprintf(out, "{\n");
+        std::fprintf(out, "  \"hardwareThreads\": %u,\n", std::thread::hardware_concurrency());
+        std::fprintf(out, "  \"stepRate\": %g,\n", settings.stepRate);
+        std::fprintf(out, "  \"warmupSteps\": %d,\n", settings.warmupSteps);
+        std::fprintf(out, "  \"measuredSteps\": %d,\n", settings.measuredSteps);
+        std::fprintf(out, "  \"runs\": [");
+        for (size_t i = 0; i < cases.size(); i++)
+        {
+            const Case& c = cases[i];
+            const Measurement& m = measurements[i];
+            std::fprintf(out, "%s\n    {\n", i == 0 ? "" : ",");
+            std::fprintf(out, "      \"type\": \"%s\",\n", SimTypeName(c.simType));
+            std::fprintf(out, "      \"resolution\": \"%s\",\n", c.resolution.name.c_str());
+            std::fprintf(out, "      \"pixelWidth\": %d,\n", c.resolution.width);
+            std::fprintf(out, "      \"pixelHeight\": %d,\n", c.resolution.height);
+            std::fprintf(out, "      \"cellSize\": %d,\n", c.cellSize);
+            std::fprintf(out, "      \"gridWidth\": %d,\n", m.gridWidth);
+            std::fprintf(out, "      \"gridHeight\": %d,\n", m.gridHeight);
+            std::fprintf(out, "      \"threadCount\": %d,\n", c.threadCount);
+            std::fprintf(out, "      \"simdLevel\": \"%s\",\n", zsim::SimdLevelName(m.simdLevel));
+            std::fprintf(out, "      \"projectionMode\": \"%s\",\n", zsim::ProjectionModeName(c.projectionMode));
+            std::fprintf(out, "      \"stages\": {");
+            for (int stage = 0; stage < STAGE_COUNT; stage++)
+            {
+                std::fprintf(out, "%s\n        \"%s\": { \"ms\": %.4f, \"calls\": %.2f }",
+                    stage == 0 ? "" : ",",
+                    zsim::SolverStageName((zsim::SolverStage)stage),
+                    m.stageMs[stage],
+                    m.stageCalls[stage]);
+            }
+            std::fprintf(out, "\n      },\n");
+            std::fprintf(out, "      \"stepMs\": %.4f,\n", m.stepMs);
+            std::fprintf(out, "      \"colorMs\": %.4f,\n", m.colorMs);
+            std::fprintf(out, "      \"frameMs\": %.4f\n", m.frameMs);
+            std::fprintf(out, "    }");
+        }
+        std::fprintf(out, "\n  ]\n}\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Settings settings;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--types") && hasValue)
+        {
+            settings.simTypes.clear();
+            for (const std::string& type : Split(argv[++i]))
+                settings.simTypes.push_back(type == "smoke" ? zsim::SmokeSimType::ENHANCED_SMOKE : zsim::SmokeSimType::CURSOR_TRAIL);
+        }
+        else if (!std::strcmp(argv[i], "--resolutions") && hasValue)
+        {
+            settings.resolutions.clear();
+            for (const std::string& text : Split(argv[++i]))
+            {
+                Resolution resolution;
+                if (!ParseResolution(text, resolution))
+                {
+                    std::fprintf(stderr, "Invalid resolution '%s'\n", text.c_str());
+                    return 1;
+                }
+                settings.resolutions.push_back(resolution);
+            }
+        }
+        else if (!std::strcmp(argv[i], "--cells") && hasValue)
+        {
+            settings.cellSizes.clear();
+            for (const std::string& text : Split(argv[++i]))
+                if (std::atoi(text.c_str()) > 0)
+                    settings.cellSizes.push_back(std::atoi(text.c_str()));
+        }
+        else if (!std::strcmp(argv[i], "--threads") && hasValue)
+        {
+            settings.threadCounts.clear();
+            for (const std::string& text : Split(argv[++i]))
+                if (std::atoi(text.c_str()) > 0)
+                    settings.threadCounts.push_back(std::atoi(text.c_str()));
+        }
+        else if (!std::strcmp(argv[i], "--projection") && hasValue)
+        {
+            settings.projectionModes.clear();
+            for (const std::string& text : Split(argv[++i]))
+            {
+                zsim::ProjectionMode mode;
+                if (!ParseProjectionMode(text, mode))
+                {
+                    std::fprintf(stderr, "Invalid projection mode '%s'\n", text.c_str());
+                    return 1;
+                }
+                settings.projectionModes.push_back(mode);
+            }
+        }
+        else if (!std::strcmp(argv[i], "--rate") && hasValue)
+            settings.stepRate = (float)std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--warmup") && hasValue)
+            settings.warmupSteps = std::max(std::atoi(argv[++i]), 0);
+        else if (!std::strcmp(argv[i], "--steps") && hasValue)
+            settings.measuredSteps = std::max(std::atoi(argv[++i]), 1);
+        else if (!std::strcmp(argv[i], "--format") && hasValue)
+            settings.json = !std::strcmp(argv[++i], "json");
+        else if (!std::strcmp(argv[i], "--output") && hasValue)
+            settings.outputPath = argv[++i];
+        else
+        {
+            std::fprintf(stderr, "Unknown argument '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (settings.threadCounts.empty())
+    {
+        int hardwareThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+        for (int threads = 1; threads < hardwareThreads; threads *= 2)
+            settings.threadCounts.push_back(threads);
+        settings.threadCounts.push_back(hardwareThreads);
+    }
+    if (settings.simTypes.empty() || settings.resolutions.empty() || settings.cellSizes.empty() || settings.projectionModes.empty())
+    {
+        std::fprintf(stderr, "Nothing to measure\n");
+        return 1;
+    }
+
+    std::vector<Case> cases;
+    for (zsim::SmokeSimType simType : settings.simTypes)
+        for (const Resolution& resolution : settings.resolutions)
+            for (int cellSize : settings.cellSizes)
+                for (int threadCount : settings.threadCounts)
+                    for (zsim::ProjectionMode projectionMode : settings.projectionModes)
+                        cases.push_back({ simType, resolution, cellSize, threadCount, projectionMode });
+
+    std::vector<Measurement> measurements;
+    for (const Case& c : cases)
+    {
+        measurements.push_back(Run(settings, c));
+        std::fprintf(stderr, "\r%d/%d", (int)measurements.size(), (int)cases.size());
+    }
+    std::fprintf(stderr, "\n");
+
+    std::FILE* out = stdout;
+    if (!settings.outputPath.empty())
+    {
+        out = std::fopen(settings.outputPath.c_str(), "w");
+        if (!out)
+        {
+            std::fprintf(stderr, "Couldn't write '%s'\n", settings.outputPath.c_str());
+            return 1;
+        }
+    }
+    if (settings.json)
+        WriteJson(out, settings, cases, measurements);
+    else
+        WriteCsv(out, cases, measurements);
+    if (out != stdout)
+        std::fclose(out);
+    return 0;
+}
@@ -0,0 +1,420 @@
+// Headless comparison of the field layouts: the padded, cache line aligned Grid2D the solver uses against the
+// plain (W + 2) * (H + 2) array it replaced, on the red-black relaxation sweep and the advection kernel.
+//
+// Usage: SmokeSolverLayoutCompare [--grids WxH,...] [--sweeps N] [--simd scalar|SSE4.1|AVX2]
+//
+// Grid sizes are in cells. The defaults are 1080p at cell sizes 2, 3 and 4, plus two grids whose unpadded row
+// length is a multiple of 4 KiB, where vertically adjacent cells map to the same L1 sets. Kernels run on one
+// thread so the counts are per core. Times are medians per sweep. On Linux the L1 data cache read misses and
+// last level cache misses of the sweeps are counted with perf_event_open and reported per 1000 cells; they are
+// n/a where the counters can't be opened (other systems, most VMs, or perf_event_paranoid above 2).
+// Both layouts have to produce the same values, or the comparison fails
+
+#include "SmokeSolver/Grid2D.h"
+#include "SmokeSolver/AdvectKernels.h"
+#include "SmokeSolver/AutoTuner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct GridSize
+    {
+        int width;
+        int height;
+    };
+
+    struct Settings
+    {
+        std::vector<GridSize> grids = { { 960, 540 }, { 640, 360 }, { 480, 270 }, { 1022, 576 }, { 2046, 1152 } };
+        int sweeps = 40;
+        zsim::SimdLevel simdLevel = zsim::DetectSimdLevel();
+    };
+
+    // Hardware cache miss counters of the calling thread. Counters that can't be opened stay unavailable
+    class CacheCounters
+    {
+    public:
+        CacheCounters()
+        {
+#ifdef __linux__
+            _l1dFd = _Open(PERF_TYPE_HW_CACHE,
+                PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+            _llcFd = _Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+#endif
+        }
+        ~CacheCounters()
+        {
+#ifdef __linux__
+            for (int fd : { _l1dFd, _llcFd })
+                if (fd >= 0)
+                    close(fd);
+#endif
+        }
+        CacheCounters(const CacheCounters&) = delete;
+        CacheCounters& operator=(const CacheCounters&) = delete;
+
+        bool L1dAvailable() const { return _l1dFd >= 0; }
+        bool LlcAvailable() const { return _llcFd >= 0; }
+
+        void Start()
+        {
+#ifdef __linux__
+            for (int fd : { _l1dFd, _llcFd })
+            {
+                if (fd < 0)
+                    continue;
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+        // Misses since Start(), -1 for unavailable counters
+        void Stop(int64_t& l1dMisses, int64_t& llcMisses)
+        {
+            l1dMisses = _Read(_l1dFd);
+            llcMisses = _Read(_llcFd);
+        }
+
+    private:
+        int _l1dFd = -1;
+        int _llcFd = -1;
+
+#ifdef __linux__
+        static int _Open(uint32_t type, uint64_t config)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.disabled = 1;
+            // User space only, which is allowed up to perf_event_paranoid 2
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+#endif
+
+        static int64_t _Read(int fd)
+        {
+#ifdef __linux__
+            if (fd < 0)
+                return -1;
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t count = 0;
+            if (read(fd, &count, sizeof(count)) != sizeof(count))
+                return -1;
+            return (int64_t)count;
+#else
+            (void)fd;
+            return -1;
+#endif
+        }
+    };
+
+    // The layout before Grid2D: rows of W + 2 cells back to back, with no alignment beyond the allocator's
+    class UnpaddedField
+    {
+    public:
+        UnpaddedField(int width, int height)
+            : _cells((size_t)(width + 2) * (height + 2)), _pitch(width + 2) {}
+
+        int Pitch() const { return _pitch; }
+        float* Data() { return _cells.data(); }
+
+    private:
+        std::vector<float> _cells;
+        int _pitch;
+    };
+
+    class PaddedField
+    {
+    public:
+        PaddedField(int width, int height)
+            : _grid(width, height) {}
+
+        int Pitch() const { return _grid.Pitch(); }
+        float* Data() { return _grid.Data(); }
+
+    private:
+        zsim::Grid2D<float> _grid;
+    };
+
+    struct Result
+    {
+        int pitch = 0;
+        float ms = 0.0f;
+        // Per 1000 cells and sweep, negative when unavailable
+        double l1dMisses = -1.0;
+        double llcMisses = -1.0;
+        double checksum = 0.0;
+    };
+
+    struct Row
+    {
+        const char* kernel;
+        GridSize grid;
+        Result unpadded;
+        Result padded;
+    };
+
+    float Median(std::vector<float> values)
+    {
+        if (values.empty())
+            return 0.0f;
+        auto mid = values.begin() + values.size() / 2;
+        std::nth_element(values.begin(), mid, values.end());
+        return *mid;
+    }
+
+    // Smooth, non-trivial contents, the same for every layout
+    template <typename Field>
+    void FillPattern(Field& field, int width, int height, float phase)
+    {
+        float* data = field.Data();
+        for (int j = 0; j < height + 2; j++)
+            for (int i = 0; i < width + 2; i++)
+                data[j * field.Pitch() + i] = 0.5f + 0.5f * std::sin(i * 0.031f + phase) * std::cos(j * 0.017f - phase);
+    }
+
+    template <typename Field>
+    double Checksum(Field& field, int width, int height)
+    {
+        const float* data = field.Data();
+        double sum = 0.0;
+        for (int j = 1; j <= height; j++)
+            for (int i = 1; i <= width; i++)
+                sum += data[j * field.Pitch() + i] * (1.0 + (i + j) % 7);
+        return sum;
+    }
+
+    // Runs sweep() 'sweeps' times after one untimed sweep
+    template <typename F>
+    void Measure(const Settings& settings, int cells, CacheCounters& counters, Result& result, F&& sweep)
+    {
+        sweep();
+        std::vector<float> sweepMs;
+        int64_t l1dMisses = 0;
+        int64_t llcMisses = 0;
+        for (int k = 0; k < settings.sweeps; k++)
+        {
+            int64_t l1d, llc;
+            counters.Start();
+            auto start = Clock::now();
+            sweep();
+            auto end = Clock::now();
+            counters.Stop(l1d, llc);
+            sweepMs.push_back(std::chrono::duration<float, std::milli>(end - start).count());
+            l1dMisses = l1d < 0 || l1dMisses < 0 ? -1 : l1dMisses + l1d;
+            llcMisses = llc < 0 || llcMisses < 0 ? -1 : llcMisses + llc;
+        }
+        double perKiloCell = 1000.0 / ((double)cells * settings.sweeps);
+        result.ms = Median(sweepMs);
+        result.l1dMisses = l1dMisses < 0 ? -1.0 : l1dMisses * perKiloCell;
+        result.llcMisses = llcMisses < 0 ? -1.0 : llcMisses * perKiloCell;
+    }
+
+    // One red-black Gauss-Seidel iteration of the solver's diffusion and pressure relaxation
+    template <typename Field>
+    Result RunRelax(const Settings& settings, GridSize grid, CacheCounters& counters)
+    {
+        const int W = grid.width;
+        const int H = grid.height;
+        Field x(W, H);
+        Field x0(W, H);
+        FillPattern(x, W, H, 0.0f);
+        FillPattern(x0, W, H, 1.0f);
+        const int pitch = x.Pitch();
+        const float a = 0.25f;
+        const float c = 1.0f + 4.0f * a;
+
+        Result result;
+        result.pitch = pitch;
+        Measure(settings, W * H, counters, result, [&]() {
+            float* xd = x.Data();
+            const float* x0d = x0.Data();
+            for (int color = 0; color < 2; color++)
+            {
+                for (int j = 1; j <= H; j++)
+                {
+                    for (int i = 1 + ((1 + j + color) & 1); i <= W; i += 2)
+                    {
+                        int index = j * pitch + i;
+                        xd[index] = (x0d[index] + a * (xd[index - 1] + xd[index + 1] + xd[index - pitch] + xd[index + pitch])) / c;
+                    }
+                }
+            }
+            });
+        result.checksum = Checksum(x, W, H);
+        return result;
+    }
+
+    // Semi-Lagrangian advection of one field through a swirl, with the solver's row kernel
+    template <typename Field>
+    Result RunAdvect(const Settings& settings, GridSize grid, CacheCounters& counters)
+    {
+        const int W = grid.width;
+        const int H = grid.height;
+        Field u(W, H);
+        Field v(W, H);
+        Field d0(W, H);
+        Field d(W, H);
+        for (int j = 0; j < H + 2; j++)
+        {
+            for (int i = 0; i < W + 2; i++)
+            {
+                // Up to a few cells per step, like a fast cursor stroke
+                float dx = (i - W * 0.5f) / W;
+                float dy = (j - H * 0.5f) / H;
+                u.Data()[j * u.Pitch() + i] = -dy * 6.0f;
+                v.Data()[j * v.Pitch() + i] = dx * 6.0f;
+            }
+        }
+        FillPattern(d0, W, H, 0.5f);
+        const zsim::AdvectRowFunc advectRow = zsim::GetAdvectRowKernel(settings.simdLevel);
+        const int pitch = d.Pitch();
+        const float dt0 = 1.0f;
+
+        Result result;
+        result.pitch = pitch;
+        Measure(settings, W * H, counters, result, [&]() {
+            for (int j = 1; j <= H; j++)
+                advectRow(W, H, pitch, j, 1, W + 1, dt0, u.Data(), v.Data(), d0.Data(), d.Data());
+            });
+        result.checksum = Checksum(d, W, H);
+        return result;
+    }
+
+    void PrintCount(double value)
+    {
+        if (value < 0.0)
+            std::printf(",n/a");
+        else
+            std::printf(",%.2f", value);
+    }
+
+    bool ParseGrids(const char* text, std::vector<GridSize>& grids)
+    {
+        grids.clear();
+        for (const char* c = text; *c; )
+        {
+            GridSize grid;
+            if (std::sscanf(c, "%dx%d", &grid.width, &grid.height) != 2 || grid.width <= 0 || grid.height <= 0)
+                return false;
+            grids.push_back(grid);
+            const char* comma = std::strchr(c, ',');
+            if (!comma)
+                break;
+            c = comma + 1;
+        }
+        return !grids.empty();
+    }
+
+    bool ParseSimdLevel(const char* text, zsim::SimdLevel& level)
+    {
+        for (zsim::SimdLevel candidate : { zsim::SimdLevel::SCALAR, zsim::SimdLevel::SSE41, zsim::SimdLevel::AVX2 })
+        {
+            if (!std::strcmp(text, zsim::SimdLevelName(candidate)))
+            {
+                level = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Settings settings;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--grids") && hasValue)
+        {
+            if (!ParseGrids(argv[++i], settings.grids))
+            {
+                std::fprintf(stderr, "Invalid grid sizes '%s'\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!std::strcmp(argv[i], "--sweeps") && hasValue)
+            settings.sweeps = std::max(std::atoi(argv[++i]), 1);
+        else if (!std::strcmp(argv[i], "--simd") && hasValue)
+        {
+            zsim::SimdLevel level;
+            if (!ParseSimdLevel(argv[++i], level) || level > zsim::DetectSimdLevel())
+            {
+                std::fprintf(stderr, "Unsupported SIMD level '%s'\n", argv[i]);
+                return 1;
+            }
+            settings.simdLevel = level;
+        }
+        else
+        {
+            std::fprintf(stderr, "Unknown argument '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+
+    CacheCounters counters;
+    std::vector<Row> rows;
+    for (GridSize grid : settings.grids)
+    {
+        rows.push_back({ "relax", grid, RunRelax<UnpaddedField>(settings, grid, counters), RunRelax<PaddedField>(settings, grid, counters) });
+        rows.push_back({ "advect", grid, RunAdvect<UnpaddedField>(settings, grid, counters), RunAdvect<PaddedField>(settings, grid, counters) });
+        std::fprintf(stderr, "\r%d/%d", (int)rows.size(), (int)settings.grids.size() * 2);
+    }
+    std::fprintf(stderr, "\n");
+
+    std::printf("simd %s, %d sweeps, L1D read miss counter %s, LLC miss counter %s\n",
+        zsim::SimdLevelName(settings.simdLevel),
+        settings.sweeps,
+        counters.L1dAvailable() ? "available" : "n/a",
+        counters.LlcAvailable() ? "available" : "n/a");
+    std::printf("kernel,gridWidth,gridHeight,unpaddedPitch,paddedPitch,unpaddedMs,paddedMs,"
+        "unpaddedL1dMissesPerKCell,paddedL1dMissesPerKCell,unpaddedLlcMissesPerKCell,paddedLlcMissesPerKCell\n");
+    bool matching = true;
+    for (const Row& row : rows)
+    {
+        std::printf("%s,%d,%d,%d,%d,%.3f,%.3f",
+            row.kernel,
+            row.grid.width,
+            row.grid.height,
+            row.unpadded.pitch,
+            row.padded.pitch,
+            row.unpadded.ms,
+            row.padded.ms);
+        PrintCount(row.unpadded.l1dMisses);
+        PrintCount(row.padded.l1dMisses);
+        PrintCount(row.unpadded.llcMisses);
+        PrintCount(row.padded.llcMisses);
+        std::printf("\n");
+        matching = matching && row.unpadded.checksum == row.padded.checksum;
+    }
+
+    if (!matching)
+    {
+        std::fprintf(stderr, "The layouts produced different values\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,418 @@
+// Replays recorded input traces or osu! replays through the solver, headless and as fast as the solver allows.
+//
+// Usage: SmokeSolverReplay TRACE... [--cell N] [--threads N] [--projection gauss-seidel|multigrid|pcg|fft]
+//                                  [--rate STEPS_PER_SECOND | --recorded-dt] [--key KEYCODE] [--no-batching]
+//                                  [--speed N] [--type trail|smoke] [--size WxH] [--smoke-from smoke|clicks]
+//                                  [--trace PATH] [--check-allocations]
+//
+// Traces are recorded by the overlay (see the smokesim.recordInputPath option). Steps are taken at a fixed rate
+// by default, or at the recorded step times with --recorded-dt. Stroke and slowdown handling follow the
+// overlay with its default parameters. Prints the step timings and a hash of the final fields, which only
+// changes if the simulation output changes.
+//
+// .osr files are converted for a --size overlay (1920x1080 by default) of --type (trail by default). Smoke is
+// added while the osu! smoke key is held, or any of the click keys with --smoke-from clicks.
+// With --speed the replay is paced to N times real time and frames that finish after their deadline are
+// counted as late, so e.g. --speed 8 checks that the solver keeps up with 8x real time.
+// --trace writes the recorded trace zones as Chrome trace JSON, which needs a build with ZSIM_TRACE_ZONES.
+// Every thread keeps its latest 65536 zones, and only the threads of the last few solvers are kept.
+// --check-allocations also runs the color pass of the overlay over the damaged tiles and fails if any thread
+// allocates after the first 60 frames. It needs a build with ZSIM_COUNT_ALLOCATIONS
+
+#include "SmokeSolver/SmokeSolver.h"
+#include "SmokeSolver/AllocationCounter.h"
+#include "SmokeSolver/ColorMapper.h"
+#include "SmokeSolver/InputTrace.h"
+#include "SmokeSolver/OsuReplay.h"
+#include "SmokeSolver/StepScheduler.h"
+#include "SmokeSolver/AutoTuner.h"
+#include "SmokeSolver/TraceZones.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Settings
+    {
+        std::vector<std::string> tracePaths;
+        int cellSize = 4;
+        int threadCount = 4;
+        zsim::ProjectionMode projectionMode = zsim::ProjectionMode::GAUSS_SEIDEL;
+        float stepRate = 144.0f;
+        bool recordedDt = false;
+        // Enhanced smoke key, 'C' by default like in the overlay
+        int smokeKey = 'C';
+        bool batching = true;
+        // 0 runs unpaced
+        float speed = 0.0f;
+        // .osr conversion
+        zsim::SmokeSimType osuSimType = zsim::SmokeSimType::CURSOR_TRAIL;
+        int osuWidth = 1920;
+        int osuHeight = 1080;
+        int osuKeyMask = zsim::OsuReplay::SMOKE;
+        std::string tracePath;
+        bool checkAllocations = false;
+    };
+
+    // Frames allowed to allocate with --check-allocations, while buffers grow to their working size
+    constexpr size_t ALLOCATION_WARMUP_FRAMES = 60;
+
+    float Percentile(std::vector<float> values, float fraction)
+    {
+        if (values.empty())
+            return 0.0f;
+        auto nth = values.begin() + std::min(size_t(values.size() * fraction), values.size() - 1);
+        std::nth_element(values.begin(), nth, values.end());
+        return *nth;
+    }
+
+    uint64_t HashFields(const zsim::SmokeSolver& solver)
+    {
+        // FNV-1a over the bits of the interior density and temperature
+        uint64_t hash = 1469598103934665603ull;
+        auto add = [&](const float* field) {
+            for (int y = 1; y <= solver.Height(); y++)
+            {
+                for (int x = 1; x <= solver.Width(); x++)
+                {
+                    uint32_t bits;
+                    std::memcpy(&bits, field + solver.IndexAt(x, y), sizeof(bits));
+                    hash = (hash ^ bits) * 1099511628211ull;
+                }
+            }
+        };
+        add(solver.Density());
+        if (solver.HasTemperature())
+            add(solver.Temperature());
+        return hash;
+    }
+
+    // Plays one trace, returns false if it can't be played or allocates in steady state with --check-allocations
+    bool Run(const Settings& settings, const std::string& path)
+    {
+        zsim::InputTrace trace;
+        if (!zsim::LoadInputTrace(path, settings.osuSimType, settings.osuWidth, settings.osuHeight, settings.osuKeyMask, settings.smokeKey, trace))
+        {
+            std::fprintf(stderr, "Couldn't read a trace from '%s'\n", path.c_str());
+            return false;
+        }
+        if (trace.width <= 0 || trace.height <= 0)
+        {
+            std::fprintf(stderr, "'%s' has no overlay size\n", path.c_str());
+            return false;
+        }
+
+        // Step times, either every recorded step or a fixed rate over the length of the trace.
+        // Converted osu! replays have no recorded steps
+        std::vector<double> stepTimes;
+        if (settings.recordedDt)
+        {
+            for (const zsim::InputEvent& event : trace.events)
+                if (event.kind == zsim::InputEvent::Kind::FRAME)
+                    stepTimes.push_back(event.timeUs / 1e6);
+        }
+        if (stepTimes.empty())
+        {
+            int stepCount = int(trace.Duration() * settings.stepRate) + 1;
+            for (int step = 0; step < stepCount; step++)
+                stepTimes.push_back(step / (double)settings.stepRate);
+        }
+
+        const bool trail = trace.simType == zsim::SmokeSimType::CURSOR_TRAIL;
+        int width = std::max(trace.width / settings.cellSize, 1);
+        int height = std::max(trace.height / settings.cellSize, 1);
+        zsim::SmokeSolver solver(trace.simType, width, height, settings.cellSize, settings.threadCount);
+        zsim::ProjectionSettings projection;
+        projection.mode = settings.projectionMode;
+        solver.SetProjectionSettings(projection);
+        zsim::StepSchedulerSettings schedulerSettings;
+        schedulerSettings.enabled = settings.batching;
+        zsim::StepScheduler scheduler(schedulerSettings);
+        zsim::InputReplay input(trace);
+
+        // Overlay defaults
+        zsim::SmokeStepParams params;
+        params.temperatureDiffusion = trail ? 6.0f : 0.0f;
+        params.densityReductionRate = trail ? 0.15f : 0.02f;
+        params.temperatureReductionRate = trail ? 0.05f : 0.0f;
+        zsim::SmokeStroke stroke;
+        stroke.lineThickness = trail ? 10.0f : 14.0f;
+        stroke.fadeRange = trail ? 8.0f : 6.0f;
+        stroke.lineDensity = trail ? 0.7f : 1.0f;
+        stroke.windThickness = trail ? 10.0f : 14.0f;
+        stroke.windMultiplier = 0.2f;
+        stroke.cursorTemp = trail ? 0.4f : 0.0f;
+        const double slowdownPersistence = 0.25;
+
+        // Reserved up front so recording the timings doesn't count as a steady state allocation
+        std::vector<float> frameMs;
+        frameMs.reserve(stepTimes.size());
+        int solverSteps = 0;
+        int prevX = 0;
+        int prevY = 0;
+        bool addingSmoke = false;
+        double smokeEndTime = -1e9;
+        float cellsPerSecond = -1.0f;
+        int lateFrames = 0;
+
+        zsim::ColorMapper colorMapper;
+        colorMapper.SetColor(0xFF888888);
+        std::vector<uint32_t> pixels;
+        std::vector<zsim::RegionRect> damageRects;
+        if (settings.checkAllocations)
+            pixels.resize((size_t)width * height);
+        int64_t allocationsBefore = 0;
+
+        auto start = Clock::now();
+        for (size_t step = 0; step < stepTimes.size(); step++)
+        {
+            if (step == ALLOCATION_WARMUP_FRAMES)
+                allocationsBefore = zsim::ProcessAllocationCount();
+            double now = stepTimes[step];
+            float dt = step == 0 ? 1.0f / settings.stepRate : float(now - stepTimes[step - 1]);
+            dt = std::min(dt, 1.0f / 30.0f);
+
+            // A paced frame starts at its time and has to finish before the next one starts
+            Clock::time_point deadline;
+            if (settings.speed > 0.0f)
+            {
+                auto offset = [&](double seconds) {
+                    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds / settings.speed));
+                };
+                std::this_thread::sleep_until(start + offset(now - stepTimes[0]));
+                deadline = start + offset((step + 1 < stepTimes.size() ? stepTimes[step + 1] : now + dt) - stepTimes[0]);
+            }
+
+            ZSIM_TRACE_ZONE("frame");
+            auto frameStart = Clock::now();
+            input.SetTime(now);
+            int x, y;
+            input.GetCursor(x, y);
+            if (step == 0)
+            {
+                prevX = x;
+                prevY = y;
+            }
+
+            bool addSmoke = true;
+            bool slowedDown = false;
+            if (!trail)
+            {
+                addSmoke = input.IsKeyDown(settings.smokeKey);
+                if (addingSmoke && !addSmoke)
+                    smokeEndTime = now;
+                addingSmoke = addSmoke;
+                slowedDown = addingSmoke || now < smokeEndTime + slowdownPersistence;
+            }
+
+            solver.ClearSources();
+            bool inside = prevX >= 0 && prevX < trace.width && prevY >= 0 && prevY < trace.height &&
+                x >= 0 && x < trace.width && y >= 0 && y < trace.height;
+            if (inside)
+            {
+                stroke.startX = (float)prevX;
+                stroke.startY = (float)prevY;
+                stroke.endX = (float)x;
+                stroke.endY = (float)y;
+                stroke.addSmoke = addSmoke;
+                stroke.addWind = !slowedDown;
+                solver.AddStroke(stroke, dt);
+            }
+            prevX = x;
+            prevY = y;
+
+            float dtFinal = slowedDown ? dt / 16.0f : dt;
+            solver.ApplySources(dt, dtFinal, params);
+            if (slowedDown && cellsPerSecond < 0.0f)
+                cellsPerSecond = solver.MaxSpeed() * solver.Height();
+            float stepDt = scheduler.Advance(dtFinal, slowedDown, cellsPerSecond);
+            if (stepDt > 0.0f)
+            {
+                solver.Step(stepDt, params);
+                solverSteps++;
+                cellsPerSecond = -1.0f;
+            }
+            auto frameEnd = Clock::now();
+            frameMs.push_back(std::chrono::duration<float, std::milli>(frameEnd - frameStart).count());
+            if (settings.speed > 0.0f && frameEnd > deadline)
+                lateFrames++;
+
+            if (settings.checkAllocations)
+            {
+                // The color pass of the overlay, outside the frame time
+                const zsim::BlockRegion& damage = stepDt > 0.0f ? solver.LastStepDamage() : solver.LastSourceDamage();
+                damage.GetRects(damageRects);
+                int tileSize = solver.GetTileSettings().tileSize;
+                for (const zsim::RegionRect& rect : damageRects)
+                {
+                    zsim::RegionRect cells = zsim::BlockRegion::ToCells(rect, tileSize, width, height);
+                    for (int row = cells.top; row < cells.bottom; row++)
+                    {
+                        int index = solver.IndexAt(cells.left + 1, row + 1);
+                        const float* temperature = solver.HasTemperature() ? solver.Temperature() + index : nullptr;
+                        colorMapper.Map(solver.Density() + index, temperature, cells.Width(), pixels.data() + (size_t)row * width + cells.left);
+                    }
+                }
+            }
+        }
+        float totalSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+        int64_t steadyAllocations = stepTimes.size() > ALLOCATION_WARMUP_FRAMES ? zsim::ProcessAllocationCount() - allocationsBefore : 0;
+
+        std::printf("%s\n", path.c_str());
+        std::printf("trace: %s, %dx%d, %.2f s, %d events\n",
+            trail ? "trail" : "smoke",
+            trace.width,
+            trace.height,
+            trace.Duration(),
+            (int)trace.events.size());
+        std::printf("frames: %d, solver steps: %d, %.2f s (%.1fx real time)\n",
+            (int)frameMs.size(),
+            solverSteps,
+            totalSeconds,
+            totalSeconds > 0.0f ? trace.Duration() / totalSeconds : 0.0);
+        std::printf("frame ms: median %.3f, p95 %.3f, max %.3f\n",
+            Percentile(frameMs, 0.5f),
+            Percentile(frameMs, 0.95f),
+            Percentile(frameMs, 1.0f));
+        if (settings.speed > 0.0f)
+            std::printf("paced at %.1fx: %d late frames (%.2f%%)\n", settings.speed, lateFrames, frameMs.empty() ? 0.0 : 100.0 * lateFrames / frameMs.size());
+        std::printf("hash: %016llx\n", (unsigned long long)HashFields(solver));
+        if (settings.checkAllocations)
+        {
+            std::printf("steady state allocations: %lld (after %d warmup frames)\n", (long long)steadyAllocations, (int)ALLOCATION_WARMUP_FRAMES);
+            if (steadyAllocations > 0)
+            {
+                std::fprintf(stderr, "'%s' allocated in steady state\n", path.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Settings settings;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--cell") && hasValue)
+            settings.cellSize = std::max(std::atoi(argv[++i]), 1);
+        else if (!std::strcmp(argv[i], "--threads") && hasValue)
+            settings.threadCount = std::max(std::atoi(argv[++i]), 0);
+        else if (!std::strcmp(argv[i], "--projection") && hasValue)
+        {
+            const char* name = argv[++i];
+            bool found = false;
+            for (zsim::ProjectionMode mode : { zsim::ProjectionMode::GAUSS_SEIDEL, zsim::ProjectionMode::MULTIGRID, zsim::ProjectionMode::PCG, zsim::ProjectionMode::FFT })
+            {
+                if (!std::strcmp(name, zsim::ProjectionModeName(mode)))
+                {
+                    settings.projectionMode = mode;
+                    found = true;
+                }
+            }
+            if (!found)
+            {
+                std::fprintf(stderr, "Invalid projection mode '%s'\n", name);
+                return 1;
+            }
+        }
+        else if (!std::strcmp(argv[i], "--rate") && hasValue)
+            settings.stepRate = std::max((float)std::atof(argv[++i]), 1.0f);
+        else if (!std::strcmp(argv[i], "--recorded-dt"))
+            settings.recordedDt = true;
+        else if (!std::strcmp(argv[i], "--key") && hasValue)
+            settings.smokeKey = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--no-batching"))
+            settings.batching = false;
+        else if (!std::strcmp(argv[i], "--speed") && hasValue)
+            settings.speed = std::max((float)std::atof(argv[++i]), 0.0f);
+        else if (!std::strcmp(argv[i], "--type") && hasValue)
+        {
+            const char* name = argv[++i];
+            if (!std::strcmp(name, "trail"))
+                settings.osuSimType = zsim::SmokeSimType::CURSOR_TRAIL;
+            else if (!std::strcmp(name, "smoke"))
+                settings.osuSimType = zsim::SmokeSimType::ENHANCED_SMOKE;
+            else
+            {
+                std::fprintf(stderr, "Invalid simulation type '%s'\n", name);
+                return 1;
+            }
+        }
+        else if (!std::strcmp(argv[i], "--size") && hasValue)
+        {
+            const char* size = argv[++i];
+            if (std::sscanf(size, "%dx%d", &settings.osuWidth, &settings.osuHeight) != 2 || settings.osuWidth <= 0 || settings.osuHeight <= 0)
+            {
+                std::fprintf(stderr, "Invalid overlay size '%s'\n", size);
+                return 1;
+            }
+        }
+        else if (!std::strcmp(argv[i], "--smoke-from") && hasValue)
+        {
+            const char* name = argv[++i];
+            if (!std::strcmp(name, "smoke"))
+                settings.osuKeyMask = zsim::OsuReplay::SMOKE;
+            else if (!std::strcmp(name, "clicks"))
+                settings.osuKeyMask = zsim::OsuReplay::MOUSE1 | zsim::OsuReplay::MOUSE2;
+            else
+            {
+                std::fprintf(stderr, "Invalid smoke source '%s'\n", name);
+                return 1;
+            }
+        }
+        else if (!std::strcmp(argv[i], "--trace") && hasValue)
+            settings.tracePath = argv[++i];
+        else if (!std::strcmp(argv[i], "--check-allocations"))
+            settings.checkAllocations = true;
+        else if (argv[i][0] != '-')
+            settings.tracePaths.push_back(argv[i]);
+        else
+        {
+            std::fprintf(stderr, "Unknown argument '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (settings.tracePaths.empty())
+    {
+        std::fprintf(stderr, "No traces given\n");
+        return 1;
+    }
+    if (!settings.tracePath.empty() && !zsim::TraceZones::Enabled())
+    {
+        std::fprintf(stderr, "--trace needs a build with ZSIM_TRACE_ZONES\n");
+        return 1;
+    }
+    if (settings.checkAllocations && !zsim::AllocationCountingEnabled())
+    {
+        std::fprintf(stderr, "--check-allocations needs a build with ZSIM_COUNT_ALLOCATIONS\n");
+        return 1;
+    }
+    ZSIM_TRACE_THREAD_NAME("Replay");
+
+    bool result = true;
+    for (size_t i = 0; i < settings.tracePaths.size(); i++)
+    {
+        if (i > 0)
+            std::printf("\n");
+        result &= Run(settings, settings.tracePaths[i]);
+    }
+    if (!settings.tracePath.empty() && !zsim::TraceZones::WriteChromeTrace(settings.tracePath, 1e9))
+    {
+        std::fprintf(stderr, "Couldn't write the trace to '%s'\n", settings.tracePath.c_str());
+        return 1;
+    }
+    return result ? 0 : 1;
+}
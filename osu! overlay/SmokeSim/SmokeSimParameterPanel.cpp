@@ -13,6 +13,8 @@
 #include "ColorSelectorScene.h"
 #include "Helper/StringHelper.h"
 
+#include <fstream>
+
 void zcom::SmokeSimParameterPanel::Init(SmokeSimType simType)
 {
     ScrollPanel::Init();
@@ -47,6 +49,8 @@ void zcom::SmokeSimParameterPanel::Init(SmokeSimType simType)
     _scene->GetApp()->options.SetIntValue(L"smokesim.enhancedsmoke.height", _smoke_height.Get(), false);
     _scene->GetApp()->options.SetIntValue(L"smokesim.enhancedsmoke.xOffset", _smoke_xOffset.Get(), false);
     _scene->GetApp()->options.SetIntValue(L"smokesim.enhancedsmoke.yOffset", _smoke_yOffset.Get(), false);
+    zsim::ProjectionSettings trailProjection = _LoadProjectionSettings(SmokeSimType::CURSOR_TRAIL);
+    zsim::ProjectionSettings smokeProjection = _LoadProjectionSettings(SmokeSimType::ENHANCED_SMOKE);
     SmokeSimScene::SimParams simParams;
     simParams.trailColor = _scene->GetApp()->options.GetIntValue(L"smokesim.cursortrail.trailColor").value_or(simParams.trailColor.Default());
     simParams.trailWidth = _scene->GetApp()->options.GetIntValue(L"smokesim.cursortrail.trailWidth").value_or(simParams.trailWidth.Default());
@@ -60,6 +64,9 @@ void zcom::SmokeSimParameterPanel::Init(SmokeSimType simType)
     simParams.trailTemperatureDiffusion = _scene->GetApp()->options.GetDoubleValue(L"smokesim.cursortrail.temperatureDiffusion").value_or(simParams.trailTemperatureDiffusion.Default());
     simParams.trailDensityReductionRate = _scene->GetApp()->options.GetDoubleValue(L"smokesim.cursortrail.densityReductionRate").value_or(simParams.trailDensityReductionRate.Default());
     simParams.trailTemperatureReductionRate = _scene->GetApp()->options.GetDoubleValue(L"smokesim.cursortrail.temperatureReductionRate").value_or(simParams.trailTemperatureReductionRate.Default());
+    simParams.trailTemperatureRamp = _scene->GetApp()->options.GetIntValue(L"smokesim.cursortrail.temperatureRamp").value_or(simParams.trailTemperatureRamp.Default());
+    simParams.trailHotColor = _scene->GetApp()->options.GetIntValue(L"smokesim.cursortrail.hotColor").value_or(simParams.trailHotColor.Default());
+    simParams.trailHotTemperature = _scene->GetApp()->options.GetDoubleValue(L"smokesim.cursortrail.hotTemperature").value_or(simParams.trailHotTemperature.Default());
     simParams.smokeColor = _scene->GetApp()->options.GetIntValue(L"smokesim.enhancedsmoke.smokeColor").value_or(simParams.smokeColor.Default());
     simParams.brushWidth = _scene->GetApp()->options.GetIntValue(L"smokesim.enhancedsmoke.brushWidth").value_or(simParams.brushWidth.Default());
     simParams.brushEdgeFadeRange = _scene->GetApp()->options.GetIntValue(L"smokesim.enhancedsmoke.brushEdgeFadeRange").value_or(simParams.brushEdgeFadeRange.Default());
@@ -83,6 +90,9 @@ void zcom::SmokeSimParameterPanel::Init(SmokeSimType simType)
     _scene->GetApp()->options.SetDoubleValue(L"smokesim.cursortrail.temperatureDiffusion", simParams.trailTemperatureDiffusion.Get(), false);
     _scene->GetApp()->options.SetDoubleValue(L"smokesim.cursortrail.densityReductionRate", simParams.trailDensityReductionRate.Get(), false);
     _scene->GetApp()->options.SetDoubleValue(L"smokesim.cursortrail.temperatureReductionRate", simParams.trailTemperatureReductionRate.Get(), false);
+    _scene->GetApp()->options.SetIntValue(L"smokesim.cursortrail.temperatureRamp", simParams.trailTemperatureRamp.Get(), false);
+    _scene->GetApp()->options.SetIntValue(L"smokesim.cursortrail.hotColor", simParams.trailHotColor.Get(), false);
+    _scene->GetApp()->options.SetDoubleValue(L"smokesim.cursortrail.hotTemperature", simParams.trailHotTemperature.Get(), false);
     _scene->GetApp()->options.SetIntValue(L"smokesim.enhancedsmoke.smokeColor", simParams.smokeColor.Get(), false);
     _scene->GetApp()->options.SetIntValue(L"smokesim.enhancedsmoke.brushWidth", simParams.brushWidth.Get(), false);
     _scene->GetApp()->options.SetIntValue(L"smokesim.enhancedsmoke.brushEdgeFadeRange", simParams.brushEdgeFadeRange.Get(), false);
@@ -270,6 +280,85 @@ void zcom::SmokeSimParameterPanel::Init(SmokeSimType simType)
                     fullMonitorRow->AddItem(_fullMonitorCheckbox.get());
                     fullMonitorRow->AddItem(std::move(fullMonitorLabel));
 
+                    auto multigridRow = Create<FlexPanel>(FlexDirection::RIGHT);
+                    multigridRow->FillContainerWidth();
+                    multigridRow->SetSpacing(10);
+                    multigridRow->SetPadding({ 15, 0, 15, 10 });
+                    _multigridCheckbox = Create<Checkbox>();
+                    _multigridCheckbox->SetBaseSize(20, 20);
+                    _multigridCheckbox->SetBackgroundColor(D2D1::ColorF(0x101010));
+                    _multigridCheckbox->SetCornerRounding(2.0f);
+                    _multigridCheckbox->SetVerticalAlignment(Alignment::CENTER);
+                    _multigridCheckbox->Checked((simType == SmokeSimType::CURSOR_TRAIL ? trailProjection.mode : smokeProjection.mode) == zsim::ProjectionMode::MULTIGRID);
+                    _multigridCheckbox->SubscribeOnStateChanged([=](bool state) {
+                        zsim::ProjectionMode mode = state ? zsim::ProjectionMode::MULTIGRID : zsim::ProjectionMode::GAUSS_SEIDEL;
+                        if (simType == SmokeSimType::CURSOR_TRAIL)
+                            _scene->GetApp()->options.SetIntValue(L"smokesim.cursortrail.projectionMode", (int)mode);
+                        else
+                            _scene->GetApp()->options.SetIntValue(L"smokesim.enhancedsmoke.projectionMode", (int)mode);
+                        }).Detach();
+                        auto multigridLabel = Create<Label>(L"Multigrid pressure solver");
+                        multigridLabel->SetBaseHeight(26);
+                        multigridLabel->SetVerticalTextAlignment(Alignment::CENTER);
+                        multigridLabel->SetProperty(FlexGrow());
+                        multigridLabel->SetHoverText(L"Solve the pressure equation with multigrid V-cycles instead of a fixed number of relaxation sweeps. Gives more accurate swirls at a higher cost per frame. Only used when hardware acceleration is unavailable. Solver parameters can be tuned in the options file, where projectionMode=2 selects the conjugate gradient solver and projectionMode=3 the exact FFT solver instead");
+                        multigridRow->AddItem(_multigridCheckbox.get());
+                        multigridRow->AddItem(std::move(multigridLabel));
+
+                    auto advectionRow = Create<FlexPanel>(FlexDirection::RIGHT);
+                    advectionRow->FillContainerWidth();
+                    advectionRow->SetSpacing(10);
+                    advectionRow->SetPadding({ 15, 0, 15, 10 });
+                    _advectionCheckbox = Create<Checkbox>();
+                    _advectionCheckbox->SetBaseSize(20, 20);
+                    _advectionCheckbox->SetBackgroundColor(D2D1::ColorF(0x101010));
+                    _advectionCheckbox->SetCornerRounding(2.0f);
+                    _advectionCheckbox->SetVerticalAlignment(Alignment::CENTER);
+                    _advectionCheckbox->Checked(_LoadAdvectionMode(simType) == zsim::AdvectionMode::MACCORMACK);
+                    _advectionCheckbox->SubscribeOnStateChanged([=](bool state) {
+                        zsim::AdvectionMode mode = state ? zsim::AdvectionMode::MACCORMACK : zsim::AdvectionMode::SEMI_LAGRANGIAN;
+                        if (simType == SmokeSimType::CURSOR_TRAIL)
+                            _scene->GetApp()->options.SetIntValue(L"smokesim.cursortrail.advectionMode", (int)mode);
+                        else
+                            _scene->GetApp()->options.SetIntValue(L"smokesim.enhancedsmoke.advectionMode", (int)mode);
+                        }).Detach();
+                        auto advectionLabel = Create<Label>(L"Sharper advection");
+                        advectionLabel->SetBaseHeight(26);
+                        advectionLabel->SetVerticalTextAlignment(Alignment::CENTER);
+                        advectionLabel->SetProperty(FlexGrow());
+                        advectionLabel->SetHoverText(L"Move smoke with a second order (MacCormack) scheme, which smears it much less. Costs more per cell, but keeps the same detail at a larger cell size, which is usually faster overall. Only used when hardware acceleration is unavailable");
+                        advectionRow->AddItem(_advectionCheckbox.get());
+                        advectionRow->AddItem(std::move(advectionLabel));
+
+                    auto autoTuneRow = Create<FlexPanel>(FlexDirection::RIGHT);
+                    autoTuneRow->FillContainerWidth();
+                    autoTuneRow->SetSpacing(10);
+                    autoTuneRow->SetPadding({ 15, 0, 15, 10 });
+                    auto autoTuneButton = Create<Button>(L"Auto-tune");
+                    autoTuneButton->SetBaseSize(90, 26);
+                    autoTuneButton->SetBorderVisibility(false);
+                    autoTuneButton->Text()->SetFontColor(D2D1::ColorF(0xEAEAEA));
+                    autoTuneButton->SetButtonColor(D2D1::ColorF(0x303030));
+                    autoTuneButton->SetButtonHoverColor(D2D1::ColorF(0x404040));
+                    autoTuneButton->SetButtonClickColor(D2D1::ColorF(0x383838));
+                    autoTuneButton->SetCornerRounding(2.0f);
+                    autoTuneButton->SetSelectedBorderColor(D2D1::ColorF(0, 0.0f));
+                    autoTuneButton->SetActivation(ButtonActivation::RELEASE);
+                    autoTuneButton->SubscribeOnActivated([&]() {
+                        if (_autoTuneResult.valid())
+                            _autoTuneCancel.store(true);
+                        else
+                            _StartAutoTune();
+                        }).Detach();
+                    _autoTuneButton = autoTuneButton.get();
+                        auto autoTuneLabel = Create<Label>(L"Measure this PC");
+                        autoTuneLabel->SetBaseHeight(26);
+                        autoTuneLabel->SetVerticalTextAlignment(Alignment::CENTER);
+                        autoTuneLabel->SetProperty(FlexGrow());
+                        autoTuneLabel->SetHoverText(L"Runs the simulation with different cell sizes, thread counts, instruction sets and pressure solvers, and picks the finest setup that still keeps up with the step rate. Takes up to a minute. The measurements are saved to smokesim_autotune_*.csv next to the config file");
+                        autoTuneRow->AddItem(std::move(autoTuneButton));
+                        autoTuneRow->AddItem(std::move(autoTuneLabel));
+
                     auto layoutSection = Create<FlexPanel>(FlexDirection::RIGHT);
                     layoutSection->FillContainerWidth();
                     layoutSection->SetSpacing(10);
@@ -395,6 +484,9 @@ void zcom::SmokeSimParameterPanel::Init(SmokeSimType simType)
                     generalPanel->AddItem(std::move(titleRow));
                     generalPanel->AddItem(std::move(cellSizeRow));
                     generalPanel->AddItem(std::move(threadCountRow));
+                    generalPanel->AddItem(std::move(multigridRow));
+                    generalPanel->AddItem(std::move(advectionRow));
+                    generalPanel->AddItem(std::move(autoTuneRow));
                     generalPanel->AddItem(std::move(fullMonitorRow));
                     generalPanel->AddItem(std::move(layoutSection));
                     flexPanel->AddItem(std::move(generalPanel));
@@ -836,6 +928,22 @@ void zcom::SmokeSimParameterPanel::_OnUpdate()
         _lastColorInputUpdate = ztime::Main();
     }
 
+    if (_autoTuneResult.valid())
+    {
+        if (_autoTuneResult.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            zsim::AutoTuneResult result = _autoTuneResult.get();
+            if (!_autoTuneCancel.load())
+                _ApplyAutoTuneResult(result);
+            _autoTuneButton->Text()->SetText(L"Auto-tune");
+            _UpdateActiveItems();
+        }
+        else
+        {
+            _autoTuneButton->Text()->SetText(string_to_wstring(std::to_string(_autoTuneDone.load()) + "/" + std::to_string(_autoTuneTotal.load())));
+        }
+    }
+
     ScrollPanel::_OnUpdate();
 }
 
@@ -846,6 +954,190 @@ void zcom::SmokeSimParameterPanel::_UpdateColorInput()
     _colorInput->SetBackgroundColor(D2D1::ColorF(color.ToIntNoAlpha(), color.a / 255.0f));
 }
 
+zsim::ProjectionSettings zcom::SmokeSimParameterPanel::_LoadProjectionSettings(SmokeSimType simType)
+{
+    std::wstring prefix = simType == SmokeSimType::CURSOR_TRAIL ? L"smokesim.cursortrail." : L"smokesim.enhancedsmoke.";
+    Options& options = _scene->GetApp()->options;
+
+    zsim::ProjectionSettings settings;
+    settings.mode = (zsim::ProjectionMode)options.GetIntValue(prefix + L"projectionMode").value_or((int)settings.mode);
+    settings.gaussSeidelIterations = options.GetIntValue(prefix + L"gaussSeidelIterations").value_or(settings.gaussSeidelIterations);
+    settings.multigridLevels = options.GetIntValue(prefix + L"multigridLevels").value_or(settings.multigridLevels);
+    settings.multigridSmoother = (zsim::MultigridSmoother)options.GetIntValue(prefix + L"multigridSmoother").value_or((int)settings.multigridSmoother);
+    settings.preSmoothIterations = options.GetIntValue(prefix + L"multigridPreSmoothIterations").value_or(settings.preSmoothIterations);
+    settings.postSmoothIterations = options.GetIntValue(prefix + L"multigridPostSmoothIterations").value_or(settings.postSmoothIterations);
+    settings.coarseIterations = options.GetIntValue(prefix + L"multigridCoarseIterations").value_or(settings.coarseIterations);
+    settings.maxCycles = options.GetIntValue(prefix + L"multigridMaxCycles").value_or(settings.maxCycles);
+    settings.tolerance = (float)options.GetDoubleValue(prefix + L"multigridTolerance").value_or(settings.tolerance);
+    settings.pcgMaxIterations = options.GetIntValue(prefix + L"pcgMaxIterations").value_or(settings.pcgMaxIterations);
+    settings.pcgTimeBudgetMs = (float)options.GetDoubleValue(prefix + L"pcgTimeBudgetMs").value_or(settings.pcgTimeBudgetMs);
+
+    // Out of range values from a hand edited file fall back to defaults
+    zsim::ProjectionSettings defaults;
+    if ((int)settings.mode < 0 || (int)settings.mode > (int)zsim::ProjectionMode::FFT)
+        settings.mode = defaults.mode;
+    if ((int)settings.multigridSmoother < 0 || (int)settings.multigridSmoother > (int)zsim::MultigridSmoother::JACOBI)
+        settings.multigridSmoother = defaults.multigridSmoother;
+
+    options.SetIntValue(prefix + L"projectionMode", (int)settings.mode, false);
+    options.SetIntValue(prefix + L"gaussSeidelIterations", settings.gaussSeidelIterations, false);
+    options.SetIntValue(prefix + L"multigridLevels", settings.multigridLevels, false);
+    options.SetIntValue(prefix + L"multigridSmoother", (int)settings.multigridSmoother, false);
+    options.SetIntValue(prefix + L"multigridPreSmoothIterations", settings.preSmoothIterations, false);
+    options.SetIntValue(prefix + L"multigridPostSmoothIterations", settings.postSmoothIterations, false);
+    options.SetIntValue(prefix + L"multigridCoarseIterations", settings.coarseIterations, false);
+    options.SetIntValue(prefix + L"multigridMaxCycles", settings.maxCycles, false);
+    options.SetDoubleValue(prefix + L"multigridTolerance", settings.tolerance, false);
+    options.SetIntValue(prefix + L"pcgMaxIterations", settings.pcgMaxIterations, false);
+    options.SetDoubleValue(prefix + L"pcgTimeBudgetMs", settings.pcgTimeBudgetMs, false);
+    return settings;
+}
+
+void zcom::SmokeSimParameterPanel::_LoadStepSettings(SmokeSimSceneOptions& opt)
+{
+    std::wstring prefix = _simType == SmokeSimType::CURSOR_TRAIL ? L"smokesim.cursortrail." : L"smokesim.enhancedsmoke.";
+    Options& options = _scene->GetApp()->options;
+
+    SmokeSimSceneOptions defaults;
+    opt.stepPolicy = (zsim::StepPolicy)options.GetIntValue(prefix + L"stepPolicy").value_or((int)defaults.stepPolicy);
+    opt.stepRate = options.GetIntValue(prefix + L"stepRate").value_or(defaults.stepRate);
+    if (opt.stepPolicy != zsim::StepPolicy::FIXED_RATE && opt.stepPolicy != zsim::StepPolicy::AS_FAST_AS_POSSIBLE)
+        opt.stepPolicy = defaults.stepPolicy;
+    if (opt.stepRate <= 0)
+        opt.stepRate = defaults.stepRate;
+
+    options.SetIntValue(prefix + L"stepPolicy", (int)opt.stepPolicy, false);
+    options.SetIntValue(prefix + L"stepRate", opt.stepRate, false);
+}
+
+zsim::ResolutionSettings zcom::SmokeSimParameterPanel::_LoadResolutionSettings()
+{
+    std::wstring prefix = _simType == SmokeSimType::CURSOR_TRAIL ? L"smokesim.cursortrail." : L"smokesim.enhancedsmoke.";
+    Options& options = _scene->GetApp()->options;
+
+    zsim::ResolutionSettings settings;
+    settings.enabled = options.GetIntValue(prefix + L"dynamicResolution").value_or(settings.enabled) != 0;
+    settings.targetStepMs = (float)options.GetDoubleValue(prefix + L"dynamicResolutionTargetMs").value_or(settings.targetStepMs);
+    settings.minCellSize = options.GetIntValue(prefix + L"dynamicResolutionMinCellSize").value_or(settings.minCellSize);
+    settings.maxCellSize = options.GetIntValue(prefix + L"dynamicResolutionMaxCellSize").value_or(settings.maxCellSize);
+    if (settings.targetStepMs <= 0.0f)
+        settings.targetStepMs = zsim::ResolutionSettings().targetStepMs;
+
+    options.SetIntValue(prefix + L"dynamicResolution", settings.enabled, false);
+    options.SetDoubleValue(prefix + L"dynamicResolutionTargetMs", settings.targetStepMs, false);
+    options.SetIntValue(prefix + L"dynamicResolutionMinCellSize", settings.minCellSize, false);
+    options.SetIntValue(prefix + L"dynamicResolutionMaxCellSize", settings.maxCellSize, false);
+    return settings;
+}
+
+zsim::StepSchedulerSettings zcom::SmokeSimParameterPanel::_LoadStepSchedulerSettings()
+{
+    // Only the enhanced smoke slows down
+    Options& options = _scene->GetApp()->options;
+
+    zsim::StepSchedulerSettings settings;
+    settings.enabled = options.GetIntValue(L"smokesim.enhancedsmoke.slowdownStepBatching").value_or(settings.enabled) != 0;
+    float maxStepMs = (float)options.GetDoubleValue(L"smokesim.enhancedsmoke.slowdownMaxStepMs").value_or(settings.maxStepDt * 1000.0f);
+    if (maxStepMs > 0.0f)
+        settings.maxStepDt = maxStepMs / 1000.0f;
+
+    options.SetIntValue(L"smokesim.enhancedsmoke.slowdownStepBatching", settings.enabled, false);
+    options.SetDoubleValue(L"smokesim.enhancedsmoke.slowdownMaxStepMs", settings.maxStepDt * 1000.0f, false);
+    return settings;
+}
+
+void zcom::SmokeSimParameterPanel::_LoadInputTraceSettings(SmokeSimSceneOptions& opt)
+{
+    // Shared by both simulation types, the trace records which one it came from
+    Options& options = _scene->GetApp()->options;
+
+    std::wstring recordPath = options.GetValue(L"smokesim.recordInputPath").value_or(L"");
+    std::wstring replayPath = options.GetValue(L"smokesim.replayInputPath").value_or(L"");
+    opt.recordInputPath = wstring_to_string(recordPath);
+    opt.replayInputPath = wstring_to_string(replayPath);
+
+    options.SetValue(L"smokesim.recordInputPath", recordPath, false);
+    options.SetValue(L"smokesim.replayInputPath", replayPath, false);
+}
+
+zsim::SimdLevel zcom::SmokeSimParameterPanel::_LoadSimdLevel()
+{
+    std::wstring prefix = _simType == SmokeSimType::CURSOR_TRAIL ? L"smokesim.cursortrail." : L"smokesim.enhancedsmoke.";
+    Options& options = _scene->GetApp()->options;
+
+    zsim::SimdLevel level = (zsim::SimdLevel)options.GetIntValue(prefix + L"simdLevel").value_or((int)zsim::SimdLevel::AVX2);
+    if (level < zsim::SimdLevel::SCALAR || level > zsim::SimdLevel::AVX2)
+        level = zsim::SimdLevel::AVX2;
+
+    options.SetIntValue(prefix + L"simdLevel", (int)level, false);
+    return level;
+}
+
+zsim::AdvectionMode zcom::SmokeSimParameterPanel::_LoadAdvectionMode(SmokeSimType simType)
+{
+    std::wstring prefix = simType == SmokeSimType::CURSOR_TRAIL ? L"smokesim.cursortrail." : L"smokesim.enhancedsmoke.";
+    Options& options = _scene->GetApp()->options;
+
+    zsim::AdvectionMode mode = (zsim::AdvectionMode)options.GetIntValue(prefix + L"advectionMode").value_or((int)zsim::AdvectionMode::SEMI_LAGRANGIAN);
+    if (mode < zsim::AdvectionMode::SEMI_LAGRANGIAN || mode > zsim::AdvectionMode::MACCORMACK)
+        mode = zsim::AdvectionMode::SEMI_LAGRANGIAN;
+
+    options.SetIntValue(prefix + L"advectionMode", (int)mode, false);
+    return mode;
+}
+
+void zcom::SmokeSimParameterPanel::_StartAutoTune()
+{
+    zsim::AutoTuneSettings settings;
+    settings.simType = _simType;
+    if (_fullMonitorCheckbox->Checked())
+    {
+        settings.pixelWidth = GetSystemMetrics(SM_CXSCREEN);
+        settings.pixelHeight = GetSystemMetrics(SM_CYSCREEN);
+    }
+    else
+    {
+        settings.pixelWidth = _widthInput->GetValue().getAsInteger();
+        settings.pixelHeight = _heightInput->GetValue().getAsInteger();
+    }
+    SmokeSimSceneOptions opt;
+    _LoadStepSettings(opt);
+    settings.targetStepRate = (float)opt.stepRate;
+
+    _autoTuneDone.store(0);
+    _autoTuneTotal.store(0);
+    _autoTuneCancel.store(false);
+    _autoTuneResult = std::async(std::launch::async, [=]() {
+        return zsim::RunAutoTune(settings, [=](int done, int total) {
+            _autoTuneDone.store(done);
+            _autoTuneTotal.store(total);
+            return !_autoTuneCancel.load();
+            });
+        });
+    _UpdateActiveItems();
+}
+
+void zcom::SmokeSimParameterPanel::_ApplyAutoTuneResult(const zsim::AutoTuneResult& result)
+{
+    std::ofstream(_simType == SmokeSimType::CURSOR_TRAIL ? "smokesim_autotune_cursortrail.csv" : "smokesim_autotune_enhancedsmoke.csv") << result.ToCsv();
+
+    const zsim::AutoTuneSample* best = result.Best();
+    if (!best)
+        return;
+
+    std::wstring prefix = _simType == SmokeSimType::CURSOR_TRAIL ? L"smokesim.cursortrail." : L"smokesim.enhancedsmoke.";
+    Options& options = _scene->GetApp()->options;
+    options.SetIntValue(prefix + L"cellSize", best->cellSize, false);
+    options.SetIntValue(prefix + L"threadCount", best->threadCount, false);
+    options.SetIntValue(prefix + L"simdLevel", (int)best->simdLevel, false);
+    options.SetIntValue(prefix + L"projectionMode", (int)best->projectionMode, false);
+    options.SaveOptions();
+
+    _cellSizeInput->SetValue(NumberInputValue(best->cellSize));
+    _threadCountInput->SetValue(NumberInputValue(best->threadCount));
+    _multigridCheckbox->Checked(best->projectionMode == zsim::ProjectionMode::MULTIGRID);
+}
+
 void zcom::SmokeSimParameterPanel::_OpenOverlayWindow()
 {
     std::wstring wndClass = _simType == SmokeSimType::CURSOR_TRAIL ? L"cursorTrailOverlay" : L"enhancedSmokeOverlay";
@@ -906,6 +1198,19 @@ void zcom::SmokeSimParameterPanel::_OpenOverlayWindow()
             opt.simType = _simType;
             opt.cellSize = _cellSizeInput->GetValue().getAsInteger();
             opt.maxThreads = _threadCountInput->GetValue().getAsInteger();
+            opt.projection = _LoadProjectionSettings(_simType);
+            // PCG and FFT can only be picked in the options file or by the auto tuner, and show as unchecked
+            if (_multigridCheckbox->Checked())
+                opt.projection.mode = zsim::ProjectionMode::MULTIGRID;
+            else if (opt.projection.mode == zsim::ProjectionMode::MULTIGRID)
+                opt.projection.mode = zsim::ProjectionMode::GAUSS_SEIDEL;
+            _LoadStepSettings(opt);
+            opt.resolution = _LoadResolutionSettings();
+            opt.simdLevel = _LoadSimdLevel();
+            opt.advectionMode = _LoadAdvectionMode(_simType);
+            if (_simType == SmokeSimType::ENHANCED_SMOKE)
+                opt.stepScheduler = _LoadStepSchedulerSettings();
+            _LoadInputTraceSettings(opt);
             wnd->LoadStartingScene<SmokeSimScene>(&opt);
         }
     );
@@ -916,6 +1221,10 @@ void zcom::SmokeSimParameterPanel::_UpdateActiveItems()
     _cellSizeInput->SetActive(!_overlayWindowId);
     _threadCountInput->SetActive(!_overlayWindowId);
     _fullMonitorCheckbox->SetActive(!_overlayWindowId);
+    _multigridCheckbox->SetActive(!_overlayWindowId);
+    _advectionCheckbox->SetActive(!_overlayWindowId);
+    // Tuning while the overlay runs would measure both at once
+    _autoTuneButton->SetActive(!_overlayWindowId);
     _widthInput->SetActive(!_overlayWindowId && !_fullMonitorCheckbox->Checked());
     _heightInput->SetActive(!_overlayWindowId && !_fullMonitorCheckbox->Checked());
     _xOffsetInput->SetActive(!_overlayWindowId && !_fullMonitorCheckbox->Checked());
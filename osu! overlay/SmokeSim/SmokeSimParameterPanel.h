@@ -6,8 +6,17 @@
 #include "Shared/Util/ValueOrDefault.h"
 #include "SmokeSimType.h"
 
+#include "SmokeSolver/SmokeSolverSettings.h"
+#include "SmokeSolver/AutoTuner.h"
+
+#include <atomic>
+#include <future>
+
 namespace zcom
 {
+    struct SmokeSimSceneOptions;
+    class Button;
+
     class SmokeSimParameterPanel : public ScrollPanel
     {
     public:
@@ -17,7 +26,13 @@ namespace zcom
         SmokeSimParameterPanel(Scene* scene) : ScrollPanel(scene) {}
         void Init(SmokeSimType simType);
     public:
-        ~SmokeSimParameterPanel() {}
+        ~SmokeSimParameterPanel()
+        {
+            // The tuning thread must not outlive the panel
+            _autoTuneCancel.store(true);
+            if (_autoTuneResult.valid())
+                _autoTuneResult.wait();
+        }
         SmokeSimParameterPanel(SmokeSimParameterPanel&&) = delete;
         SmokeSimParameterPanel& operator=(SmokeSimParameterPanel&&) = delete;
         SmokeSimParameterPanel(const SmokeSimParameterPanel&) = delete;
@@ -34,6 +49,8 @@ namespace zcom
         std::unique_ptr<NumberInput> _cellSizeInput = nullptr;
         std::unique_ptr<NumberInput> _threadCountInput = nullptr;
         std::unique_ptr<Checkbox> _fullMonitorCheckbox = nullptr;
+        std::unique_ptr<Checkbox> _multigridCheckbox = nullptr;
+        std::unique_ptr<Checkbox> _advectionCheckbox = nullptr;
         std::unique_ptr<NumberInput> _widthInput = nullptr;
         std::unique_ptr<NumberInput> _heightInput = nullptr;
         std::unique_ptr<NumberInput> _xOffsetInput = nullptr;
@@ -64,7 +81,30 @@ namespace zcom
         TimePoint _lastColorInputUpdate = TimePoint(0);
         Component* _colorInput = nullptr;
 
+        Button* _autoTuneButton = nullptr;
+        std::future<zsim::AutoTuneResult> _autoTuneResult;
+        std::atomic<int> _autoTuneDone = 0;
+        std::atomic<int> _autoTuneTotal = 0;
+        std::atomic<bool> _autoTuneCancel = false;
+
         void _UpdateColorInput();
+        // Reads the pressure solver options, writing defaults for missing values
+        zsim::ProjectionSettings _LoadProjectionSettings(SmokeSimType simType);
+        // Reads the simulation thread options, writing defaults for missing values
+        void _LoadStepSettings(SmokeSimSceneOptions& opt);
+        // Reads the dynamic resolution options, writing defaults for missing values
+        zsim::ResolutionSettings _LoadResolutionSettings();
+        // Reads the slowdown step batching options, writing defaults for missing values
+        zsim::StepSchedulerSettings _LoadStepSchedulerSettings();
+        // Reads the input trace recording and replay paths, writing empty defaults if missing
+        void _LoadInputTraceSettings(SmokeSimSceneOptions& opt);
+        // Reads the SIMD level option, writing the default if missing
+        zsim::SimdLevel _LoadSimdLevel();
+        // Reads the advection scheme option, writing the default if missing
+        zsim::AdvectionMode _LoadAdvectionMode(SmokeSimType simType);
+        // Measures solver configurations on a background thread, the result is applied in _OnUpdate()
+        void _StartAutoTune();
+        void _ApplyAutoTuneResult(const zsim::AutoTuneResult& result);
         void _OpenOverlayWindow();
         void _UpdateActiveItems();
         void _OpenColorSelector();
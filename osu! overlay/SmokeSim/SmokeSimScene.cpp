@@ -1,10 +1,42 @@
 #include "App.h" // App.h must be included first
 #include "Window/Window.h"
 #include "SmokeSimScene.h"
+#include "Window/PerfHud.h"
+
+#include "SmokeSolver/AutoTuner.h"
+#include "SmokeSolver/TraceZones.h"
 
 #include "Shared/Util/Navigation.h"
 #include "Shared/Util/Functions.h"
 #include "Shared/Util/Color.h"
+#include "Helper/StringHelper.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Cursor and keyboard of the desktop
+    class LiveInput : public zsim::InputSource
+    {
+    public:
+        explicit LiveInput(zwnd::Window* window) : _window(window) {}
+
+        void SetTime(double) override {}
+        void GetCursor(int& x, int& y) override
+        {
+            POINT p;
+            GetCursorPos(&p);
+            RECT windowRect = _window->Backend().GetWindowRectangle();
+            x = p.x - windowRect.left;
+            y = p.y - windowRect.top;
+        }
+        bool IsKeyDown(int keyCode) override { return GetAsyncKeyState(keyCode) & 0x8000; }
+
+    private:
+        zwnd::Window* _window;
+    };
+}
 
 zcom::SmokeSimScene::SmokeSimScene(App* app, zwnd::Window* window)
     : Scene(app, window)
@@ -20,79 +52,173 @@ void zcom::SmokeSimScene::_Init(SceneOptionsBase* options)
 
     _simType = opt.simType;
     _cellSize = opt.cellSize;
-    THREAD_COUNT = opt.maxThreads;
 
-    _width = _window->Backend().GetWidth() / _cellSize;
-    _height = _window->Backend().GetHeight() / _cellSize;
-    _totalWidth = _width + 2;
-    _totalHeight = _height + 2;
+    _pixelWidth = _window->Backend().GetWidth();
+    _pixelHeight = _window->Backend().GetHeight();
+    _width = _pixelWidth / _cellSize;
+    _height = _pixelHeight / _cellSize;
 
     cuda_ctx = CudaSmokeSim_Init(_width, _height);
 
-    if (!cuda_ctx)
-        for (int i = 0; i < THREAD_COUNT; i++)
-            _threadPool.AddThread();
+    _liveInput = std::make_unique<LiveInput>(_window);
+    _input = _liveInput.get();
+    if (!opt.replayInputPath.empty())
+    {
+        // Converted osu! replays press the overlay smoke key while the in-game one is held
+        int smokeKeyCode = _app->options.GetIntValue(L"smokesim.enhancedsmoke.smokeKeyCode").value_or(_simParams.smokeKeyCode.Default());
+        if (zsim::LoadInputTrace(opt.replayInputPath, _simType, _pixelWidth, _pixelHeight, zsim::OsuReplay::SMOKE, smokeKeyCode, _replayTrace))
+        {
+            _inputReplay = std::make_unique<zsim::InputReplay>(_replayTrace);
+            _input = _inputReplay.get();
+        }
+        else
+        {
+            zwnd::PerfHud::PostStatus(L"Couldn't read the input trace '" + string_to_wstring(opt.replayInputPath) + L"', using live input");
+        }
+    }
+    else if (!opt.recordInputPath.empty())
+    {
+        _recordInputPath = opt.recordInputPath;
+        _inputRecorder = std::make_unique<zsim::InputRecorder>(_liveInput.get(), _simType, _pixelWidth, _pixelHeight);
+        _input = _inputRecorder.get();
+    }
 
-    int size = (_width + 2) * (_height + 2);
-    u.resize(size, 0.0f);
-    v.resize(size, 0.0f);
-    u_prev.resize(size, 0.0f);
-    v_prev.resize(size, 0.0f);
-    dens.resize(size, 0.0f);
-    dens_prev.resize(size, 0.0f);
-    temp.resize(size, 0.0f);
-    temp_prev.resize(size, 0.0f);
+    // Solver threads are only needed when stepping on the CPU
+    _solver = std::make_unique<zsim::SmokeSolver>(_simType, _width, _height, _cellSize, cuda_ctx ? 0 : opt.maxThreads);
+    _solver->SetProjectionSettings(opt.projection);
+    _solver->SetSimdLevel(opt.simdLevel);
+    _solver->SetAdvectionMode(opt.advectionMode);
+    if (cuda_ctx)
+    {
+        // The CUDA solver advances every cell, so empty tiles can't be skipped
+        zsim::TileSettings tiles;
+        tiles.enabled = false;
+        _solver->SetTileSettings(tiles);
+        // The CUDA solver always advects a temperature field, even in modes without one
+        if (!_solver->HasTemperature())
+            _cudaTemperature.assign(_solver->Pitch() * _solver->TotalHeight(), 0.0f);
+    }
+    else if (opt.resolution.enabled)
+    {
+        int pressureIterations = opt.projection.gaussSeidelIterations;
+        if (opt.projection.mode == zsim::ProjectionMode::MULTIGRID)
+            pressureIterations = opt.projection.maxCycles;
+        else if (opt.projection.mode == zsim::ProjectionMode::PCG)
+            pressureIterations = opt.projection.pcgMaxIterations;
+        _resolutionController = std::make_unique<zsim::ResolutionController>(opt.resolution, opt.projection.mode, _cellSize, pressureIterations);
+        _ApplyResolution();
+    }
+    if (_simType == SmokeSimType::ENHANCED_SMOKE && opt.stepScheduler.enabled)
+        _stepScheduler = std::make_unique<zsim::StepScheduler>(opt.stepScheduler);
+    // First frame, so the renderer always has a valid size
+    _stepDamage = _solver->LastStepDamage();
+    _PublishFrame(_simParams);
+    _simThread.Start([&](float dt) { _SimulationStep(dt); }, opt.stepPolicy, (float)opt.stepRate);
 
     _canvas->SetBackgroundColor(D2D1::ColorF(0, 1.0f / 255.0f));
     _canvas->BasePanel()->SubscribePostDraw([&](Component* panel, Graphics g) {
         g.target->Clear(D2D1::ColorF(0, 0.0f));
 
-        ID2D1Bitmap1* backgroundBitmap = nullptr;
-        g.target->CreateBitmap(
-            D2D1::SizeU(_width, _height),
-            nullptr,
-            0,
-            D2D1::BitmapProperties1(
-                D2D1_BITMAP_OPTIONS_TARGET,
-                { DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED }
-            ),
-            &backgroundBitmap
-        );
-
-        SimpleTimer timer;
-
-        // Generate source data
-        auto sourceData = std::make_unique<unsigned char[]>(_width * _height * 4);
-        for (int y = 0; y < _height; y++)
+        // Latest frame published by the simulation thread. The grid size can change between frames,
+        // so the frame carries its own
+        bool newFrame = _frames.Acquire();
+        const PixelFrame& frame = _frames.ReadBuffer();
+
+        int64_t allocationsBefore = zsim::ThreadAllocationCount();
+        bool recreated = false;
+        SimpleTimer uploadTimer;
+        if (_frameBitmap)
         {
-            for (int x = 0; x < _width; x++)
+            D2D1_SIZE_U bitmapSize = _frameBitmap->GetPixelSize();
+            if (bitmapSize.width != (UINT32)frame.width || bitmapSize.height != (UINT32)frame.height)
             {
-                // Smoke density
-                float density = dens[(y + 1) * (_width + 2) + x + 1];
-                float temperature = temp[(y + 1) * (_width + 2) + x + 1];
-                float intensity = std::powf(_Clamp(density, 0.0f, 1.0f), 2.0f);
-
-                zutil::Color color = zutil::Color(_simType == SmokeSimType::CURSOR_TRAIL ? _simParams.trailColor.Get() : _simParams.smokeColor.Get());
-
-                sourceData[y * _width * 4 + (x * 4) + 0] = color.b * (color.a / 255.0f) * intensity;
-                sourceData[y * _width * 4 + (x * 4) + 1] = color.g * (color.a / 255.0f) * intensity;
-                sourceData[y * _width * 4 + (x * 4) + 2] = color.r * (color.a / 255.0f) * intensity;
-                sourceData[y * _width * 4 + (x * 4) + 3] = 0xFF * (color.a / 255.0f) * intensity;
-
-                // Temperature
-                //intensity = _Clamp(temperature / 10.0f, 0.0f, 1.0f);
-                //unsigned char r = sourceData[y * _width * 4 + (x * 4) + 2];
-                //sourceData[y * _width * 4 + (x * 4) + 2] = r + (0xFF - r) * intensity;
+                _frameBitmap->Release();
+                _frameBitmap = nullptr;
             }
         }
+        if (!_frameBitmap)
+        {
+            g.target->CreateBitmap(
+                D2D1::SizeU(frame.width, frame.height),
+                nullptr,
+                0,
+                D2D1::BitmapProperties1(
+                    D2D1_BITMAP_OPTIONS_TARGET,
+                    { DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED }
+                ),
+                &_frameBitmap
+            );
+            recreated = true;
+        }
 
-        D2D1_RECT_U destRect = D2D1::RectU(0, 0, _width, _height);
-        backgroundBitmap->CopyFromMemory(&destRect, sourceData.get(), _width * 4);
-        g.target->DrawBitmap(backgroundBitmap, D2D1::RectF(0.0f, 0.0f, panel->GetWidth(), panel->GetHeight()));
-
-        backgroundBitmap->Release();
+        // Only the tiles that changed since the previous frame are uploaded
+        zsim::RegionRect changedCells{ 0, 0, frame.width, frame.height };
+        if (recreated)
+        {
+            ZSIM_TRACE_ZONE("CopyFromMemory");
+            D2D1_RECT_U destRect = D2D1::RectU(0, 0, frame.width, frame.height);
+            _frameBitmap->CopyFromMemory(&destRect, frame.pixels.data(), frame.width * 4);
+        }
+        else if (newFrame)
+        {
+            ZSIM_TRACE_ZONE("CopyFromMemory");
+            frame.damage.GetRects(_uploadRects);
+            for (const zsim::RegionRect& rect : _uploadRects)
+            {
+                zsim::RegionRect cells = zsim::BlockRegion::ToCells(rect, frame.tileSize, frame.width, frame.height);
+                D2D1_RECT_U destRect = D2D1::RectU(cells.left, cells.top, cells.right, cells.bottom);
+                _frameBitmap->CopyFromMemory(&destRect, frame.pixels.data() + cells.top * frame.width + cells.left, frame.width * 4);
+            }
+            changedCells = zsim::BlockRegion::ToCells(frame.damage.Bounds(), frame.tileSize, frame.width, frame.height);
+        }
+        else
+        {
+            changedCells = {};
+        }
+        if ((recreated || newFrame) && zwnd::PerfHud::Visible())
+            _perfUploadMs.Add(uploadTimer.MicrosElapsed() / 1000.0, zwnd::PerfHud::Now());
+        g.target->DrawBitmap(_frameBitmap, D2D1::RectF(0.0f, 0.0f, panel->GetWidth(), panel->GetHeight()));
+
+        bool showBorder = (ztime::Main() - _creationTime).GetDuration(SECONDS) < 2;
+        // The frame after the border disappears also updates the whole window to erase it
+        bool eraseBorder = !showBorder && _borderShown;
+        _borderShown = showBorder;
+        if (showBorder || eraseBorder)
+        {
+            changedCells = { 0, 0, frame.width, frame.height };
+        }
+        else if (!changedCells.Empty())
+        {
+            // Bilinear filtering spreads every cell into its neighbours
+            changedCells.left = std::max(changedCells.left - 1, 0);
+            changedCells.top = std::max(changedCells.top - 1, 0);
+            changedCells.right = std::min(changedCells.right + 1, frame.width);
+            changedCells.bottom = std::min(changedCells.bottom + 1, frame.height);
+        }
+        // Limit the layered window update to the changed area. The window adds whatever it draws over the scene
+        float scaleX = panel->GetWidth() / (float)std::max(frame.width, 1);
+        float scaleY = panel->GetHeight() / (float)std::max(frame.height, 1);
+        RECT dirtyRect;
+        dirtyRect.left = (LONG)std::floor(changedCells.left * scaleX);
+        dirtyRect.top = (LONG)std::floor(changedCells.top * scaleY);
+        dirtyRect.right = changedCells.right == frame.width ? _window->Backend().GetWidth() : (LONG)std::ceil(changedCells.right * scaleX);
+        dirtyRect.bottom = changedCells.bottom == frame.height ? _window->Backend().GetHeight() : (LONG)std::ceil(changedCells.bottom * scaleY);
+        if (changedCells.Empty())
+            dirtyRect = { 0, 0, 0, 0 };
+        _window->Backend().SetLayeredUpdateRect(dirtyRect);
+
+        if (!recreated)
+            _steadyStateAllocations.fetch_add(zsim::ThreadAllocationCount() - allocationsBefore);
+        if constexpr (zsim::AllocationCountingEnabled())
+        {
+            if (!_allocationWarningShown && _steadyStateAllocations.load() > 0)
+            {
+                zwnd::PerfHud::PostStatus(L"Frame pipeline allocated " + std::to_wstring(_steadyStateAllocations.load()) + L" times in steady state");
+                _allocationWarningShown = true;
+            }
+        }
 
-        if ((ztime::Main() - _creationTime).GetDuration(SECONDS) < 2)
+        if (showBorder)
         {
             float offset = 2.0f;
             D2D1_RECT_F rect = D2D1::RectF(
@@ -167,7 +293,16 @@ void zcom::SmokeSimScene::_Init(SceneOptionsBase* options)
 
 void zcom::SmokeSimScene::_Uninit()
 {
+    _simThread.Stop();
+    if (_inputRecorder && !_inputRecorder->Trace().Save(_recordInputPath))
+        zwnd::PerfHud::PostStatus(L"Couldn't write the input trace '" + string_to_wstring(_recordInputPath) + L"', the recording is lost");
+    if (_frameBitmap)
+    {
+        _frameBitmap->Release();
+        _frameBitmap = nullptr;
+    }
     _canvas->ClearComponents();
+    _solver.reset();
 
     if (cuda_ctx)
         CudaSmokeSim_Uninit(cuda_ctx);
@@ -183,247 +318,6 @@ void zcom::SmokeSimScene::_Unfocus()
 
 }
 
-void zcom::SmokeSimScene::_AddSource(int W, int H, float* x, float* s, float dt)
-{
-    int i, size = (W + 2) * (H + 2);
-    for (i = 0; i < size; i++)
-        x[i] += dt * s[i];
-}
-
-void zcom::SmokeSimScene::_SetBoundary(int W, int H, int b, float* x)
-{
-    for (int i = 1; i <= H; i++)
-    {
-        x[_IndexAt(0, i)] = b == 1 ? -x[_IndexAt(1, i)] : x[_IndexAt(1, i)];
-        x[_IndexAt(W + 1, i)] = b == 1 ? -x[_IndexAt(W, i)] : x[_IndexAt(W, i)];
-    }
-    for (int i = 1; i <= W; i++)
-    {
-        x[_IndexAt(i, 0)] = b == 2 ? -x[_IndexAt(i, 1)] : x[_IndexAt(i, 1)];
-        x[_IndexAt(i, H + 1)] = b == 2 ? -x[_IndexAt(i, H)] : x[_IndexAt(i, H)];
-    }
-    x[_IndexAt(0, 0)] = 0.5 * (x[_IndexAt(1, 0)] + x[_IndexAt(0, 1)]);
-    x[_IndexAt(0, H + 1)] = 0.5 * (x[_IndexAt(1, H + 1)] + x[_IndexAt(0, H)]);
-    x[_IndexAt(W + 1, 0)] = 0.5 * (x[_IndexAt(W, 0)] + x[_IndexAt(W + 1, 1)]);
-    x[_IndexAt(W + 1, H + 1)] = 0.5 * (x[_IndexAt(W, H + 1)] + x[_IndexAt(W + 1, H)]);
-}
-
-void zcom::SmokeSimScene::_Diffuse(int W, int H, int b, float* x, float* x0, float diff, float dt)
-{
-    if (diff <= 0.0f)
-    {
-        for (int i = 1; i <= W; i++)
-        {
-            for (int j = 1; j <= H; j++)
-            {
-                int index = _IndexAt(i, j);
-                x[index] = x0[index];
-            }
-        }
-        return;
-    }
-
-    float a = dt * diff;
-
-    for (int k = 0; k < 4; k++)
-    {
-        int INTERVAL = W / THREAD_COUNT;
-        std::vector<ThreadPool::ThreadData*> threads;
-        for (int idx = 0; idx < THREAD_COUNT; idx++)
-        {
-            int startIndex = 1;
-            int endIndex = W + 1;
-
-            if (idx > 0)
-                startIndex = INTERVAL * idx;
-            if (idx < THREAD_COUNT - 1)
-                endIndex = INTERVAL * (idx + 1);
-
-            ThreadPool::ThreadData* thread = _threadPool.GetThread(idx);
-            thread->DoWork(std::move([=](auto unused) {
-                for (int i = startIndex; i < endIndex; i++)
-                {
-                    for (int j = 1; j <= H; j++)
-                    {
-                        int index = _IndexAt(i, j);
-                        x[index] = (
-                            x0[index] + a * (
-                                x[_IndexToLeft(index)] +
-                                x[_IndexToRight(index)] +
-                                x[_IndexAbove(index)] +
-                                x[_IndexBelow(index)]
-                                )
-                            ) / (1 + 4 * a);
-                    }
-                }
-                }));
-            threads.push_back(thread);
-        }
-
-        while (1)
-        {
-            bool stillRunning = false;
-            for (auto thread : threads)
-            {
-                if (thread->taskRunning.load())
-                {
-                    stillRunning = true;
-                    break;
-                }
-            }
-            if (!stillRunning)
-                break;
-        }
-    }
-
-    _SetBoundary(W, H, b, x);
-}
-
-void zcom::SmokeSimScene::_Advect(int W, int H, int b, float* d, float* d0, float* u, float* v, float dt, bool conserve)
-{
-    int i, j, i0, j0, i1, j1;
-    float x, y, s0, t0, s1, t1, dt0;
-
-    float oldValSum = 0.0f;
-    float newValSum = 0.0f;
-
-    dt0 = dt * H;
-    //dt0 = dt * _velocityMultiplier;
-    for (i = 1; i <= W; i++) {
-        for (j = 1; j <= H; j++) {
-            x = i - dt0 * u[_IndexAt(i, j)];
-            y = j - dt0 * v[_IndexAt(i, j)];
-            if (x < 0.5)
-                x = 0.5;
-            if (x > W + 0.5)
-                x = W + 0.5;
-            i0 = (int)x;
-            i1 = i0 + 1;
-            if (y < 0.5)
-                y = 0.5;
-            if (y > H + 0.5)
-                y = H + 0.5;
-            j0 = (int)y;
-            j1 = j0 + 1;
-
-            s1 = x - i0;
-            s0 = 1 - s1;
-
-            t1 = y - j0;
-            t0 = 1 - t1;
-
-            d[_IndexAt(i, j)] =
-                s0 * (t0 * d0[_IndexAt(i0, j0)] + t1 * d0[_IndexAt(i0, j1)]) +
-                s1 * (t0 * d0[_IndexAt(i1, j0)] + t1 * d0[_IndexAt(i1, j1)]);
-
-            oldValSum += d0[_IndexAt(i, j)];
-            newValSum += d[_IndexAt(i, j)];
-        }
-    }
-
-    if (conserve && newValSum != 0.0f)
-    {
-        float ratio = oldValSum / newValSum;
-        for (int idx = 0; idx < W * H; idx++)
-            d[idx] *= ratio;
-    }
-
-    _SetBoundary(W, H, b, d);
-}
-
-void zcom::SmokeSimScene::_Project(int W, int H, float* u, float* v, float* p, float* div)
-{
-    int i, j, k;
-    float h, g;
-
-    h = 1.0 / H;
-    for (i = 1; i <= W; i++)
-    {
-        for (j = 1; j <= H; j++)
-        {
-            div[_IndexAt(i, j)] = -0.5 * h * (
-                u[_IndexAt(i + 1, j)] - u[_IndexAt(i - 1, j)] +
-                v[_IndexAt(i, j + 1)] - v[_IndexAt(i, j - 1)]
-                );
-            p[_IndexAt(i, j)] = 0;
-        }
-    }
-    _SetBoundary(W, H, 0, div);
-    _SetBoundary(W, H, 0, p);
-
-    for (k = 0; k < 4; k++)
-    {
-        for (i = 1; i <= W; i++)
-        {
-            for (j = 1; j <= H; j++)
-            {
-                p[_IndexAt(i, j)] = (
-                    div[_IndexAt(i, j)] +
-                    p[_IndexAt(i - 1, j)] +
-                    p[_IndexAt(i + 1, j)] +
-                    p[_IndexAt(i, j - 1)] +
-                    p[_IndexAt(i, j + 1)]
-                    ) / 4;
-            }
-        }
-        _SetBoundary(W, H, 0, p);
-    }
-
-    for (i = 1; i <= W; i++)
-    {
-        for (j = 1; j <= H; j++)
-        {
-            u[_IndexAt(i, j)] -= 0.5 * (p[_IndexAt(i + 1, j)] - p[_IndexAt(i - 1, j)]) / h;
-            v[_IndexAt(i, j)] -= 0.5 * (p[_IndexAt(i, j + 1)] - p[_IndexAt(i, j - 1)]) / h;
-        }
-    }
-    _SetBoundary(W, H, 1, u);
-    _SetBoundary(W, H, 2, v);
-}
-
-void zcom::SmokeSimScene::_VelocityStep(int W, int H, float* u, float* v, float* u0, float* v0, float visc, float dt)
-{
-    //u[_IndexAt(50, 10)] += 2.0f;
-
-    _AddSource(W, H, u, u0, 1.0f);
-    _AddSource(W, H, v, v0, 1.0f);
-
-    _SwapPtr(&u0, &u);
-    _Diffuse(W, H, 1, u, u0, visc, dt);
-    _SwapPtr(&v0, &v);
-    _Diffuse(W, H, 2, v, v0, visc, dt);
-
-    _Project(W, H, u, v, u0, v0);
-
-    _SwapPtr(&u0, &u);
-    _SwapPtr(&v0, &v);
-
-    _Advect(W, H, 1, u, u0, u0, v0, dt, false);
-    _Advect(W, H, 2, v, v0, u0, v0, dt, false);
-
-    _Project(W, H, u, v, u0, v0);
-}
-
-void zcom::SmokeSimScene::_DensityStep(int W, int H, float* x, float* x0, float* u, float* v, float diff, float dt)
-{
-    _AddSource(W, H, x, x0, 1.0f);
-
-    _SwapPtr(&x0, &x);
-    _Diffuse(W, H, 0, x, x0, diff, dt);
-
-    _SwapPtr(&x0, &x);
-    _Advect(W, H, 0, x, x0, u, v, dt, true);
-
-    //float prevDensitySum = 0.0f;
-    //float newDensitySum = 0.0f;
-    //for (int i = 0; i < dens.size(); i++)
-    //{
-    //    prevDensitySum += x0[i];
-    //    newDensitySum += x[i];
-    //}
-    //std::cout << newDensitySum << ": " << newDensitySum - prevDensitySum << '\n';
-}
-
 void zcom::SmokeSimScene::_UpdateParticles(float dt)
 {
     //for (auto& particle : _particles)
@@ -456,6 +350,7 @@ void zcom::SmokeSimScene::_UpdateParameters(bool force)
 {
     if (force || ztime::Main() > (_lastParamUpdate + _paramUpdateInterval))
     {
+        std::lock_guard<std::mutex> lock(_simParamsMutex);
         _lastParamUpdate = ztime::Main();
         _simParams.trailColor = _app->options.GetIntValue(L"smokesim.cursortrail.trailColor").value_or(_simParams.trailColor.Default());
         _simParams.trailWidth = _app->options.GetIntValue(L"smokesim.cursortrail.trailWidth").value_or(_simParams.trailWidth.Default());
@@ -469,6 +364,9 @@ void zcom::SmokeSimScene::_UpdateParameters(bool force)
         _simParams.trailTemperatureDiffusion = _app->options.GetDoubleValue(L"smokesim.cursortrail.temperatureDiffusion").value_or(_simParams.trailTemperatureDiffusion.Default());
         _simParams.trailDensityReductionRate = _app->options.GetDoubleValue(L"smokesim.cursortrail.densityReductionRate").value_or(_simParams.trailDensityReductionRate.Default());
         _simParams.trailTemperatureReductionRate = _app->options.GetDoubleValue(L"smokesim.cursortrail.temperatureReductionRate").value_or(_simParams.trailTemperatureReductionRate.Default());
+        _simParams.trailTemperatureRamp = _app->options.GetIntValue(L"smokesim.cursortrail.temperatureRamp").value_or(_simParams.trailTemperatureRamp.Default());
+        _simParams.trailHotColor = _app->options.GetIntValue(L"smokesim.cursortrail.hotColor").value_or(_simParams.trailHotColor.Default());
+        _simParams.trailHotTemperature = _app->options.GetDoubleValue(L"smokesim.cursortrail.hotTemperature").value_or(_simParams.trailHotTemperature.Default());
         _simParams.smokeColor = _app->options.GetIntValue(L"smokesim.enhancedsmoke.smokeColor").value_or(_simParams.smokeColor.Default());
         _simParams.brushWidth = _app->options.GetIntValue(L"smokesim.enhancedsmoke.brushWidth").value_or(_simParams.brushWidth.Default());
         _simParams.brushEdgeFadeRange = _app->options.GetIntValue(L"smokesim.enhancedsmoke.brushEdgeFadeRange").value_or(_simParams.brushEdgeFadeRange.Default());
@@ -485,34 +383,47 @@ void zcom::SmokeSimScene::_UpdateParameters(bool force)
 }
 
 void zcom::SmokeSimScene::_Update()
+{
+    ZSIM_TRACE_ZONE("SmokeSimScene::_Update");
+    _canvas->Update();
+    _canvas->BasePanel()->InvokeRedraw();
+    _UpdateParameters();
+}
+
+void zcom::SmokeSimScene::_SimulationStep(float dt)
 {
     //std::cout << _particles.size() << '\n';
 
     _currentStep++;
-    float dt = (ztime::Main() - _lastFrameTime).GetDuration(MICROSECONDS) / 1'000'000.0f;
+    // Unclamped, so recorded step times match the real ones
+    _inputTime += dt;
     if (dt > 1.0f / 30.0f)
         dt = 1.0f / 30.0f;
 
-    _canvas->Update();
-    _canvas->BasePanel()->InvokeRedraw();
-    _UpdateParameters();
+    // ztime::Main() is advanced by the UI thread, the simulation keeps its own clock
+    _simClock.Update();
+    TimePoint now = _simClock.Now();
 
-    SimpleTimer timer;
+    SimParams simParams;
+    Duration slowdownPersistenceDuration;
+    {
+        std::lock_guard<std::mutex> lock(_simParamsMutex);
+        simParams = _simParams;
+        slowdownPersistenceDuration = _slowdownPersistenceDuration;
+    }
 
-    std::fill(u_prev.begin(), u_prev.end(), 0.0f);
-    std::fill(v_prev.begin(), v_prev.end(), 0.0f);
-    std::fill(dens_prev.begin(), dens_prev.end(), 0.0f);
-    std::fill(temp_prev.begin(), temp_prev.end(), 0.0f);
+    SimpleTimer timer;
+    // Stage timing costs a clock read per stage, so it only runs while the HUD shows it
+    bool perfHud = zwnd::PerfHud::Visible();
+    _solver->SetStageTiming(perfHud);
+    double solverStepMs = -1.0;
 
-    //dens_prev[_IndexAt(100, 100)] = 100.0f;
-    //dens_prev[_IndexAt(15, 50)] = ((rand() % 101) - 50) * 0.1f;
+    _solver->ClearSources();
 
-    POINT p;
-    GetCursorPos(&p);
-    int deltaX = p.x - prevMouseX;
-    int deltaY = p.y - prevMouseY;
-    float movedPixels = Pos2D<float>(float(deltaX), float(deltaY)).vector_length();
-    float movedCells = movedPixels / _cellSize;
+    _input->SetTime(_inputTime);
+    int cursorX;
+    int cursorY;
+    _input->GetCursor(cursorX, cursorY);
 
     //bool addWind = GetAsyncKeyState('X') & 0x8000;
     //bool addSmoke = GetAsyncKeyState('C') & 0x8000;
@@ -521,8 +432,8 @@ void zcom::SmokeSimScene::_Update()
     bool addWind = true;
     if (_simType == SmokeSimType::ENHANCED_SMOKE)
     {
-        addSmoke = GetAsyncKeyState(_simParams.smokeKeyCode.Get()) & 0x8000;
-        bool slowdownPeriodEnded = (_smokeEndTime + _slowdownPersistenceDuration) <= ztime::Main();
+        addSmoke = _input->IsKeyDown(simParams.smokeKeyCode.Get());
+        bool slowdownPeriodEnded = (_smokeEndTime + slowdownPersistenceDuration) <= now;
         addWind = !_addingSmoke && slowdownPeriodEnded;
     }
     bool addParticles = true;
@@ -532,259 +443,56 @@ void zcom::SmokeSimScene::_Update()
     while ((addWind || addSmoke || addParticles) && !_paused)
     {
         RECT windowRect = _window->Backend().GetWindowRectangle();
-        Pos2D<float> startPos = {
-            float(prevMouseX - windowRect.left),
-            float(prevMouseY - windowRect.top)
-        };
-        Pos2D<float> endPos = {
-            float(p.x - windowRect.left),
-            float(p.y - windowRect.top)
-        };
-
-        if (prevMouseX < windowRect.left || prevMouseX >= windowRect.right || prevMouseY < windowRect.top || prevMouseY >= windowRect.bottom)
+
+        int windowWidth = windowRect.right - windowRect.left;
+        int windowHeight = windowRect.bottom - windowRect.top;
+
+        if (prevMouseX < 0 || prevMouseX >= windowWidth || prevMouseY < 0 || prevMouseY >= windowHeight)
             break;
-        if (p.x < windowRect.left || p.x >= windowRect.right || p.y < windowRect.top || p.y >= windowRect.bottom)
+        if (cursorX < 0 || cursorX >= windowWidth || cursorY < 0 || cursorY >= windowHeight)
             break;
 
-        //// Add particles
-        //if (addParticles)
-        //{
-        //    int particleCount = movedPixels;
-        //    //int particleCount = _particlesPerFrame;
-        //    for (int i = 0; i < particleCount; i++)
-        //    {
-        //        float maxVelocity = 100.0f;
-        //        float dt = 1.0f / 144.0f;
-        //        Particle particle;
-        //        particle.position = {
-        //            float(prevMouseX - windowRect.left) + deltaX * (i / float(particleCount)),
-        //            float(prevMouseY - windowRect.top) + deltaY * (i / float(particleCount))
-        //        };
-        //        particle.position += point_rotated_by({ 0.0f, 0.0f }, { 5.0f, 0.0f }, Math::TAU * ((rand() % 1001) / 1000.0f));
-        //        //particle.position = { 500.0f, 500.0f };
-        //        particle.velocity = point_rotated_by({ 0.0f, 0.0f }, { 1.0f, 0.0f }, Math::TAU * ((rand() % 1001) / 1000.0f)) * ((rand() % 1001) / 1000.0f * maxVelocity);
-        //        //particle.velocity += Pos2D<float>(float(deltaX), float(deltaY)) / dt / 2;
-        //        particle.creationTime = ztime::Main();
-        //        _particles.push_back(particle);
-        //    }
-        //}
-
-        float lineThickness;
-        float fadeRange;
-        float lineDensity;
-        float windThickness;
-        float windMultiplier;
-        float cursorTemp;
+        zsim::SmokeStroke stroke;
+        stroke.startX = float(prevMouseX);
+        stroke.startY = float(prevMouseY);
+        stroke.endX = float(cursorX);
+        stroke.endY = float(cursorY);
+        stroke.addWind = addWind;
+        stroke.addSmoke = addSmoke;
         if (_simType == SmokeSimType::CURSOR_TRAIL)
         {
-            lineThickness = _simParams.trailWidth.Get();
-            fadeRange = _simParams.trailEdgeFadeRange.Get();
-            lineDensity = _simParams.trailDensity.Get();
-            windThickness = _simParams.trailWindWidth.Get();
-            windMultiplier = _simParams.trailWindSpeed.Get();
-            cursorTemp = _simParams.cursorTemp.Get();
+            stroke.lineThickness = simParams.trailWidth.Get();
+            stroke.fadeRange = simParams.trailEdgeFadeRange.Get();
+            stroke.lineDensity = simParams.trailDensity.Get();
+            stroke.windThickness = simParams.trailWindWidth.Get();
+            stroke.windMultiplier = simParams.trailWindSpeed.Get();
+            stroke.cursorTemp = simParams.cursorTemp.Get();
         }
         else
         {
-            lineThickness = _simParams.brushWidth.Get();
-            fadeRange = _simParams.brushEdgeFadeRange.Get();
-            lineDensity = _simParams.smokeDensity.Get();
-            windThickness = _simParams.cursorWindWidth.Get();
-            windMultiplier = _simParams.cursorWindSpeed.Get();
-            cursorTemp = 0.0f;
-        }
-
-        float cursorVelX = (deltaX / float(_cellSize * _height)) / dt * windMultiplier;
-        float cursorVelY = (deltaY / float(_cellSize * _height)) / dt * windMultiplier;
-
-        // Find bounding rectangle
-        RECT boundingRect;
-        {
-            float left = (startPos.x < endPos.x ? startPos.x : endPos.x) - lineThickness;
-            float right = (startPos.x > endPos.x ? startPos.x : endPos.x) + lineThickness;
-            float top = (startPos.y < endPos.y ? startPos.y : endPos.y) - lineThickness;
-            float bottom = (startPos.y > endPos.y ? startPos.y : endPos.y) + lineThickness;
-            boundingRect.left = std::floorf(left / _cellSize);
-            boundingRect.top = std::floorf(top / _cellSize);
-            boundingRect.right = std::ceilf(right / _cellSize);
-            boundingRect.bottom = std::ceilf(bottom / _cellSize);
-            if (boundingRect.left < 0)
-                boundingRect.left = 0;
-            if (boundingRect.top < 0)
-                boundingRect.top = 0;
-            if (boundingRect.right >= _width)
-                boundingRect.right = _width - 1;
-            if (boundingRect.bottom >= _height)
-                boundingRect.bottom = _height - 1;
-        }
-
-        // Iterate through cells in bounding rectangle to check which fall inside the line
-        for (int x = boundingRect.left; x < boundingRect.right; x++)
-        {
-            for (int y = boundingRect.top; y < boundingRect.bottom; y++)
-            {
-                Pos2D<float> cellCenterPos = {
-                    float(x * _cellSize + _cellSize / 2.0f),
-                    float(y * _cellSize + _cellSize / 2.0f)
-                };
-                int cellIndex = _IndexAt(x + 1, y + 1);
-
-                bool cellNearLine = false;
-                bool nearStartPoint = false;
-                float distanceToLine = 0.0f;
-
-                // Between start and end point                
-                Pos2D<float> normalToEnd = (endPos - startPos).of_length(1.0f);
-                Pos2D<float> normalToStart = -normalToEnd;
-                if (dot_product(cellCenterPos - startPos, normalToEnd) >= 0.0f && dot_product(cellCenterPos - endPos, normalToStart) >= 0.0f)
-                {
-                    float distToLineCenter = std::fabsf(dot_product(cellCenterPos - startPos, normalToEnd.perpendicularL()));
-                    if (distToLineCenter <= lineThickness)
-                    {
-                        distanceToLine = distToLineCenter;
-                        cellNearLine = true;
-                    }
-                }
-                // Near start point
-                if (!cellNearLine && (cellCenterPos - startPos).vector_length_sqr() <= lineThickness * lineThickness)
-                {
-                    distanceToLine = (cellCenterPos - startPos).vector_length();
-                    cellNearLine = true;
-                }
-                // Near end point
-                if (!cellNearLine && (cellCenterPos - endPos).vector_length_sqr() <= lineThickness * lineThickness)
-                {
-                    distanceToLine = (cellCenterPos - endPos).vector_length();
-                    cellNearLine = true;
-                }
-
-                if (!cellNearLine)
-                    continue;
-
-                // Add 
-                if (addWind)
-                {
-                    if (distanceToLine <= windThickness)
-                    {
-                        u_prev[cellIndex] = cursorVelX - u[cellIndex];
-                        v_prev[cellIndex] = cursorVelY - v[cellIndex];
-
-                        //if (u[cellIndex] < deltaX * windMultiplier)
-                        //    u_prev[cellIndex] = deltaX * windMultiplier - u[cellIndex];
-                        //if (v[cellIndex] < deltaY * windMultiplier)
-                        //    v_prev[cellIndex] = deltaY * windMultiplier - v[cellIndex];
-
-                        //u_prev[cellIndex] = deltaX * windMultiplier;
-                        //v_prev[cellIndex] = deltaY * windMultiplier;
-                    }
-                }
-                if (addSmoke)
-                {
-                    float targetDensity = lineDensity;
-                    if (distanceToLine > lineThickness - fadeRange)
-                        targetDensity *= ((lineThickness - distanceToLine) / fadeRange);
-
-                    if (dens[cellIndex] < targetDensity)
-                        dens_prev[cellIndex] = targetDensity - dens[cellIndex];
-                    if (temp[cellIndex] < cursorTemp)
-                        temp_prev[cellIndex] = (cursorTemp - temp[cellIndex]) / (1.0f + movedCells);
-                }
-
-                //// Near start point
-                //if ((cellCenterPos - startPos).vector_length_sqr() <= lineThickness * lineThickness)
-                //{
-                //    if (addWind)
-                //    {
-                //        if ((cellCenterPos - startPos).vector_length_sqr() <= windThickness * windThickness)
-                //        {
-                //            u_prev[cellIndex] = deltaX * windMultiplier;
-                //            v_prev[cellIndex] = deltaY * windMultiplier;
-                //        }
-                //    }
-                //    if (addSmoke)
-                //    {
-                //        float distance = (cellCenterPos - startPos).vector_length();
-                //        float targetDensity = lineDensity;
-                //        if (distance > lineThickness - fadeRange)
-                //            targetDensity *= ((lineThickness - distance) / fadeRange);
-
-                //        if (dens[cellIndex] < targetDensity)
-                //            dens_prev[cellIndex] = targetDensity - dens[cellIndex];
-                //        if (temp[cellIndex] < cursorTemp)
-                //            temp_prev[cellIndex] = (cursorTemp - temp[cellIndex]) / (1.0f + movedCells);
-
-                //    }
-                //}
-                //// Near end point
-                //if ((cellCenterPos - endPos).vector_length_sqr() <= lineThickness * lineThickness)
-                //{
-                //    if (addWind)
-                //    {
-                //        if ((cellCenterPos - endPos).vector_length_sqr() <= windThickness * windThickness)
-                //        {
-                //            u_prev[cellIndex] = deltaX * windMultiplier;
-                //            v_prev[cellIndex] = deltaY * windMultiplier;
-                //        }
-                //    }
-                //    if (addSmoke)
-                //    {
-                //        float distance = (cellCenterPos - endPos).vector_length();
-                //        float targetDensity = lineDensity;
-                //        if (distance > lineThickness - fadeRange)
-                //            targetDensity *= ((lineThickness - distance) / fadeRange);
-
-                //        if (dens[cellIndex] < targetDensity)
-                //            dens_prev[cellIndex] = targetDensity - dens[cellIndex];
-                //        if (temp[cellIndex] < cursorTemp)
-                //            temp_prev[cellIndex] = (cursorTemp - temp[cellIndex]) / (1.0f + movedCells);
-                //    }
-                //}
-
-                //// Between start and end point                
-                //Pos2D<float> normalToEnd = (endPos - startPos).of_length(1.0f);
-                //Pos2D<float> normalToStart = -normalToEnd;
-                //if (dot_product(cellCenterPos - startPos, normalToEnd) >= 0.0f && dot_product(cellCenterPos - endPos, normalToStart) >= 0.0f)
-                //{
-                //    float distToLineCenter = std::fabsf(dot_product(cellCenterPos - startPos, normalToEnd.perpendicularL()));
-                //    if (distToLineCenter <= lineThickness)
-                //    {
-                //        if (addWind)
-                //        {
-                //            if (distToLineCenter <= windThickness)
-                //            {
-                //                u_prev[cellIndex] = deltaX * windMultiplier;
-                //                v_prev[cellIndex] = deltaY * windMultiplier;
-                //            }
-                //        }
-                //        if (addSmoke)
-                //        {
-                //            float targetDensity = lineDensity;
-                //            if (distToLineCenter > lineThickness - fadeRange)
-                //                targetDensity *= ((lineThickness - distToLineCenter) / fadeRange);
-
-                //            if (dens[cellIndex] < targetDensity)
-                //                dens_prev[cellIndex] = targetDensity - dens[cellIndex];
-                //            if (temp[cellIndex] < cursorTemp)
-                //                temp_prev[cellIndex] = (cursorTemp - temp[cellIndex]) / (1.0f + movedCells);
-                //        }
-                //    }
-                //}
-            }
+            stroke.lineThickness = simParams.brushWidth.Get();
+            stroke.fadeRange = simParams.brushEdgeFadeRange.Get();
+            stroke.lineDensity = simParams.smokeDensity.Get();
+            stroke.windThickness = simParams.cursorWindWidth.Get();
+            stroke.windMultiplier = simParams.cursorWindSpeed.Get();
+            stroke.cursorTemp = 0.0f;
         }
+        _solver->AddStroke(stroke, dt);
 
         break;
     }
 
-    prevMouseX = p.x;
-    prevMouseY = p.y;
+    prevMouseX = cursorX;
+    prevMouseY = cursorY;
 
+    bool stepped = false;
     if (!_paused)
     {
         if (addSmoke)
         {
             if (!_addingSmoke)
             {
-                _smokeStartTime = ztime::Main();
+                _smokeStartTime = now;
                 _addingSmoke = true;
             }
         }
@@ -792,112 +500,296 @@ void zcom::SmokeSimScene::_Update()
         {
             if (_addingSmoke)
             {
-                _smokeEndTime = ztime::Main();
+                _smokeEndTime = now;
                 _addingSmoke = false;
             }
         }
-        bool slowdownPeriodEnded = (_smokeEndTime + _slowdownPersistenceDuration) <= ztime::Main();
+        bool slowdownPeriodEnded = (_smokeEndTime + slowdownPersistenceDuration) <= now;
 
+        bool slowedDown = _simType == SmokeSimType::ENHANCED_SMOKE && (_addingSmoke || !slowdownPeriodEnded);
         float dtFinal = dt;
-        if (_simType == SmokeSimType::ENHANCED_SMOKE && (_addingSmoke || !slowdownPeriodEnded))
+        if (slowedDown)
             dtFinal /= 16.0f;
 
-        for (int i = 0; i < u.size(); i++)
-        {
-            // Kill velocities and densities
-            u[i] *= 0.9995f;
-            v[i] *= 0.9995f;
-            temp[i] *= 0.9995f;
-            if (_simType == SmokeSimType::CURSOR_TRAIL)
-            {
-                dens[i] -= _simParams.trailDensityReductionRate.Get() * dtFinal;
-                temp[i] -= _simParams.trailTemperatureReductionRate.Get() * dtFinal;
-            }
-            else
-            {
-                dens[i] -= _simParams.smokeDensityReductionRate.Get() * dtFinal;
-            }
-            if (dens[i] < 0.0f)
-                dens[i] = 0.0f;
-            if (temp[i] < 0.0f)
-                temp[i] = 0.0f;
-
-            // Apply heat to velocity
-            if (temp[i] > 0.0f)
-                v_prev[i] -= temp[i] * dt;
-        }
-
-        float velocityDiffusion;
-        float densityDiffusion;
-        float temperatureDiffusion;
+        zsim::SmokeStepParams stepParams;
         if (_simType == SmokeSimType::CURSOR_TRAIL)
         {
-            velocityDiffusion = _simParams.trailVelocityDiffusion.Get();
-            densityDiffusion = _simParams.trailDensityDiffusion.Get();
-            temperatureDiffusion = _simParams.trailTemperatureDiffusion.Get();
+            stepParams.velocityDiffusion = simParams.trailVelocityDiffusion.Get();
+            stepParams.densityDiffusion = simParams.trailDensityDiffusion.Get();
+            stepParams.temperatureDiffusion = simParams.trailTemperatureDiffusion.Get();
+            stepParams.densityReductionRate = simParams.trailDensityReductionRate.Get();
+            stepParams.temperatureReductionRate = simParams.trailTemperatureReductionRate.Get();
         }
         else
         {
-            velocityDiffusion = _simParams.smokeVelocityDiffusion.Get();
-            densityDiffusion = _simParams.smokeDensityDiffusion.Get();
-            temperatureDiffusion = 0.0f;
+            stepParams.velocityDiffusion = simParams.smokeVelocityDiffusion.Get();
+            stepParams.densityDiffusion = simParams.smokeDensityDiffusion.Get();
+            stepParams.temperatureDiffusion = 0.0f;
+            stepParams.densityReductionRate = simParams.smokeDensityReductionRate.Get();
+            stepParams.temperatureReductionRate = 0.0f;
         }
 
-        //SimpleTimer timer;
-        if (cuda_ctx)
+        _solver->ApplySources(dt, dtFinal, stepParams);
+
+        // A slowed down frame barely moves the fluid, so the scheduler may collect several into one step
+        float stepDt = dtFinal;
+        bool batched = slowedDown && _stepScheduler;
+        if (_stepScheduler)
         {
-            _AddSource(_width, _height, u.data(), u_prev.data(), 1.0f);
-            _AddSource(_width, _height, v.data(), v_prev.data(), 1.0f);
-            _AddSource(_width, _height, dens.data(), dens_prev.data(), 1.0f);
-            _AddSource(_width, _height, temp.data(), temp_prev.data(), 1.0f);
-
-            CudaSmokeSim_StepData data;
-            data.u = u.data();
-            data.v = v.data();
-            data.dens = dens.data();
-            data.temp = temp.data();
-            data.dt = dtFinal;
-            data.velDiffusion = velocityDiffusion;
-            data.densDiffusion = densityDiffusion;
-            data.tempDiffusion = temperatureDiffusion;
-            CudaSmokeSim_Step(cuda_ctx, &data);
+            if (slowedDown && _cellsPerSecond < 0.0f)
+                _cellsPerSecond = _solver->MaxSpeed() * _solver->Height();
+            stepDt = _stepScheduler->Advance(dtFinal, slowedDown, _cellsPerSecond);
         }
-        else
+        stepped = stepDt > 0.0f;
+        if (stepped)
         {
-            _VelocityStep(_width, _height, u.data(), v.data(), u_prev.data(), v_prev.data(), velocityDiffusion, dtFinal);
-            _DensityStep(_width, _height, dens.data(), dens_prev.data(), u.data(), v.data(), densityDiffusion, dtFinal);
-            if (_simType == SmokeSimType::CURSOR_TRAIL)
-                _DensityStep(_width, _height, temp.data(), temp_prev.data(), u.data(), v.data(), temperatureDiffusion, dtFinal);
-            _UpdateParticles(dtFinal);
+            _fading = false;
+            if (batched)
+            {
+                // Density before the step, turned into the change made by it below
+                if (_fadeDelta.Width() != _width || _fadeDelta.Height() != _height)
+                {
+                    _fadeDelta.Resize(_width, _height);
+                    _fadeRow.resize(_width);
+                }
+                const float* density = _solver->Density();
+                std::copy(density, density + _fadeDelta.Size(), _fadeDelta.Data());
+            }
+
+            //SimpleTimer timer;
+            SimpleTimer solverTimer;
+            if (cuda_ctx)
+            {
+                CudaSmokeSim_StepData data;
+                data.u = _solver->U();
+                data.v = _solver->V();
+                data.dens = _solver->Density();
+                data.temp = _solver->HasTemperature() ? _solver->Temperature() : _cudaTemperature.data();
+                data.pitch = _solver->Pitch();
+                data.dt = stepDt;
+                data.velDiffusion = stepParams.velocityDiffusion;
+                data.densDiffusion = stepParams.densityDiffusion;
+                data.tempDiffusion = stepParams.temperatureDiffusion;
+                CudaSmokeSim_Step(cuda_ctx, &data);
+            }
+            else
+            {
+                SimpleTimer stepTimer;
+                _solver->Step(stepDt, stepParams);
+                float stepMs = stepTimer.MicrosElapsed() / 1000.0f;
+                _UpdateParticles(stepDt);
+
+                if (_resolutionController && _resolutionController->AddSample(stepMs))
+                    _ApplyResolution();
+            }
+            solverStepMs = solverTimer.MicrosElapsed() / 1000.0;
+            //std::cout << timer.MicrosElapsed() << '\n';
+
+            // A resolution change drops the blend along with the old grid
+            if (batched && _fadeDelta.Width() == _width && _fadeDelta.Height() == _height)
+            {
+                const float* density = _solver->Density();
+                float* delta = _fadeDelta.Data();
+                for (size_t i = 0; i < _fadeDelta.Size(); i++)
+                    delta[i] = density[i] - delta[i];
+                _fadeDamage = _solver->LastStepDamage();
+                if (cuda_ctx)
+                    _fadeDamage.AddAll();
+                _fading = true;
+            }
+            _cellsPerSecond = -1.0f;
         }
-        //std::cout << timer.MicrosElapsed() << '\n';
     }
     else
     {
-        // Reset velocities
-        std::fill(v.begin(), v.end(), 0.0f);
-        std::fill(u.begin(), u.end(), 0.0f);
+        _solver->ResetVelocity();
+        if (_stepScheduler)
+            _stepScheduler->Reset();
     }
 
     // Put simulation to sleep if all densities are small enough
     if (_currentStep % 10 == 0)
     {
-        bool continueRunning = false;
-        float densitySum = 0.0f;
-        for (float density : dens)
+        if (_simType == SmokeSimType::ENHANCED_SMOKE && !_solver->HasDensityAbove(0.001f))
+            _paused = true;
+    }
+
+    // Tiles the color pass has to redo. The CUDA step doesn't track tiles, frames without a step only
+    // changed what the sources touched and pausing changes nothing
+    if (stepped)
+    {
+        _stepDamage = _solver->LastStepDamage();
+        if (cuda_ctx)
+            _stepDamage.AddAll();
+    }
+    else if (!_paused)
+    {
+        _stepDamage = _solver->LastSourceDamage();
+    }
+    else
+    {
+        _stepDamage.Clear();
+        _fading = false;
+    }
+    if (_fading)
+        _stepDamage.Union(_fadeDamage);
+
+    SimpleTimer publishTimer;
+    _PublishFrame(simParams);
+
+    if (perfHud)
+    {
+        double colorMs = publishTimer.MicrosElapsed() / 1000.0;
+        double perfNow = zwnd::PerfHud::Now();
+        std::lock_guard<std::mutex> lock(_perfMutex);
+        _perfTickMs.Add(timer.MicrosElapsed() / 1000.0, perfNow);
+        if (solverStepMs >= 0.0)
+            _perfStepMs.Add(solverStepMs, perfNow);
+        const auto& stageTimes = _solver->GetStageTimes();
+        for (size_t i = 0; i < stageTimes.size(); i++)
+            if (stageTimes[i].calls > 0)
+                _perfStageMs[i].Add(stageTimes[i].milliseconds, perfNow);
+        _perfColorMs.Add(colorMs, perfNow);
+    }
+    _solver->ResetStageTimes();
+}
+
+void zcom::SmokeSimScene::_ApplyResolution()
+{
+    zsim::ProjectionSettings projection = _solver->GetProjectionSettings();
+    if (projection.mode == zsim::ProjectionMode::MULTIGRID)
+        projection.maxCycles = _resolutionController->PressureIterations();
+    else if (projection.mode == zsim::ProjectionMode::PCG)
+        projection.pcgMaxIterations = _resolutionController->PressureIterations();
+    else if (projection.mode == zsim::ProjectionMode::GAUSS_SEIDEL)
+        projection.gaussSeidelIterations = _resolutionController->PressureIterations();
+    _solver->SetProjectionSettings(projection);
+
+    int cellSize = _resolutionController->CellSize();
+    if (cellSize != _cellSize)
+    {
+        _cellSize = cellSize;
+        _width = _pixelWidth / _cellSize;
+        _height = _pixelHeight / _cellSize;
+        _solver->Resample(_width, _height, _cellSize);
+        _fading = false;
+    }
+}
+
+void zcom::SmokeSimScene::_PublishFrame(const SimParams& simParams)
+{
+    // Mostly the color conversion
+    ZSIM_TRACE_ZONE("SmokeSimScene::_PublishFrame");
+    int64_t allocationsBefore = zsim::ThreadAllocationCount();
+
+    if (_simType == SmokeSimType::CURSOR_TRAIL)
+    {
+        _colorMapper.SetColor(simParams.trailColor.Get());
+        _colorMapper.SetTemperatureRamp(simParams.trailTemperatureRamp.Get(), simParams.trailHotColor.Get(), simParams.trailHotTemperature.Get());
+    }
+    else
+    {
+        _colorMapper.SetColor(simParams.smokeColor.Get());
+        _colorMapper.SetTemperatureRamp(false, 0, 1.0f);
+    }
+
+    // A color change affects every pixel
+    bool recolored = _colorMapper.Revision() != _publishedColorRevision;
+    _publishedColorRevision = _colorMapper.Revision();
+
+    // Every staging buffer misses the changes made while it wasn't being written
+    for (zsim::BlockRegion& stale : _staleTiles)
+    {
+        if (stale.BlocksX() != _stepDamage.BlocksX() || stale.BlocksY() != _stepDamage.BlocksY())
         {
-            if (density > 0.001f)
-                continueRunning = true;
-            densitySum += density;
+            stale.Reset(_stepDamage.BlocksX(), _stepDamage.BlocksY());
+            stale.AddAll();
         }
-        if (_simType == SmokeSimType::ENHANCED_SMOKE && !continueRunning)
-            _paused = true;
+        else if (recolored)
+        {
+            stale.AddAll();
+        }
+        else
+        {
+            stale.Union(_stepDamage);
+        }
+    }
 
-        //std::cout << densitySum << '\n';
+    PixelFrame& frame = _frames.WriteBuffer();
+    zsim::BlockRegion& stale = _staleTiles[_frames.WriteIndex()];
+    bool resized = frame.width != _width || frame.height != _height;
+    if (resized)
+        stale.AddAll();
+    frame.width = _width;
+    frame.height = _height;
+    frame.tileSize = _solver->GetTileSettings().tileSize;
+    frame.pixels.resize(_width * _height);
+
+    stale.GetRects(_publishRects);
+    for (const zsim::RegionRect& rect : _publishRects)
+    {
+        zsim::RegionRect cells = zsim::BlockRegion::ToCells(rect, frame.tileSize, _width, _height);
+        for (int y = cells.top; y < cells.bottom; y++)
+        {
+            int index = _solver->IndexAt(cells.left + 1, y + 1);
+            const float* density = _solver->Density() + index;
+            const float* temperature = _solver->HasTemperature() ? _solver->Temperature() + index : nullptr;
+            if (_fading)
+            {
+                // Shows the last batched step partially, completing it by the time the next one runs
+                float remaining = 1.0f - _stepScheduler->Progress();
+                const float* delta = _fadeDelta.Data() + index;
+                for (int i = 0; i < cells.Width(); i++)
+                    _fadeRow[i] = std::max(density[i] - remaining * delta[i], 0.0f);
+                density = _fadeRow.data();
+            }
+            _colorMapper.Map(density, temperature, cells.Width(), frame.pixels.data() + y * _width + cells.left);
+        }
     }
+    stale.Clear();
+
+    // The UI thread uploads the changes of this frame and of any frame it skipped
+    frame.damage = _stepDamage;
+    if (recolored || resized)
+        frame.damage.AddAll();
+    if (!_skippedDamage.Empty())
+        frame.damage.Union(_skippedDamage);
+    if (_frames.Publish())
+        _skippedDamage = _frames.WriteBuffer().damage;
+    else
+        _skippedDamage.Clear();
+
+    if (!resized)
+        _steadyStateAllocations.fetch_add(zsim::ThreadAllocationCount() - allocationsBefore);
 }
 
 void zcom::SmokeSimScene::_Resize(int width, int height, ResizeInfo info)
 {
-
-}
\ No newline at end of file
+    // Recreated with the next frame
+    if (_frameBitmap)
+    {
+        _frameBitmap->Release();
+        _frameBitmap = nullptr;
+    }
+}
+void zcom::SmokeSimScene::_AppendPerfHudLines(std::vector<std::wstring>& lines)
+{
+    double now = zwnd::PerfHud::Now();
+    std::lock_guard<std::mutex> lock(_perfMutex);
+    lines.push_back(zwnd::PerfHud::FormatRate(L"sim ticks/s", _perfTickMs.Rate(now)));
+    lines.push_back(zwnd::PerfHud::FormatRate(L"solver steps/s", _perfStepMs.Rate(now)));
+    lines.push_back(zwnd::PerfHud::FormatLine(L"sim tick ms", _perfTickMs.Window(now)));
+    lines.push_back(zwnd::PerfHud::FormatLine(L"solver step ms", _perfStepMs.Window(now)));
+    for (size_t i = 0; i < _perfStageMs.size(); i++)
+    {
+        zsim::LogHistogram stage = _perfStageMs[i].Window(now);
+        if (stage.Count() == 0)
+            continue;
+        std::wstring name = L"  ";
+        for (const char* c = zsim::SolverStageName((zsim::SolverStage)i); *c; c++)
+            name += (wchar_t)*c;
+        lines.push_back(zwnd::PerfHud::FormatLine(name.c_str(), stage));
+    }
+    lines.push_back(zwnd::PerfHud::FormatLine(L"color pass ms", _perfColorMs.Window(now)));
+    lines.push_back(zwnd::PerfHud::FormatLine(L"upload ms", _perfUploadMs.Window(now)));
+}
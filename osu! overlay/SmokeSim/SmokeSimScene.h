@@ -4,12 +4,27 @@
 
 #include "Components/Base/Label.h"
 
-#include "Shared/Util/ThreadPool.h"
 #include "Shared/Util/Navigation.h"
 #include "Shared/Util/ValueOrDefault.h"
 
 #include "SmokeSimType.h"
 
+#include "SmokeSolver/SmokeSolver.h"
+#include "SmokeSolver/ResolutionController.h"
+#include "SmokeSolver/StepScheduler.h"
+#include "SmokeSolver/Grid2D.h"
+#include "SmokeSolver/ColorMapper.h"
+#include "SmokeSolver/AllocationCounter.h"
+#include "SmokeSolver/SimulationThread.h"
+#include "SmokeSolver/TripleBuffer.h"
+#include "SmokeSolver/InputTrace.h"
+#include "SmokeSolver/OsuReplay.h"
+#include "SmokeSolver/RollingHistogram.h"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+
 #include "CudaSmokeSim/CudaSmokeSim.h"
 #pragma comment (lib, "CudaSmokeSim.lib")
 
@@ -20,6 +35,22 @@ namespace zcom
         SmokeSimType simType = SmokeSimType::CURSOR_TRAIL;
         int cellSize = 4;
         int maxThreads = 4;
+        // Only used by the CPU solver
+        zsim::ProjectionSettings projection;
+        // Clamped to the highest level supported by the CPU
+        zsim::SimdLevel simdLevel = zsim::SimdLevel::AVX2;
+        // Only used by the CPU solver
+        zsim::AdvectionMode advectionMode = zsim::AdvectionMode::SEMI_LAGRANGIAN;
+        zsim::StepPolicy stepPolicy = zsim::StepPolicy::FIXED_RATE;
+        int stepRate = 144;
+        // Only used by the CPU solver. 'cellSize' is the starting point
+        zsim::ResolutionSettings resolution;
+        // Only used by the enhanced smoke, which slows down while drawing
+        zsim::StepSchedulerSettings stepScheduler;
+        // Input trace files, empty to use neither. Replaying takes precedence over recording and also
+        // accepts osu! replays (.osr), mapped onto the overlay as if it covered the osu! window
+        std::string recordInputPath;
+        std::string replayInputPath;
     };
 
     class SmokeSimScene : public Scene
@@ -40,6 +71,10 @@ namespace zcom
             zutil::ValueOrDefault<float> trailTemperatureDiffusion = zutil::ValueOrDefault<float>(6.0f);
             zutil::ValueOrDefault<float> trailDensityReductionRate = zutil::ValueOrDefault<float>(0.15f);
             zutil::ValueOrDefault<float> trailTemperatureReductionRate = zutil::ValueOrDefault<float>(0.05f);
+            // Tints hot smoke towards 'trailHotColor', fully at 'trailHotTemperature'
+            zutil::ValueOrDefault<bool> trailTemperatureRamp = zutil::ValueOrDefault<bool>(false);
+            zutil::ValueOrDefault<int> trailHotColor = zutil::ValueOrDefault<int>(0xFFFF7030);
+            zutil::ValueOrDefault<float> trailHotTemperature = zutil::ValueOrDefault<float>(1.0f);
 
             zutil::ValueOrDefault<int> smokeColor = zutil::ValueOrDefault<int>(0xFF888888);
             zutil::ValueOrDefault<int> brushWidth = zutil::ValueOrDefault<int>(14);
@@ -57,26 +92,6 @@ namespace zcom
         };
 
     private:
-        struct Cell
-        {
-            int index;
-            int x;
-            int y;
-            int leftNeighbourIndex = -1;
-            int rightNeighbourIndex = -1;
-            int topNeighbourIndex = -1;
-            int bottomNeighbourIndex = -1;
-
-            float pressure;
-            float flow;
-            float velocityX;
-            float velocityY;
-
-            float newPressure;
-            float newVelocityX;
-            float newVelocityY;
-        };
-
         struct Particle
         {
             Pos2D<float> position;
@@ -88,21 +103,82 @@ namespace zcom
         int _currentStep = 0;
         bool _paused = false;
 
+        // Grid size changes at runtime with dynamic resolution, so these are owned by the simulation thread
         int _width = 300;
         int _height = 200;
-        int _totalWidth = _width + 2;
-        int _totalHeight = _height + 2;
         int _cellSize = 4;
-        std::vector<Cell> _cells;
+        // Window size in pixels at creation
+        int _pixelWidth = 0;
+        int _pixelHeight = 0;
+        std::unique_ptr<zsim::SmokeSolver> _solver = nullptr;
+        std::unique_ptr<zsim::ResolutionController> _resolutionController = nullptr;
+        // Collects the steps of slowed down frames into one. Null if disabled
+        std::unique_ptr<zsim::StepScheduler> _stepScheduler = nullptr;
+        // Fastest velocity after the last step, in cells per second. Negative until measured, which only
+        // slowed down frames need
+        float _cellsPerSecond = -1.0f;
+        // Density change of the last batched step, which is blended in over the frames until the next one.
+        // Only valid while '_fading'. Kept allocated between slowdowns
+        zsim::Grid2D<float> _fadeDelta;
+        bool _fading = false;
+        // Tiles changed by the last batched step, redrawn on every frame of the blend
+        zsim::BlockRegion _fadeDamage;
+        // Blended density of one row, sized with '_fadeDelta'
+        std::vector<float> _fadeRow;
+
+        // The solver and the state below it up to '_simParams' are owned by the simulation thread
+        zsim::SimulationThread _simThread;
+        zsim::ColorMapper _colorMapper;
+        struct PixelFrame
+        {
+            int width = 0;
+            int height = 0;
+            // Premultiplied BGRA of the interior cells, width * height
+            std::vector<uint32_t> pixels;
+            // Solver tiles that changed since the previous published frame
+            zsim::BlockRegion damage;
+            int tileSize = 1;
+        };
+        // Staging buffers between the color pass on the simulation thread and the upload on the UI thread.
+        // Only reallocated when the grid size changes
+        zsim::TripleBuffer<PixelFrame> _frames;
+        // Tiles changed by the latest step
+        zsim::BlockRegion _stepDamage;
+        // Tiles each staging buffer is behind on, indexed like the triple buffer
+        zsim::BlockRegion _staleTiles[3];
+        // Damage of a published frame the UI thread never picked up
+        zsim::BlockRegion _skippedDamage;
+        std::vector<zsim::RegionRect> _publishRects;
+        int _publishedColorRevision = -1;
+        // Owned by the UI thread
+        std::vector<zsim::RegionRect> _uploadRects;
+        // Upload target, owned by the UI thread. Recreated on resize or when the grid size changes
+        ID2D1Bitmap1* _frameBitmap = nullptr;
+        // Heap allocations made by the frame pipeline, excluding frames where the size changed.
+        // Only counted with ZSIM_COUNT_ALLOCATIONS (debug builds) and must stay at 0
+        std::atomic<int64_t> _steadyStateAllocations = 0;
+        bool _allocationWarningShown = false;
+        // Performance HUD samples in milliseconds, only recorded while the HUD is visible. Written by the
+        // simulation thread and read by the UI thread when the HUD text is laid out
+        std::mutex _perfMutex;
+        // Whole _SimulationStep() calls, one per simulation tick
+        zsim::RollingHistogram _perfTickMs;
+        // Solver steps, fewer than ticks while steps are batched
+        zsim::RollingHistogram _perfStepMs;
+        // Per tick time of each solver stage, indexed by zsim::SolverStage
+        std::array<zsim::RollingHistogram, (size_t)zsim::SolverStage::COUNT> _perfStageMs;
+        zsim::RollingHistogram _perfColorMs;
+        // Owned by the UI thread
+        zsim::RollingHistogram _perfUploadMs;
+        Clock _simClock;
+        // Guards '_simParams' and '_slowdownPersistenceDuration', which are updated by the UI thread
+        std::mutex _simParamsMutex;
 
         Duration _particleLifetime = Duration(1000, MILLISECONDS);
         std::vector<Particle> _particles;
         float _particleDragKoeff = 1.0f;
         int _particlesPerFrame = 4;
 
-        int THREAD_COUNT = 4;
-        ThreadPool _threadPool;
-
         //float _velocityTransferRate = 0.01f;
         //float _velocityDiffusion = 0.01f;
         //float _velocityPullRate = 0.2f;
@@ -111,8 +187,20 @@ namespace zcom
         SmokeSimType _simType;
         SimParams _simParams;
 
+        // Cursor position of the previous step, relative to the window
         int prevMouseX = 0;
         int prevMouseY = 0;
+        // Cursor and smoke key, read by the simulation thread from '_input'. Points to the live input,
+        // the recorder wrapping it, or a replay of '_replayTrace'
+        zsim::InputSource* _input = nullptr;
+        std::unique_ptr<zsim::InputSource> _liveInput = nullptr;
+        std::unique_ptr<zsim::InputRecorder> _inputRecorder = nullptr;
+        std::unique_ptr<zsim::InputReplay> _inputReplay = nullptr;
+        zsim::InputTrace _replayTrace;
+        // Written when the scene closes
+        std::string _recordInputPath;
+        // Sum of the step times since the scene started
+        double _inputTime = 0.0;
 
         bool zClicked = false;
 
@@ -124,36 +212,24 @@ namespace zcom
 
         TimePoint _lastFrameTime = TimePoint(0);
         TimePoint _creationTime = TimePoint(0);
+        // Whether the last drawn frame had the startup border. Owned by the UI thread
+        bool _borderShown = false;
 
-        std::vector<float> u;
-        std::vector<float> v;
-        std::vector<float> u_prev;
-        std::vector<float> v_prev;
-        std::vector<float> dens;
-        std::vector<float> dens_prev;
-        std::vector<float> temp;
-        std::vector<float> temp_prev;
-        int _IndexAt(int x, int y) { return y * _totalWidth + x; }
-        inline int _IndexAbove(int index) { return index - _totalWidth; }
-        inline int _IndexBelow(int index) { return index + _totalWidth; }
-        inline int _IndexToLeft(int index) { return index - 1; }
-        inline int _IndexToRight(int index) { return index + 1; }
-        void _SwapPtr(float** l, float** r) { float* temp = *r; *r = *l; *l = temp; }
-        void _AddSource(int W, int H, float* x, float* s, float dt);
-        void _SetBoundary(int W, int H, int b, float* x);
-        void _Diffuse(int W, int H, int b, float* x, float* x0, float diff, float dt);
-        void _Advect(int W, int H, int b, float* d, float* d0, float* u, float* v, float dt, bool conserve);
-        void _Project(int W, int H, float* u, float* v, float* p, float* div);
-        void _VelocityStep(int W, int H, float* u, float* v, float* u0, float* v0, float visc, float dt);
-        void _DensityStep(int W, int H, float* x, float* x0, float* u, float* v, float diff, float dt);
-        void _TemperatureStep(int W, int H, float* x, float* x0, float* u, float* v, float diff, float dt);
         void _UpdateParticles(float dt);
 
         CudaSmokeSim_Context* cuda_ctx = nullptr;
+        // Stand-in temperature field for the CUDA step when the solver has none
+        std::vector<float> _cudaTemperature;
 
         TimePoint _lastParamUpdate = TimePoint(0);
         Duration _paramUpdateInterval = Duration(250, MILLISECONDS);
         void _UpdateParameters(bool force = false);
+        // Runs on the simulation thread
+        void _SimulationStep(float dt);
+        // Resamples the solver to the resolution picked by '_resolutionController'
+        void _ApplyResolution();
+        // Color maps the tiles the next staging buffer is behind on and hands it to the UI thread
+        void _PublishFrame(const SimParams& simParams);
 
         float _Clamp(const float value, const float lowerBound, const float upperBound)
         {
@@ -177,5 +253,6 @@ namespace zcom
         void _Unfocus();
         void _Update();
         void _Resize(int width, int height, ResizeInfo info);
+        void _AppendPerfHudLines(std::vector<std::wstring>& lines);
     };
 }
\ No newline at end of file
@@ -1,10 +1,8 @@
 #pragma once
 
+#include "SmokeSolver/SmokeSimType.h"
+
 namespace zcom
 {
-    enum class SmokeSimType
-    {
-        CURSOR_TRAIL,
-        ENHANCED_SMOKE
-    };
-}
\ No newline at end of file
+    using SmokeSimType = zsim::SmokeSimType;
+}
@@ -81,6 +81,11 @@ void zcom::Scene::Resize(int width, int height, ResizeInfo info)
     _Resize(width, height, info);
 }
 
+void zcom::Scene::AppendPerfHudLines(std::vector<std::wstring>& lines)
+{
+    _AppendPerfHudLines(lines);
+}
+
 zcom::Canvas* zcom::Scene::GetCanvas() const
 {
     return _canvas;
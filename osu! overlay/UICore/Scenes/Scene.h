@@ -4,6 +4,8 @@
 #include "Helper/Time.h"
 
 #include <functional>
+#include <string>
+#include <vector>
 
 enum class NotificationPosition
 {
@@ -65,6 +67,8 @@ namespace zcom
         ID2D1Bitmap* Draw(Graphics g);
         ID2D1Bitmap* ContentImage();
         void Resize(int width, int height, ResizeInfo info = {});
+        // Adds the scene's lines to the performance HUD text
+        void AppendPerfHudLines(std::vector<std::wstring>& lines);
 
         // Component creation
         template<class T, typename... Args>
@@ -100,6 +104,7 @@ namespace zcom
         virtual ID2D1Bitmap* _Draw(Graphics g) { return _canvas->Draw(g); }
         virtual ID2D1Bitmap* _Image() { return _canvas->ContentImage(); }
         virtual void _Resize(int width, int height, ResizeInfo info) = 0;
+        virtual void _AppendPerfHudLines(std::vector<std::wstring>& lines) {}
 
     public:
         virtual const char* GetName() const = 0;
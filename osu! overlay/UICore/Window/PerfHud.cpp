@@ -0,0 +1,230 @@
+#include "PerfHud.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    constexpr float MARGIN = 8.0f;
+    constexpr float PADDING = 6.0f;
+    constexpr double LAYOUT_INTERVAL = 0.25;
+    constexpr double STATUS_SECONDS = 8.0;
+}
+
+std::atomic<bool> zwnd::PerfHud::_visible = false;
+std::atomic<bool> zwnd::PerfHud::_hotkeyHeld = false;
+std::mutex zwnd::PerfHud::_statusMutex;
+std::wstring zwnd::PerfHud::_status;
+std::atomic<double> zwnd::PerfHud::_statusTime = -STATUS_SECONDS;
+std::atomic<int> zwnd::PerfHud::_statusRevision = 0;
+
+zwnd::PerfHud::~PerfHud()
+{
+    _ReleaseBrushes();
+    if (_textLayout)
+        _textLayout->Release();
+    if (_textFormat)
+        _textFormat->Release();
+    if (_dwriteFactory)
+        _dwriteFactory->Release();
+}
+
+void zwnd::PerfHud::PollHotkey()
+{
+    bool held = (GetAsyncKeyState(VK_CONTROL) & 0x8000) &&
+        (GetAsyncKeyState('S') & 0x8000) &&
+        (GetAsyncKeyState('H') & 0x8000);
+    if (!held)
+    {
+        _hotkeyHeld.store(false);
+        return;
+    }
+
+    // A window that polls just after the keys are released can still see them held, so toggles are
+    // also spaced out in time
+    static std::atomic<double> lastToggleTime = -1.0;
+    double now = Now();
+    if (!_hotkeyHeld.exchange(true) && now - lastToggleTime.load() > 0.3)
+    {
+        lastToggleTime.store(now);
+        _visible.store(!_visible.load());
+    }
+}
+
+double zwnd::PerfHud::Now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::wstring zwnd::PerfHud::FormatLine(const wchar_t* name, const zsim::LogHistogram& samples)
+{
+    wchar_t line[128];
+    swprintf(line, 128, L"%-20ls %8.2f %8.2f %8.2f", name, samples.Percentile(0.5), samples.Percentile(0.99), samples.Max());
+    return line;
+}
+
+std::wstring zwnd::PerfHud::FormatRate(const wchar_t* name, double perSecond)
+{
+    wchar_t line[128];
+    swprintf(line, 128, L"%-20ls %8.1f", name, perSecond);
+    return line;
+}
+
+void zwnd::PerfHud::PostStatus(const std::wstring& text)
+{
+    OutputDebugStringW((text + L"\n").c_str());
+    std::lock_guard<std::mutex> lock(_statusMutex);
+    _status = text;
+    _statusTime.store(Now());
+    _statusRevision.fetch_add(1);
+}
+
+bool zwnd::PerfHud::StatusActive()
+{
+    return Now() - _statusTime.load() < STATUS_SECONDS;
+}
+
+void zwnd::PerfHud::AddFrame(const FrameTimes& times)
+{
+    double now = Now();
+    _frameMs.Add(times.frameMs, now);
+    _queuedMessages.Add(times.queuedMessages, now);
+    if (!times.redrawn)
+        return;
+    _renderMs.Add(times.renderMs, now);
+    _layeredUpdateMs.Add(times.layeredUpdateMs, now);
+    _presentMs.Add(times.presentMs, now);
+}
+
+RECT zwnd::PerfHud::Draw(ID2D1DeviceContext* target, const std::function<void(std::vector<std::wstring>&)>& appendSceneLines)
+{
+    auto drawStart = std::chrono::steady_clock::now();
+    double now = Now();
+
+    _CreateResources(target);
+    if (!_textFormat || !_textBrush || !_backgroundBrush)
+        return { 0, 0, 0, 0 };
+    if (LayoutDue())
+        _Layout(appendSceneLines, now);
+    if (!_textLayout)
+        return { 0, 0, 0, 0 };
+
+    D2D1_RECT_F background = D2D1::RectF(
+        MARGIN,
+        MARGIN,
+        MARGIN + PADDING * 2.0f + _textSize.width,
+        MARGIN + PADDING * 2.0f + _textSize.height
+    );
+    target->FillRectangle(background, _backgroundBrush);
+    target->DrawTextLayout(D2D1::Point2F(MARGIN + PADDING, MARGIN + PADDING), _textLayout, _textBrush);
+
+    _drawMs.Add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - drawStart).count(), now);
+    return {
+        (LONG)std::floor(background.left),
+        (LONG)std::floor(background.top),
+        (LONG)std::ceil(background.right),
+        (LONG)std::ceil(background.bottom)
+    };
+}
+
+void zwnd::PerfHud::_CreateResources(ID2D1DeviceContext* target)
+{
+    if (!_dwriteFactory)
+    {
+        DWriteCreateFactory(
+            DWRITE_FACTORY_TYPE_SHARED,
+            __uuidof(IDWriteFactory),
+            reinterpret_cast<IUnknown**>(&_dwriteFactory)
+        );
+        if (!_dwriteFactory)
+            return;
+        _dwriteFactory->CreateTextFormat(
+            L"Consolas",
+            NULL,
+            DWRITE_FONT_WEIGHT_NORMAL,
+            DWRITE_FONT_STYLE_NORMAL,
+            DWRITE_FONT_STRETCH_NORMAL,
+            13.0f,
+            L"en-us",
+            &_textFormat
+        );
+    }
+
+    // Brushes belong to the render target they were created with
+    if (target != _target)
+    {
+        _ReleaseBrushes();
+        _target = target;
+        target->CreateSolidColorBrush(D2D1::ColorF(0.85f, 1.0f, 0.7f, 1.0f), &_textBrush);
+        target->CreateSolidColorBrush(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.7f), &_backgroundBrush);
+    }
+}
+
+void zwnd::PerfHud::_ReleaseBrushes()
+{
+    if (_textBrush)
+        _textBrush->Release();
+    if (_backgroundBrush)
+        _backgroundBrush->Release();
+    _textBrush = nullptr;
+    _backgroundBrush = nullptr;
+    _target = nullptr;
+}
+
+void zwnd::PerfHud::_Layout(const std::function<void(std::vector<std::wstring>&)>& appendSceneLines, double now)
+{
+    _nextLayoutTime = now + LAYOUT_INTERVAL;
+    _laidOutStatusRevision = _statusRevision.load();
+
+    _lines.clear();
+    if (StatusActive())
+    {
+        std::lock_guard<std::mutex> lock(_statusMutex);
+        _lines.push_back(_status);
+    }
+    // Only the status while the HUD is hidden
+    if (!Visible())
+    {
+        _LayoutText();
+        return;
+    }
+
+    wchar_t header[128];
+    swprintf(header, 128, L"%-20ls %8ls %8ls %8ls", L"last 5 s", L"p50", L"p99", L"max");
+    _lines.push_back(header);
+    _lines.push_back(FormatLine(L"UI loop ms", _frameMs.Window(now)));
+    _lines.push_back(FormatLine(L"render ms", _renderMs.Window(now)));
+    _lines.push_back(FormatLine(L"layered update ms", _layeredUpdateMs.Window(now)));
+    _lines.push_back(FormatLine(L"present ms", _presentMs.Window(now)));
+    _lines.push_back(FormatLine(L"queued messages", _queuedMessages.Window(now)));
+    _lines.push_back(FormatRate(L"frames drawn/s", _renderMs.Rate(now)));
+    if (appendSceneLines)
+        appendSceneLines(_lines);
+    _lines.push_back(FormatLine(L"HUD draw ms", _drawMs.Window(now)));
+    _LayoutText();
+}
+
+void zwnd::PerfHud::_LayoutText()
+{
+    std::wstring text;
+    for (size_t i = 0; i < _lines.size(); i++)
+    {
+        if (i > 0)
+            text += L'\n';
+        text += _lines[i];
+    }
+
+    if (_textLayout)
+    {
+        _textLayout->Release();
+        _textLayout = nullptr;
+    }
+    _dwriteFactory->CreateTextLayout(text.c_str(), (UINT32)text.length(), _textFormat, 2000.0f, 2000.0f, &_textLayout);
+    if (!_textLayout)
+        return;
+    DWRITE_TEXT_METRICS metrics;
+    _textLayout->GetMetrics(&metrics);
+    _textSize = D2D1::SizeF(metrics.width, metrics.height);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "Graphics.h"
+
+#include "SmokeSolver/RollingHistogram.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace zwnd
+{
+    // Frame timing overlay drawn over the contents of a window, shown on every window while toggled on
+    // with 'Ctrl + S + H'.
+    //
+    // The text format and brushes are created once and the text is laid out 4 times per second, so a
+    // frame only costs a rectangle fill and one DrawTextLayout call. Percentiles are over the last 5 seconds
+    class PerfHud
+    {
+    public:
+        struct FrameTimes
+        {
+            // Whole UI loop iteration, drawn or not
+            double frameMs = 0.0;
+            // Window messages handled at the start of the iteration
+            int queuedMessages = 0;
+            // The times below are only recorded for iterations that drew a frame
+            bool redrawn = false;
+            // Drawing the scenes, without the layered window update
+            double renderMs = 0.0;
+            double layeredUpdateMs = 0.0;
+            double presentMs = 0.0;
+        };
+
+        PerfHud() {}
+        ~PerfHud();
+        PerfHud(const PerfHud&) = delete;
+        PerfHud& operator=(const PerfHud&) = delete;
+
+        static bool Visible() { return _visible.load(std::memory_order_relaxed); }
+        // Toggles the HUD on the key combination. Every window polls it, only one of them toggles
+        static void PollHotkey();
+        // Seconds on the clock the HUD histograms use
+        static double Now();
+        // "name  p50  p99  max" line of a window of samples
+        static std::wstring FormatLine(const wchar_t* name, const zsim::LogHistogram& samples);
+        static std::wstring FormatRate(const wchar_t* name, double perSecond);
+
+        // Shows 'text' at the top of the HUD for a few seconds, also while the HUD is hidden, and sends it to
+        // the debugger output. For hotkey results and failures, since the app has no console. Thread safe
+        static void PostStatus(const std::wstring& text);
+        // True while a posted status is shown
+        static bool StatusActive();
+
+        // Called once per UI loop iteration, also while hidden
+        void AddFrame(const FrameTimes& times);
+        // True when the text is due to be laid out again, the window should redraw for it
+        bool LayoutDue() const { return !_textLayout || Now() >= _nextLayoutTime || _statusRevision.load() != _laidOutStatusRevision; }
+        // Draws the HUD at the top left corner of 'target'. 'appendSceneLines' is only called when the
+        // text is laid out. Returns the area drawn to
+        RECT Draw(ID2D1DeviceContext* target, const std::function<void(std::vector<std::wstring>&)>& appendSceneLines);
+
+    private:
+        static std::atomic<bool> _visible;
+        static std::atomic<bool> _hotkeyHeld;
+        static std::mutex _statusMutex;
+        static std::wstring _status;
+        static std::atomic<double> _statusTime;
+        static std::atomic<int> _statusRevision;
+
+        zsim::RollingHistogram _frameMs;
+        zsim::RollingHistogram _renderMs;
+        zsim::RollingHistogram _layeredUpdateMs;
+        zsim::RollingHistogram _presentMs;
+        zsim::RollingHistogram _queuedMessages;
+        zsim::RollingHistogram _drawMs;
+
+        ID2D1DeviceContext* _target = nullptr;
+        IDWriteFactory* _dwriteFactory = nullptr;
+        IDWriteTextFormat* _textFormat = nullptr;
+        ID2D1SolidColorBrush* _textBrush = nullptr;
+        ID2D1SolidColorBrush* _backgroundBrush = nullptr;
+        IDWriteTextLayout* _textLayout = nullptr;
+        double _nextLayoutTime = 0.0;
+        int _laidOutStatusRevision = 0;
+        D2D1_SIZE_F _textSize = {};
+        std::vector<std::wstring> _lines;
+
+        void _CreateResources(ID2D1DeviceContext* target);
+        void _ReleaseBrushes();
+        void _Layout(const std::function<void(std::vector<std::wstring>&)>& appendSceneLines, double now);
+        // Creates the text layout of '_lines'
+        void _LayoutText();
+    };
+}
@@ -3,6 +3,28 @@
 
 #include "Scenes/ContextMenuScene.h"
 #include "Scenes/TooltipScene.h"
+#include "PerfHud.h"
+
+#include "SmokeSolver/TraceZones.h"
+
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+namespace
+{
+    // Writes the trace zones of the last 5 seconds to 'path' and shows the result on the performance HUD.
+    // Copying and serializing every thread's zones takes a while, so this runs on its own thread
+    void WriteTraceDump(std::filesystem::path path)
+    {
+        if (zsim::TraceZones::WriteChromeTrace(path.string(), 5.0))
+            zwnd::PerfHud::PostStatus(L"Trace of the last 5 s written to '" + path.wstring() + L"'");
+        else
+            zwnd::PerfHud::PostStatus(L"Couldn't write the trace to '" + path.wstring() + L"'");
+    }
+}
 
 zwnd::Window::Window(
     App* app,
@@ -376,6 +398,9 @@ void zwnd::Window::_UIThread()
 {
     int framecounter = 0;
     Clock frameTimer = Clock(0);
+    bool traceDumpKeysHeld = false;
+    std::thread traceDumpThread;
+    ZSIM_TRACE_THREAD_NAME(_parentId.has_value() ? "UI (child window)" : "UI");
 
     // Create frame number debug text rendering resources
     IDWriteFactory* dwriteFactory = nullptr;
@@ -395,16 +420,34 @@ void zwnd::Window::_UIThread()
         L"en-us",
         &dwriteTextFormat
     );
+    ID2D1SolidColorBrush* frameCounterBrush = nullptr;
+    ID2D1DeviceContext* frameCounterTarget = nullptr;
+    const RECT frameCounterRect = { 5, 5, 105, 35 };
+    // Whether the last drawn frame had the frame number, which is erased on the next one without it
+    bool frameCounterShown = false;
+
+    PerfHud perfHud;
+    // Area of the last drawn HUD, cleared from the window after the HUD is hidden
+    RECT perfHudRect = { 0, 0, 0, 0 };
+    auto msSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
 
     while (true)
     {
+        ZSIM_TRACE_ZONE("UI frame");
+        auto frameStart = std::chrono::steady_clock::now();
+        PerfHud::FrameTimes frameTimes;
         _window->LockSize();
 
         ztime::clock[CLOCK_GAME].Update();
         ztime::clock[CLOCK_MAIN].Update();
 
         _windowSizeMessage = std::nullopt;
-        _window->ProcessQueueMessages([&](WindowMessage msg) { Window::_HandleMessage(msg); });
+        {
+            ZSIM_TRACE_ZONE("ProcessQueueMessages");
+            frameTimes.queuedMessages = _window->ProcessQueueMessages([&](WindowMessage msg) { Window::_HandleMessage(msg); });
+        }
 
         // Check for resize
         if (_windowSizeMessage.has_value())
@@ -485,6 +528,7 @@ void zwnd::Window::_UIThread()
         auto activeScenes = Scenes();
 
         { // Updating scenes
+            ZSIM_TRACE_ZONE("Update scenes");
             for (auto& scene : activeScenes)
                 scene->Update();
             if (_TitleBarAvailable())
@@ -507,10 +551,21 @@ void zwnd::Window::_UIThread()
                 redraw = true;
         }
 
+        // Toggle the performance HUD on 'Ctrl + S + H'. Posted status messages are drawn by it even while hidden.
+        // Its text changes a few times per second, or it has to be erased
+        PerfHud::PollHotkey();
+        bool drawPerfHud = PerfHud::Visible() || PerfHud::StatusActive();
+        if (drawPerfHud && perfHud.LayoutDue())
+            redraw = true;
+        if (!drawPerfHud && perfHudRect.right > perfHudRect.left)
+            redraw = true;
+
         //std::cout << "Updated " << ++framecounter << '\n';
         //redraw = true;
         if (redraw)
         {
+            ZSIM_TRACE_ZONE("Draw");
+            auto renderStart = std::chrono::steady_clock::now();
             //if (_parentId.has_value())
             //    std::cout << "Redrawn (" << framecounter++ << ")\n";
             Graphics g = _window->gfx.GetGraphics();
@@ -602,29 +657,62 @@ void zwnd::Window::_UIThread()
                 (GetKeyState('S') & 0x8000) &&
                 (GetKeyState('F') & 0x8000))
             {
-                IDWriteTextLayout* dwriteTextLayout = nullptr;
+                if (g.target != frameCounterTarget)
+                {
+                    if (frameCounterBrush)
+                        frameCounterBrush->Release();
+                    frameCounterBrush = nullptr;
+                    g.target->CreateSolidColorBrush(D2D1::ColorF(0.4f, 0.8f, 0.0f, 0.9f), &frameCounterBrush);
+                    frameCounterTarget = g.target;
+                }
 
-                std::wstringstream ss;
-                ss << framecounter++;
-                dwriteFactory->CreateTextLayout(
-                    ss.str().c_str(),
-                    ss.str().length(),
+                std::wstring text = std::to_wstring(framecounter++);
+                g.target->DrawText(
+                    text.c_str(),
+                    (UINT32)text.length(),
                     dwriteTextFormat,
-                    100,
-                    30,
-                    &dwriteTextLayout
+                    D2D1::RectF(
+                        (float)frameCounterRect.left,
+                        (float)frameCounterRect.top,
+                        (float)frameCounterRect.right,
+                        (float)frameCounterRect.bottom
+                    ),
+                    frameCounterBrush
                 );
+                _window->IncludeInLayeredUpdateRect(frameCounterRect);
+                frameCounterShown = true;
+            }
+            else if (frameCounterShown)
+            {
+                _window->IncludeInLayeredUpdateRect(frameCounterRect);
+                frameCounterShown = false;
+            }
 
-                ID2D1SolidColorBrush* brush;
-                g.target->CreateSolidColorBrush(D2D1::ColorF(0.4f, 0.8f, 0.0f, 0.9f), &brush);
-                g.target->DrawTextLayout(D2D1::Point2F(5.0f, 5.0f), dwriteTextLayout, brush);
-
-                brush->Release();
-                dwriteTextLayout->Release();
+            if (drawPerfHud)
+            {
+                RECT hudRect = perfHud.Draw(g.target, [&](std::vector<std::wstring>& lines) {
+                    for (auto& scene : activeScenes)
+                        scene->AppendPerfHudLines(lines);
+                });
+                _window->IncludeInLayeredUpdateRect(hudRect);
+                // The HUD can shrink between layouts
+                _window->IncludeInLayeredUpdateRect(perfHudRect);
+                perfHudRect = hudRect;
             }
+            else if (perfHudRect.right > perfHudRect.left)
+            {
+                _window->IncludeInLayeredUpdateRect(perfHudRect);
+                perfHudRect = { 0, 0, 0, 0 };
+            }
+            frameTimes.renderMs = msSince(renderStart);
 
             // Update layered window
-            _window->UpdateLayeredWindow();
+            {
+                ZSIM_TRACE_ZONE("UpdateLayeredWindow");
+                auto layeredUpdateStart = std::chrono::steady_clock::now();
+                _window->UpdateLayeredWindow();
+                frameTimes.layeredUpdateMs = msSince(layeredUpdateStart);
+            }
 
             g.target->EndDraw();
         }
@@ -638,12 +726,49 @@ void zwnd::Window::_UIThread()
             _scenesToUninitialize.pop_front();
         }
 
-        _window->gfx.EndFrame(redraw);
+        {
+            ZSIM_TRACE_ZONE(redraw ? "Present" : "Idle sleep");
+            auto presentStart = std::chrono::steady_clock::now();
+            _window->gfx.EndFrame(redraw);
+            frameTimes.presentMs = msSince(presentStart);
+        }
+        frameTimes.redrawn = redraw;
+
+        // Dump the recent trace zones when 'Ctrl + S + T' is pressed
+        if constexpr (zsim::TraceZones::Enabled())
+        {
+            // Every window sees the key press, only the first one to react writes the trace
+            static std::atomic<int64_t> lastTraceDumpNs = 0;
+            bool keysHeld = (GetAsyncKeyState(VK_CONTROL) & 0x8000) &&
+                (GetAsyncKeyState('S') & 0x8000) &&
+                (GetAsyncKeyState('T') & 0x8000);
+            int64_t nowNs = zsim::TraceZones::NowNs();
+            int64_t lastDumpNs = lastTraceDumpNs.load();
+            if (keysHeld && !traceDumpKeysHeld && nowNs - lastDumpNs > 1000000000 && lastTraceDumpNs.compare_exchange_strong(lastDumpNs, nowNs))
+            {
+                // The previous dump is at least a second old and has finished by now
+                if (traceDumpThread.joinable())
+                    traceDumpThread.join();
+                std::filesystem::path path = "trace_" + std::to_string(std::time(nullptr)) + ".json";
+                std::error_code error;
+                std::filesystem::path absolutePath = std::filesystem::absolute(path, error);
+                if (!error)
+                    path = absolutePath;
+                traceDumpThread = std::thread(WriteTraceDump, path);
+            }
+            traceDumpKeysHeld = keysHeld;
+        }
+
+        frameTimes.frameMs = msSince(frameStart);
+        perfHud.AddFrame(frameTimes);
 
         if (_closed.load())
             break;
     }
 
+    if (traceDumpThread.joinable())
+        traceDumpThread.join();
+
     for (auto& scene : _activeScenes)
         scene->Uninit();
     _activeScenes.clear();
@@ -656,6 +781,8 @@ void zwnd::Window::_UIThread()
     _nonClientAreaScene.reset();
 
     // Release text rendering resources
+    if (frameCounterBrush)
+        frameCounterBrush->Release();
     dwriteTextFormat->Release();
     dwriteFactory->Release();
 }
@@ -259,6 +259,16 @@ void zwnd::WindowBackend::UpdateLayeredWindow()
     GDIRT->Release();
 }
 
+void zwnd::WindowBackend::SetLayeredUpdateRect(RECT rect)
+{
+    _linfo.SetDirtyRect(rect);
+}
+
+void zwnd::WindowBackend::IncludeInLayeredUpdateRect(RECT rect)
+{
+    _linfo.IncludeInDirtyRect(rect);
+}
+
 void zwnd::WindowBackend::ProcessMessages()
 {
     MSG msg;
@@ -312,7 +322,7 @@ bool zwnd::WindowBackend::ProcessSingleMessage()
     return true;
 }
 
-void zwnd::WindowBackend::ProcessQueueMessages(std::function<void(WindowMessage)> callback)
+int zwnd::WindowBackend::ProcessQueueMessages(std::function<void(WindowMessage)> callback)
 {
     // Create a copy of the queue and process the messages without blocking the message thread
     // Not doing this leads to a deadlock when trying to create a child window from the UI thread
@@ -322,11 +332,13 @@ void zwnd::WindowBackend::ProcessQueueMessages(std::function<void(WindowMessage)
         _msgQueue.pop();
     lock.unlock();
 
+    int count = (int)msgQueueCopy.size();
     while (!msgQueueCopy.empty())
     {
         callback(msgQueueCopy.front());
         msgQueueCopy.pop();
     }
+    return count;
 }
 
 LRESULT WINAPI zwnd::WindowBackend::_HandleMsgSetup(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
@@ -20,6 +20,7 @@
 #include <queue>
 #include <unordered_map>
 #include <optional>
+#include <algorithm>
 
 namespace zwnd
 {
@@ -53,6 +54,7 @@ namespace zwnd
         POINT _windowPosition;
         SIZE _size;
         BLENDFUNCTION _blend;
+        RECT _dirty;
         UPDATELAYEREDWINDOWINFO _info;
 
     public:
@@ -62,6 +64,7 @@ namespace zwnd
             _windowPosition(),
             _size(),
             _blend(),
+            _dirty(),
             _info()
         {
             _info.cbSize = sizeof(UPDATELAYEREDWINDOWINFO);
@@ -89,12 +92,45 @@ namespace zwnd
 
             //std::cout << _info.psize->cx << ':' << _info.psize->cy << '\n';
             //_size.cx++;
+            if (_info.prcDirty)
+            {
+                _dirty.left = std::clamp(_dirty.left, 0L, _size.cx);
+                _dirty.top = std::clamp(_dirty.top, 0L, _size.cy);
+                _dirty.right = std::clamp(_dirty.right, _dirty.left, _size.cx);
+                _dirty.bottom = std::clamp(_dirty.bottom, _dirty.top, _size.cy);
+            }
             BOOL res = UpdateLayeredWindowIndirect(window, &_info);
             if (res == 0)
             {
                 //std::cout << "LAYERED WINDOW UPDATE ERROR " << _info.psize->cx << ':' << _info.psize->cy << " vs " << GetWidth() << ':' << GetHeight() << '\n';
                 //std::cout << "LAYERED WINDOW UPDATE ERROR\n";
             }
+            // The dirty rect only applies to a single update
+            _info.prcDirty = nullptr;
+        }
+
+        // Limits the next Update() to 'rect', in window coordinates
+        void SetDirtyRect(RECT rect)
+        {
+            _dirty = rect;
+            _info.prcDirty = &_dirty;
+        }
+
+        // Grows the dirty rect of the next Update() to cover 'rect'. Does nothing when no dirty rect is set,
+        // since the whole window is updated then
+        void IncludeInDirtyRect(RECT rect)
+        {
+            if (!_info.prcDirty || rect.right <= rect.left || rect.bottom <= rect.top)
+                return;
+            if (_dirty.right <= _dirty.left || _dirty.bottom <= _dirty.top)
+            {
+                _dirty = rect;
+                return;
+            }
+            _dirty.left = std::min(_dirty.left, rect.left);
+            _dirty.top = std::min(_dirty.top, rect.top);
+            _dirty.right = std::max(_dirty.right, rect.right);
+            _dirty.bottom = std::max(_dirty.bottom, rect.bottom);
         }
 
         void SetWidth(UINT width)
@@ -152,10 +188,17 @@ namespace zwnd
         void UnlockSize();
 
         void UpdateLayeredWindow();
+        // Only the area inside 'rect' (client coordinates) is updated by the next UpdateLayeredWindow() call.
+        // Must be called from the UI thread while drawing. Without it, the whole window is updated.
+        // Scenes set it from their own damage, the window then widens it for what it draws over them
+        void SetLayeredUpdateRect(RECT rect);
+        // Adds 'rect' to the area set with SetLayeredUpdateRect(), e.g. for content drawn over the scenes
+        void IncludeInLayeredUpdateRect(RECT rect);
 
         void ProcessMessages();
         bool ProcessSingleMessage();
-        void ProcessQueueMessages(std::function<void(WindowMessage)> callback);
+        // Returns the number of messages processed
+        int ProcessQueueMessages(std::function<void(WindowMessage)> callback);
 
         void AddKeyboardHandler(KeyboardEventHandler* handler);
         bool RemoveKeyboardHandler(KeyboardEventHandler* handler);